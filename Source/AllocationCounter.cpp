@@ -0,0 +1,114 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local juce::uint64 threadAllocations = 0;
+    std::atomic<juce::uint64> totalAllocations { 0 };
+    std::atomic<juce::uint64> violations { 0 };
+    std::atomic<const char*> lastViolation { nullptr };
+}
+
+juce::uint64 AllocationCounter::getThreadAllocations()
+{
+    return threadAllocations;
+}
+
+juce::uint64 AllocationCounter::getTotalAllocations()
+{
+    return totalAllocations.load(std::memory_order_relaxed);
+}
+
+juce::uint64 AllocationCounter::getNumViolations()
+{
+    return violations.load(std::memory_order_relaxed);
+}
+
+const char* AllocationCounter::getLastViolation()
+{
+    return lastViolation.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::resetViolations()
+{
+    violations.store(0, std::memory_order_relaxed);
+    lastViolation.store(nullptr, std::memory_order_relaxed);
+}
+
+void AllocationCounter::reportViolation(const char* where)
+{
+    violations.fetch_add(1, std::memory_order_relaxed);
+    lastViolation.store(where, std::memory_order_relaxed);
+}
+
+#if JOYCON_COUNT_ALLOCATIONS
+
+namespace
+{
+    void* countedAlloc(std::size_t size) noexcept
+    {
+        ++threadAllocations;
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* countedAlignedAlloc(std::size_t size, std::align_val_t al) noexcept
+    {
+        ++threadAllocations;
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        const auto alignment = juce::jmax(sizeof(void*), (std::size_t)al);
+       #if JUCE_WINDOWS
+        return _aligned_malloc(size == 0 ? 1 : size, alignment);
+       #else
+        void* p = nullptr;
+        return posix_memalign(&p, alignment, size == 0 ? 1 : size) == 0 ? p : nullptr;
+       #endif
+    }
+
+    void alignedFree(void* p) noexcept
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(p);
+       #else
+        std::free(p);
+       #endif
+    }
+
+    void* throwingAlloc(void* p)
+    {
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return p;
+    }
+}
+
+void* operator new(std::size_t size)                                          { return throwingAlloc(countedAlloc(size)); }
+void* operator new[](std::size_t size)                                        { return throwingAlloc(countedAlloc(size)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept          { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept        { return countedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t al)                     { return throwingAlloc(countedAlignedAlloc(size, al)); }
+void* operator new[](std::size_t size, std::align_val_t al)                   { return throwingAlloc(countedAlignedAlloc(size, al)); }
+void* operator new(std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept   { return countedAlignedAlloc(size, al); }
+void* operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, al); }
+
+void operator delete(void* p) noexcept                                        { std::free(p); }
+void operator delete[](void* p) noexcept                                      { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept                           { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept                         { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept                 { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept               { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept                      { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                    { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept         { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept       { alignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept   { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(p); }
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+#ifndef JOYCON_COUNT_ALLOCATIONS
+ #define JOYCON_COUNT_ALLOCATIONS 0
+#endif
+
+/*
+    Heap allocation accounting for the steady-state paths (poll loop, hub
+    callback, Joycon::Update, processBlock). With JOYCON_COUNT_ALLOCATIONS the
+    global operator new/delete are replaced by counting versions, and every
+    ScopedAllocationCheck that sees its thread allocate is recorded as a
+    violation. Without it everything here compiles to nothing.
+*/
+struct AllocationCounter
+{
+    static constexpr bool isEnabled()
+    {
+        return JOYCON_COUNT_ALLOCATIONS != 0;
+    }
+
+    /* Allocations made by the calling thread so far. */
+    static juce::uint64 getThreadAllocations();
+
+    /* Allocations made by every thread so far. */
+    static juce::uint64 getTotalAllocations();
+
+    /* Number of checked scopes that allocated, and the name of the last one. */
+    static juce::uint64 getNumViolations();
+    static const char* getLastViolation();
+    static void resetViolations();
+
+    static void reportViolation(const char* where);
+};
+
+/* Marks a scope that must not touch the heap once the controller is running. */
+class ScopedAllocationCheck
+{
+public:
+    explicit ScopedAllocationCheck(const char* scopeName)
+       #if JOYCON_COUNT_ALLOCATIONS
+        : name(scopeName), start(AllocationCounter::getThreadAllocations())
+       #endif
+    {
+        juce::ignoreUnused(scopeName);
+    }
+
+    ~ScopedAllocationCheck()
+    {
+       #if JOYCON_COUNT_ALLOCATIONS
+        if (AllocationCounter::getThreadAllocations() != start)
+        {
+            AllocationCounter::reportViolation(name);
+        }
+       #endif
+    }
+
+private:
+   #if JOYCON_COUNT_ALLOCATIONS
+    const char* name;
+    juce::uint64 start;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedAllocationCheck)
+};
@@ -0,0 +1,148 @@
+#include "Capture.h"
+#include "joycon.hpp"
+
+namespace
+{
+    constexpr int magic = 0x5041434a;    // "JCAP"
+    constexpr int version = 1;
+}
+
+CaptureWriter::CaptureWriter(const juce::File& file, const CaptureHeader& header)
+{
+    file.deleteFile();
+
+    auto s = std::make_unique<juce::FileOutputStream>(file);
+
+    if (!s->openedOk())
+    {
+        return;
+    }
+
+    s->writeInt(magic);
+    s->writeByte((char)version);
+    s->writeBool(header.isLeft);
+
+    for (auto v : header.stickCalibration)
+    {
+        s->writeShort((short)v);
+    }
+
+    s->writeShort((short)header.deadzone);
+
+    for (auto v : header.gyroNeutral)
+    {
+        s->writeShort(v);
+    }
+
+    stream = std::move(s);
+}
+
+void CaptureWriter::write(double timeMs, const juce::uint8* report, int length)
+{
+    if (stream == nullptr)
+    {
+        return;
+    }
+
+    length = juce::jlimit(0, CaptureReader::maxReportLength, length);
+
+    stream->writeDouble(timeMs);
+    stream->writeByte((char)length);
+    stream->write(report, (size_t)length);
+    ++numReports;
+}
+
+CaptureReader::CaptureReader(const juce::File& file)
+{
+    auto s = std::make_unique<juce::FileInputStream>(file);
+
+    if (!s->openedOk() || s->readInt() != magic || s->readByte() > version)
+    {
+        return;
+    }
+
+    header.isLeft = s->readBool();
+
+    for (auto& v : header.stickCalibration)
+    {
+        v = (juce::uint16)s->readShort();
+    }
+
+    header.deadzone = (juce::uint16)s->readShort();
+
+    for (auto& v : header.gyroNeutral)
+    {
+        v = s->readShort();
+    }
+
+    firstRecord = s->getPosition();
+    stream = std::move(s);
+}
+
+bool CaptureReader::next(double& timeMs, std::array<juce::uint8, maxReportLength>& report, int& length)
+{
+    if (stream == nullptr || stream->getNumBytesRemaining() < 9)
+    {
+        return false;
+    }
+
+    timeMs = stream->readDouble();
+    length = juce::jlimit(0, maxReportLength, (int)(juce::uint8)stream->readByte());
+
+    return stream->read(report.data(), length) == length;
+}
+
+void CaptureReader::rewind()
+{
+    if (stream != nullptr)
+    {
+        stream->setPosition(firstRecord);
+    }
+}
+
+//==============================================================================
+bool CaptureImuStream::read(const juce::File& capture)
+{
+    CaptureReader reader(capture);
+    if (!reader.openedOk())
+    {
+        return false;
+    }
+
+    header = reader.getHeader();
+
+    std::array<juce::uint8, CaptureReader::maxReportLength> report {};
+    double ms = 0;
+    int length = 0;
+    int timestamp = -1;
+
+    while (reader.next(ms, report, length))
+    {
+        if (length < reportLength || report[0] != 0x30)
+        {
+            continue;
+        }
+
+        reports.emplace_back();
+        std::copy(report.begin(), report.begin() + reportLength, reports.back().begin());
+        reportMs.push_back(ms);
+
+        // the first sample integrates over the timer ticks since the last report, the others one tick
+        auto ticks = timestamp < 0 ? 1 : (report[1] - timestamp + 0x100) % 0x100;
+        timestamp = report[1];
+
+        for (size_t n = 0; n < (size_t)samplesPerReport; ++n)
+        {
+            juce::Vector3D<juce::int16> a, g;
+            Joycon::DecodeRawIMU(report.data(), n, a, g);
+
+            acc.push_back(a);
+            gyr.push_back(g);
+            dtSec.push_back(0.005f * (float)juce::jmax(1, ticks));
+            timeMs.push_back(ms - (double)(samplesPerReport - 1 - (int)n) * 5.0);
+            ticks = 1;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    Raw report captures, for replaying a controller session offline through
+    the same processing (benchmarks, the console tool).
+
+    Layout, little endian: "JCAP", version byte, then the header below, then
+    one record per report: double milliseconds, length byte, report bytes.
+*/
+struct CaptureHeader
+{
+    bool isLeft = false;
+    std::array<juce::uint16, 6> stickCalibration {};
+    juce::uint16 deadzone = 0;
+    std::array<juce::int16, 3> gyroNeutral {};
+};
+
+class CaptureWriter
+{
+public:
+    CaptureWriter(const juce::File& file, const CaptureHeader& header);
+
+    bool openedOk() const
+    {
+        return stream != nullptr;
+    }
+
+    /* Controller update thread; buffered, so cheap per report. */
+    void write(double timeMs, const juce::uint8* report, int length);
+
+    juce::int64 getNumReports() const
+    {
+        return numReports;
+    }
+
+private:
+    std::unique_ptr<juce::FileOutputStream> stream;
+    juce::int64 numReports = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (CaptureWriter)
+};
+
+class CaptureReader
+{
+public:
+    static constexpr int maxReportLength = 64;
+
+    explicit CaptureReader(const juce::File& file);
+
+    bool openedOk() const
+    {
+        return stream != nullptr;
+    }
+
+    const CaptureHeader& getHeader() const
+    {
+        return header;
+    }
+
+    /* Returns false at the end of the capture. */
+    bool next(double& timeMs, std::array<juce::uint8, maxReportLength>& report, int& length);
+
+    /* Back to the first report. */
+    void rewind();
+
+private:
+    std::unique_ptr<juce::FileInputStream> stream;
+    CaptureHeader header;
+    juce::int64 firstRecord = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (CaptureReader)
+};
+
+/*
+    A capture's 0x30 reports unpacked for the offline tools (joycon-tune,
+    joycon-regress, OneEuroBank::benchmark), so they all decode it the same
+    way: every report, and its three IMU samples, raw, with the gyro
+    integration step from the report timer as Joycon::ProcessIMU takes it.
+*/
+struct CaptureImuStream
+{
+    static constexpr int samplesPerReport = 3;
+    static constexpr int reportLength = 49;
+
+    CaptureHeader header;
+
+    // one per report, in capture order
+    std::vector<std::array<juce::uint8, reportLength>> reports;
+    std::vector<double> reportMs;
+
+    // samplesPerReport per report, oldest first
+    std::vector<juce::Vector3D<juce::int16>> acc, gyr;
+    std::vector<float> dtSec;
+    std::vector<double> timeMs;             // the report's time less 5 ms for each newer sample in it
+
+    /* Returns false if the capture can't be read. */
+    bool read(const juce::File& capture);
+
+    int getNumReports() const
+    {
+        return (int)reports.size();
+    }
+
+    int getNumSamples() const
+    {
+        return (int)timeMs.size();
+    }
+
+    juce::Vector3D<juce::int16> getGyroNeutral() const
+    {
+        return { header.gyroNeutral[0], header.gyroNeutral[1], header.gyroNeutral[2] };
+    }
+};
@@ -0,0 +1,945 @@
+/*
+    joycon-console: the controller pipeline without the plugin or any GUI.
+
+    Attaches real, simulated or replayed controllers, runs every report through
+    the same decode / batch IMU / mapping / gesture stages as the plugin and
+    streams the MIDI to stdout, a binary file or a MIDI port, printing a
+    throughput and latency summary to stderr as it goes. Also runs the
+    built-in benchmarks, for soak tests and profiling on headless machines.
+*/
+
+#include "JuceHeader.h"
+#include "joycon.hpp"
+#include "DeviceWatcher.h"
+#include "SimulatedTransport.h"
+#include "MappingMatrix.h"
+#include "GestureEngine.h"
+#include "ImuBatch.h"
+#include "ThreadTuning.h"
+#include "AllocationCounter.h"
+#include "Capture.h"
+#include "OscOutput.h"
+#include "OneEuroFilter.h"
+#include "JoyconPair.h"
+#include "Scheduler.h"
+#include "HidrawHub.h"
+#include "CpuTime.h"
+#include "ToolStats.h"
+
+#include <csignal>
+#include <iostream>
+
+namespace
+{
+    std::atomic<bool> stopRequested { false };
+
+    void handleSignal(int)
+    {
+        stopRequested = true;
+    }
+
+    constexpr int cycleMs = 5;
+    constexpr double sampleRate = 48000.0;                          // rate the mapping's audio outputs render at
+    constexpr int cycleSamples = (int)(sampleRate * cycleMs / 1000);
+
+    const char* usage =
+        "usage: joycon-console [sources] [output] [options]\n"
+        "       joycon-console --bench=imu|gestures|smoothing|wakeup|osc|backends [options]\n"
+        "\n"
+        "sources (combine freely, default: every connected Joy-Con)\n"
+        "  --list                   print connected Joy-Cons and exit\n"
+        "  --device=<path>|all      attach a real controller by path, or all of them\n"
+        "  --simulate=<n>           attach n simulated controllers\n"
+        "  --replay=<a.jcap,...>    replay captures at their recorded pace\n"
+        "  --fast                   replay as fast as possible (gesture timing is lost)\n"
+        "  --loop                   restart replays at the end\n"
+        "  --pair                   merge controllers 0 and 1, 2 and 3, ... into one time aligned controller each\n"
+        "\n"
+        "output\n"
+        "  --out=stdout             one line per MIDI event (default)\n"
+        "  --out=file:<path>        binary: \"JCMS\", then double ms, controller, length, bytes\n"
+        "  --out=midi[:<name>]      a MIDI port: a new virtual port, or the existing one called name\n"
+        "  --out=none               discard, for profiling\n"
+        "  --osc=<host:port,...>    also send OSC bundles, e.g. 127.0.0.1:9000,rate=60 (prefix /joycon/<n>)\n"
+        "\n"
+        "options\n"
+        "  --seconds=<n>            stop after n seconds (default: Ctrl-C, or the end of non-looping replays)\n"
+        "  --summary=<n>            summary every n seconds (default 5, 0 for only the final one)\n"
+        "  --capture=<path.jcap>    record the first controller's raw reports\n"
+        "  --rt=<spec>              scheduling for the poll threads and the pipeline, e.g. fifo:80,cpu=2,mlock\n"
+        "  --controllers=<n>        lanes for --bench imu (default 8), simulated controllers for --bench backends (default 8)\n";
+
+    //==============================================================================
+    class Output
+    {
+    public:
+        virtual ~Output() = default;
+        virtual void write(double timeMs, int controller, const juce::MidiMessageMetadata& m) = 0;
+        virtual void flush() {}
+    };
+
+    class TextOutput : public Output
+    {
+    public:
+        void write(double timeMs, int controller, const juce::MidiMessageMetadata& m) override
+        {
+            line.clear();
+            line << juce::String(timeMs, 3) << ' ' << controller;
+
+            for (int i = 0; i < m.numBytes; ++i)
+            {
+                line << ' ' << juce::String::toHexString((int)m.data[i]).paddedLeft('0', 2);
+            }
+
+            std::cout << line << '\n';
+        }
+
+        void flush() override
+        {
+            std::cout.flush();
+        }
+
+    private:
+        juce::String line;
+    };
+
+    class BinaryOutput : public Output
+    {
+    public:
+        explicit BinaryOutput(const juce::File& file)
+        {
+            file.deleteFile();
+            stream = std::make_unique<juce::FileOutputStream>(file);
+
+            if (stream->openedOk())
+            {
+                stream->writeInt(0x534d434a);   // "JCMS"
+                stream->writeByte(1);
+            }
+        }
+
+        bool openedOk() const
+        {
+            return stream->openedOk();
+        }
+
+        void write(double timeMs, int controller, const juce::MidiMessageMetadata& m) override
+        {
+            stream->writeDouble(timeMs);
+            stream->writeByte((char)controller);
+            stream->writeByte((char)m.numBytes);
+            stream->write(m.data, (size_t)m.numBytes);
+        }
+
+        void flush() override
+        {
+            stream->flush();
+        }
+
+    private:
+        std::unique_ptr<juce::FileOutputStream> stream;
+    };
+
+    class MidiPortOutput : public Output
+    {
+    public:
+        explicit MidiPortOutput(const juce::String& name)
+        {
+            if (name.isEmpty())
+            {
+                port = juce::MidiOutput::createNewDevice("Joycon Goodness");
+                return;
+            }
+
+            for (auto& d : juce::MidiOutput::getAvailableDevices())
+            {
+                if (d.name == name)
+                {
+                    port = juce::MidiOutput::openDevice(d.identifier);
+                    return;
+                }
+            }
+        }
+
+        bool openedOk() const
+        {
+            return port != nullptr;
+        }
+
+        void write(double, int, const juce::MidiMessageMetadata& m) override
+        {
+            port->sendMessageNow(m.getMessage());
+        }
+
+    private:
+        std::unique_ptr<juce::MidiOutput> port;
+    };
+
+    class NullOutput : public Output
+    {
+    public:
+        void write(double, int, const juce::MidiMessageMetadata&) override {}
+    };
+
+    //==============================================================================
+    struct Controller
+    {
+        juce::String name;
+        std::unique_ptr<Joycon> joycon;
+        ReplayTransport* replay = nullptr;      // owned by the joycon
+
+        Telemetry telemetry;
+        MappingEngine mapping;
+        GestureEngine gestures;
+        GestureNotePlayer gestureNotes;
+        OscSender osc;
+
+        juce::int64 lastTicks = 0;
+        std::array<TelemetrySample, 64> recent;
+
+        // --pair: the first of a pair maps the merged state, the second only feeds it
+        std::unique_ptr<JoyconPair> pair;
+        juce::String partnerName;
+        bool isPartner = false;
+        double lastPairSeconds = 0;
+        LatencyCounts skewAtSummary {};
+        ImuBroadcast::Reader imuReader { telemetry.imu };
+        std::array<ImuRecord, 64> imuRecords;
+
+        // totals, and what they were at the last summary
+        juce::uint64 samples = 0, events = 0, imuSamples = 0;
+        juce::uint64 samplesAtSummary = 0, eventsAtSummary = 0, imuSamplesAtSummary = 0;
+        LatencyCounts lagAtSummary {};
+        LatencyCounts intervalAtSummary {};
+    };
+
+    struct Timing
+    {
+        double sumUs = 0, maxUs = 0;
+        juce::uint64 count = 0;
+
+        void record(double us)
+        {
+            sumUs += us;
+            maxUs = juce::jmax(maxUs, us);
+            ++count;
+        }
+
+        double mean() const
+        {
+            return count > 0 ? sumUs / (double)count : 0.0;
+        }
+    };
+
+    double ticksToUs(juce::int64 ticks)
+    {
+        return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6;
+    }
+
+    //==============================================================================
+    struct BackendCost
+    {
+        bool ran = false;
+        double cpuPercent = 0;              // of one core, per controller
+        double reportsPerSecond = 0;        // processed, per controller
+    };
+
+    /*
+        numControllers simulated controllers serviced for the given time by a
+        hub when there is one, else each by its own poll thread, as with
+        hidapi. The transports are timer descriptor driven either way, so only
+        the servicing differs. The cost is the whole process's CPU less this
+        thread's, which drains the queues the same way for both.
+    */
+    BackendCost measureBackend(int numControllers, double seconds, HidrawHub* hub)
+    {
+        BackendCost cost;
+        std::vector<std::unique_ptr<Telemetry>> telemetry;
+        std::vector<std::unique_ptr<Joycon>> joycons;
+
+        for (int i = 0; i < numControllers; ++i)
+        {
+            auto transport = std::make_unique<SimulatedTransport>(i % 2 == 0, i);
+            if (!transport->enableDescriptor())
+            {
+                return cost;
+            }
+
+            telemetry.push_back(std::make_unique<Telemetry>());
+
+            auto j = std::make_unique<Joycon>(std::move(transport), true, true, 0.05f, i % 2 == 0);
+            j->SetTelemetry(telemetry.back().get());
+            j->SetHub(hub);
+
+            if (!j->Attach())
+            {
+                return cost;
+            }
+
+            j->Begin();
+            joycons.push_back(std::move(j));
+        }
+
+        auto drainFor = [&](double s)
+        {
+            const auto end = juce::Time::getMillisecondCounterHiRes() + s * 1000.0;
+
+            while (juce::Time::getMillisecondCounterHiRes() < end)
+            {
+                for (auto& j : joycons)
+                {
+                    j->Update();
+                }
+
+                juce::Thread::sleep(cycleMs);
+            }
+        };
+
+        auto reports = [&]
+        {
+            juce::uint64 n = 0;
+            for (auto& t : telemetry)
+            {
+                n += t->history.getNumWritten();
+            }
+            return n;
+        };
+
+        drainFor(0.5);  // past the attach and the first reports
+
+        const auto startMs = juce::Time::getMillisecondCounterHiRes();
+        const auto startProcess = getProcessCpuSeconds();
+        const auto startThread = getThreadCpuSeconds();
+        const auto startReports = reports();
+
+        drainFor(seconds);
+
+        const auto elapsed = (juce::Time::getMillisecondCounterHiRes() - startMs) * 0.001;
+        const auto cpu = (getProcessCpuSeconds() - startProcess) - (getThreadCpuSeconds() - startThread);
+
+        cost.ran = true;
+        cost.cpuPercent = 100.0 * cpu / elapsed / numControllers;
+        cost.reportsPerSecond = (double)(reports() - startReports) / elapsed / numControllers;
+
+        joycons.clear();
+        return cost;
+    }
+
+    int runBenchmark(const juce::ArgumentList& args)
+    {
+        const auto which = args.getValueForOption("--bench");
+
+        if (which == "imu")
+        {
+            const auto controllers = args.containsOption("--controllers") ? args.getValueForOption("--controllers").getIntValue() : 8;
+            std::cout << ImuBatch::benchmark(controllers, 2000).toString() << std::endl;
+            return 0;
+        }
+
+        if (which == "gestures")
+        {
+            const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--replay"));
+            if (!file.existsAsFile())
+            {
+                std::cerr << "--bench=gestures needs --replay=<capture>" << std::endl;
+                return 1;
+            }
+
+            std::cout << GestureEngine::benchmark(file).toString(GestureEngine::getDefaultTemplates()) << std::endl;
+            return 0;
+        }
+
+        if (which == "smoothing")
+        {
+            const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--replay"));
+            if (!file.existsAsFile())
+            {
+                std::cerr << "--bench=smoothing needs --replay=<capture>" << std::endl;
+                return 1;
+            }
+
+            std::cout << OneEuroBank::toString(OneEuroBank::benchmark(file, OneEuroBank::getBenchmarkCandidates())) << std::endl;
+            return 0;
+        }
+
+        if (which == "osc")
+        {
+            const auto settings = OscSettings::fromString(args.getValueForOption("--osc"));
+            std::cout << OscSender::testLoopback(2.0, 200.0, settings.maxRateHz).toString() << std::endl;
+            return 0;
+        }
+
+        if (which == "wakeup")
+        {
+            // every policy, pinned and not, unless --rt asks for one configuration
+            if (args.containsOption("--rt"))
+            {
+                const auto config = RealtimeConfig::fromString(args.getValueForOption("--rt"));
+                std::cout << WakeupJitter::measure(config, cycleMs * 1000, 2000).toString() << std::endl;
+            }
+            else
+            {
+                std::cout << WakeupJitter::compare({}, cycleMs * 1000, 1000) << std::flush;
+            }
+
+            return 0;
+        }
+
+        if (which == "backends")
+        {
+            const auto controllers = juce::jmax(1, args.containsOption("--controllers") ? args.getValueForOption("--controllers").getIntValue() : 8);
+            const auto seconds = args.containsOption("--seconds") ? juce::jmax(1.0, args.getValueForOption("--seconds").getDoubleValue()) : 10.0;
+
+            const auto threads = measureBackend(controllers, seconds, nullptr);
+
+            BackendCost hub;
+            if (HidrawHub::isAvailable())
+            {
+                HidrawHub h;
+                h.setRealtimeConfig(RealtimeConfig::fromString(args.getValueForOption("--rt")));
+                hub = measureBackend(controllers, seconds, &h);
+            }
+
+            if (!threads.ran)
+            {
+                std::cerr << "simulated controllers need timer descriptors (Linux)" << std::endl;
+                return 1;
+            }
+
+            auto column = [](const BackendCost& c, double v, int places)
+            {
+                return (c.ran ? juce::String(v, places) : juce::String("n/a")).paddedLeft(' ', 12);
+            };
+
+            std::cout << controllers << " simulated controllers, " << juce::String(seconds, 1) << " s each\n"
+                      << "                      poll threads  hidraw hub\n"
+                      << "  cpu % / controller  " << column(threads, threads.cpuPercent, 3) << column(hub, hub.cpuPercent, 3) << "\n"
+                      << "  reports/s / ctl     " << column(threads, threads.reportsPerSecond, 1) << column(hub, hub.reportsPerSecond, 1) << "\n";
+
+            if (!hub.ran)
+            {
+                std::cout << "  (hub: built without JOYCON_HIDRAW_BACKEND)\n";
+            }
+
+            std::cout << std::flush;
+            return 0;
+        }
+
+        std::cerr << usage;
+        return 1;
+    }
+
+    std::unique_ptr<Output> createOutput(const juce::String& spec)
+    {
+        if (spec.isEmpty() || spec == "stdout")
+        {
+            return std::make_unique<TextOutput>();
+        }
+
+        if (spec == "none")
+        {
+            return std::make_unique<NullOutput>();
+        }
+
+        if (spec.startsWith("file:"))
+        {
+            auto out = std::make_unique<BinaryOutput>(juce::File::getCurrentWorkingDirectory().getChildFile(spec.fromFirstOccurrenceOf("file:", false, false)));
+            return out->openedOk() ? std::move(out) : nullptr;
+        }
+
+        if (spec == "midi" || spec.startsWith("midi:"))
+        {
+            auto out = std::make_unique<MidiPortOutput>(spec.fromFirstOccurrenceOf("midi:", false, false));
+            return out->openedOk() ? std::move(out) : nullptr;
+        }
+
+        return nullptr;
+    }
+
+    bool attach(Controller& c, std::unique_ptr<HidTransport> transport, bool isLeft, const juce::String& path,
+                const Joycon::Calibration* calibration, const RealtimeConfig& rt, int index)
+    {
+        c.joycon = std::make_unique<Joycon>(std::move(transport), true, true, 0.05f, isLeft, path);
+        c.joycon->SetTelemetry(&c.telemetry);
+        c.joycon->SetGestureEngine(&c.gestures);
+        c.joycon->SetRealtimeConfig(rt);
+
+        if (calibration != nullptr)
+        {
+            c.joycon->SetCalibration(*calibration);
+        }
+
+        // one MIDI channel per controller
+        auto mappings = Mapping::getDefaults();
+        for (auto& m : mappings)
+        {
+            m.channel = juce::jlimit(1, 16, index + 1);
+        }
+        c.mapping.setMappings(mappings);
+
+        auto templates = GestureEngine::getDefaultTemplates();
+        for (auto& t : templates)
+        {
+            t.channel = juce::jlimit(1, 16, index + 1);
+        }
+        c.gestures.setTemplates(templates);
+        c.gestureNotes.prepare(sampleRate);
+
+        if (!c.joycon->Attach())
+        {
+            return false;
+        }
+
+        c.joycon->Begin();
+        return true;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    if (args.containsOption("--bench"))
+    {
+        return runBenchmark(args);
+    }
+
+    hid_init();
+
+    if (args.containsOption("--list"))
+    {
+        for (auto& d : DeviceWatcher::enumerate())
+        {
+            std::cout << d.path << "  " << d.product << "  " << d.serial << std::endl;
+        }
+
+        hid_exit();
+        return 0;
+    }
+
+    const auto rt = RealtimeConfig::fromString(args.getValueForOption("--rt"));
+    const auto outputSpec = args.getValueForOption("--out");
+    auto output = createOutput(outputSpec);
+
+    if (output == nullptr)
+    {
+        std::cerr << "can't open output " << outputSpec << std::endl;
+        hid_exit();
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Controller>> controllers;
+
+    auto addController = [&](const juce::String& name, std::unique_ptr<HidTransport> transport, bool isLeft,
+                             const juce::String& path, const Joycon::Calibration* calibration) -> Controller*
+    {
+        auto c = std::make_unique<Controller>();
+        c->name = name;
+
+        if (!attach(*c, std::move(transport), isLeft, path, calibration, rt, (int)controllers.size()))
+        {
+            std::cerr << "failed to attach " << name << std::endl;
+            return nullptr;
+        }
+
+        controllers.push_back(std::move(c));
+        return controllers.back().get();
+    };
+
+    // real controllers
+    const auto device = args.getValueForOption("--device");
+    const bool anySource = args.containsOption("--device") || args.containsOption("--simulate") || args.containsOption("--replay");
+
+    if (!anySource || device.isNotEmpty())
+    {
+        for (auto& d : DeviceWatcher::enumerate())
+        {
+            if (anySource && device != "all" && d.path != device)
+            {
+                continue;
+            }
+
+            if (auto transport = HidTransport::open(d.path))
+            {
+                addController(d.product + " " + d.serial, std::move(transport), d.productId == Joycon::product_id_left, d.path, nullptr);
+            }
+        }
+    }
+
+    // simulated controllers, alternating left and right
+    for (int i = 0; i < args.getValueForOption("--simulate").getIntValue(); ++i)
+    {
+        addController("simulated " + juce::String(i), std::make_unique<SimulatedTransport>(i % 2 == 0, i), i % 2 == 0, {}, nullptr);
+    }
+
+    // replays
+    for (auto& path : juce::StringArray::fromTokens(args.getValueForOption("--replay"), ",", ""))
+    {
+        const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(path.trim());
+        auto transport = std::make_unique<ReplayTransport>(file, !args.containsOption("--fast"), args.containsOption("--loop"));
+
+        if (!transport->openedOk())
+        {
+            std::cerr << "can't read capture " << file.getFullPathName() << std::endl;
+            continue;
+        }
+
+        const auto& header = transport->getHeader();
+        Joycon::Calibration cal;
+        cal.stick = header.stickCalibration;
+        cal.deadzone = header.deadzone;
+        cal.gyroNeutral = { header.gyroNeutral[0], header.gyroNeutral[1], header.gyroNeutral[2] };
+
+        auto* replay = transport.get();
+        if (auto* c = addController(file.getFileName(), std::move(transport), header.isLeft, {}, &cal))
+        {
+            c->replay = replay;
+        }
+    }
+
+    if (controllers.empty())
+    {
+        std::cerr << "no controllers\n\n" << usage;
+        hid_exit();
+        return 1;
+    }
+
+    if (args.containsOption("--pair"))
+    {
+        for (size_t i = 0; i + 1 < controllers.size(); i += 2)
+        {
+            auto& c = *controllers[i];
+            auto& partner = *controllers[i + 1];
+
+            c.pair = std::make_unique<JoyconPair>();
+            c.pair->setSources(&c.telemetry, &partner.telemetry);
+            c.partnerName = partner.name;
+            partner.isPartner = true;
+
+            // the partner's gestures play on the pair's channel
+            partner.gestures.setTemplates(c.gestures.getTemplates());
+        }
+    }
+
+    if (args.containsOption("--osc"))
+    {
+        for (int index = 0; index < (int)controllers.size(); ++index)
+        {
+            auto& c = *controllers[(size_t)index];
+            if (c.isPartner)
+            {
+                continue;
+            }
+
+            auto settings = OscSettings::fromString(args.getValueForOption("--osc"));
+            settings.prefix = settings.prefix + "/" + juce::String(index);
+
+            if (!c.osc.start(settings, c.gestures.getTemplates()))
+            {
+                std::cerr << "can't start OSC output to " << settings.toString() << std::endl;
+            }
+        }
+    }
+
+    // raw capture of the first controller
+    std::unique_ptr<CaptureWriter> capture;
+    if (args.containsOption("--capture"))
+    {
+        auto& first = *controllers.front();
+        const auto cal = first.joycon->GetCalibration();
+
+        CaptureHeader header;
+        header.isLeft = first.joycon->isLeft;
+        header.stickCalibration = cal.stick;
+        header.deadzone = cal.deadzone;
+        header.gyroNeutral = { cal.gyroNeutral.x, cal.gyroNeutral.y, cal.gyroNeutral.z };
+
+        capture = std::make_unique<CaptureWriter>(juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--capture")), header);
+
+        if (capture->openedOk())
+        {
+            first.joycon->SetCapture(capture.get());
+        }
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    // the pipeline cycle and the summaries run as scheduler tasks; this thread only waits for the end
+    juce::SharedResourcePointer<Scheduler> scheduler;
+    scheduler->setRealtimeConfig(rt);
+
+    const auto seconds = args.getValueForOption("--seconds").getDoubleValue();
+    const auto summaryEvery = args.containsOption("--summary") ? args.getValueForOption("--summary").getDoubleValue() : 5.0;
+
+    ImuBatch batch;
+    juce::MidiBuffer midi;
+    juce::AudioBuffer<float> audio(2, cycleSamples);
+    midi.ensureSize(4096);
+
+    Timing cycleTiming, outputLatency, cycleTimingTotal, outputLatencyTotal;
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    auto lastSummary = startTicks;
+    std::atomic<double> pipelineCpu { 0.0 };        // of the scheduler thread, as of the last cycle
+    double cpuAtSummary = 0.0;
+    LatencyCounts latenessAtSummary {};
+    std::atomic<bool> finished { false };
+
+    auto elapsedSeconds = [&](juce::int64 ticks) { return juce::Time::highResolutionTicksToSeconds(ticks - startTicks); };
+
+    auto printSummary = [&](juce::int64 now, bool final)
+    {
+        const auto interval = final ? elapsedSeconds(now) : juce::Time::highResolutionTicksToSeconds(now - lastSummary);
+        const auto cpu = pipelineCpu.load();
+
+        std::cerr << (final ? "total" : "summary") << " at " << juce::String(elapsedSeconds(now), 1) << "s\n";
+
+        for (auto& cp : controllers)
+        {
+            auto& c = *cp;
+            const auto lag = getCounts(c.telemetry.dequeueLag);
+            const auto packets = getCounts(c.telemetry.packetInterval);
+
+            const LatencyCounts zero {};
+            const auto& lagBase = final ? zero : c.lagAtSummary;
+            const auto& packetBase = final ? zero : c.intervalAtSummary;
+
+            const auto reports = histogramCount(packets, packetBase);
+            const auto samples = final ? c.samples : c.samples - c.samplesAtSummary;
+            const auto imuSamples = final ? c.imuSamples : c.imuSamples - c.imuSamplesAtSummary;
+            const auto events = final ? c.events : c.events - c.eventsAtSummary;
+            auto& stats = c.joycon->GetConnectionStats();
+
+            std::cerr << "  " << c.name
+                      << ": " << juce::String((double)reports / interval, 1) << " reports/s"
+                      << ", " << juce::String((double)samples / interval, 1) << " frames/s"
+                      << ", " << juce::String((double)imuSamples / interval, 1) << " IMU samples/s"
+                      << " (" << (int)c.imuReader.getNumOverruns() << " missed)"
+                      << ", " << juce::String((double)events / interval, 1) << " MIDI/s"
+                      << ", queue lag p50 " << histogramPercentile(lag, lagBase, 0.5)
+                      << " p99 " << histogramPercentile(lag, lagBase, 0.99) << " ms"
+                      << ", overflows " << (int)c.joycon->GetQueueOverflows()
+                      << ", drops " << (int)stats.drops.load()
+                      << ", poll cpu " << juce::String(c.joycon->GetPollCpuSeconds(), 2) << "s"
+                      << ", gesture " << juce::String(c.gestures.getNanosecondsPerSample(), 0) << " ns/sample\n";
+
+            if (c.pair != nullptr)
+            {
+                const auto skew = getCounts(c.pair->getSkewHistogram());
+
+                const auto& skewBase = final ? zero : c.skewAtSummary;
+                const auto skewStats = c.pair->getSkewStats();
+
+                std::cerr << "    paired with " << c.partnerName << ": skew p50 " << histogramPercentile(skew, skewBase, 0.5)
+                          << " p99 " << histogramPercentile(skew, skewBase, 0.99) << " ms, max " << juce::String(skewStats.maxAbsMs, 1)
+                          << " ms, held " << (int)skewStats.held << " of " << (int)skewStats.updates << "\n";
+
+                c.skewAtSummary = skew;
+            }
+
+            if (c.osc.isRunning())
+            {
+                const auto osc = c.osc.getStats();
+                std::cerr << "    osc: " << juce::String(osc.packetsPerSecond, 1) << " packets/s, "
+                          << juce::String(osc.bytesPerSecond / 1024.0, 1) << " KiB/s, " << (int)osc.packets << " sent"
+                          << ", queue full " << (int)osc.queueFull << ", errors " << (int)osc.sendErrors << "\n";
+            }
+
+            c.lagAtSummary = lag;
+            c.intervalAtSummary = packets;
+            c.samplesAtSummary = c.samples;
+            c.imuSamplesAtSummary = c.imuSamples;
+            c.eventsAtSummary = c.events;
+        }
+
+        const auto& cycles = final ? cycleTimingTotal : cycleTiming;
+        const auto& latency = final ? outputLatencyTotal : outputLatency;
+
+        std::cerr << "  pipeline: cycle " << juce::String(cycles.mean(), 1) << " us avg, " << juce::String(cycles.maxUs, 1) << " us max"
+                  << "; frame to output " << juce::String(latency.mean(), 1) << " us avg, " << juce::String(latency.maxUs, 1) << " us max"
+                  << "; cpu " << juce::String(100.0 * (cpu - (final ? 0.0 : cpuAtSummary)) / interval, 1) << "%\n";
+
+        const auto lateness = getCounts(scheduler->getLateness());
+
+        const LatencyCounts noLateness {};
+        const auto& latenessBase = final ? noLateness : latenessAtSummary;
+        const auto binMs = scheduler->getLateness().getBinWidthMs();
+
+        std::cerr << "  scheduler: lateness p50 " << juce::String(histogramPercentile(lateness, latenessBase, 0.5) * binMs, 1)
+                  << " p99 " << juce::String(histogramPercentile(lateness, latenessBase, 0.99) * binMs, 1)
+                  << " ms, max " << juce::String(scheduler->getMaxLatenessMs(), 2) << " ms"
+                  << ", " << (int)histogramCount(lateness, latenessBase) << " runs"
+                  << (scheduler->isRealtimeConfigApplied() ? "" : ", --rt not permitted") << "\n";
+
+        if (AllocationCounter::isEnabled())
+        {
+            std::cerr << "  allocation violations: " << (int)AllocationCounter::getNumViolations();
+            if (AllocationCounter::getNumViolations() > 0)
+            {
+                std::cerr << " (last in " << AllocationCounter::getLastViolation() << ")";
+            }
+            std::cerr << "\n";
+        }
+
+        std::cerr.flush();
+
+        cycleTiming = {};
+        outputLatency = {};
+        cpuAtSummary = cpu;
+        latenessAtSummary = lateness;
+        lastSummary = now;
+    };
+
+    auto runCycle = [&]
+    {
+        const auto cycleStart = juce::Time::getHighResolutionTicks();
+        const auto nowMs = elapsedSeconds(cycleStart) * 1000.0;
+
+        batch.clear();
+        for (auto& c : controllers)
+        {
+            c->joycon->Update(&batch);
+        }
+
+        batch.process();
+
+        for (auto& c : controllers)
+        {
+            c->joycon->ApplyImuBatch(batch);
+        }
+
+        for (int index = 0; index < (int)controllers.size(); ++index)
+        {
+            auto& c = *controllers[(size_t)index];
+            const auto numRecent = c.telemetry.history.readLatest(c.recent.data(), (int)c.recent.size());
+
+            for (int i = 0; i < numRecent; ++i)
+            {
+                const auto& sample = c.recent[(size_t)i];
+
+                if (sample.ticks <= c.lastTicks)
+                {
+                    continue;
+                }
+
+                c.lastTicks = sample.ticks;
+                ++c.samples;
+
+                if (c.isPartner || c.pair != nullptr)
+                {
+                    continue;
+                }
+
+                midi.clear();
+                c.mapping.process(SourceFrame::fromTelemetry(sample), midi, audio);
+
+                const auto sampleMs = elapsedSeconds(sample.ticks) * 1000.0;
+                for (const auto m : midi)
+                {
+                    output->write(sampleMs, index, m);
+                    ++c.events;
+                }
+
+                if (!midi.isEmpty())
+                {
+                    const auto us = ticksToUs(juce::Time::getHighResolutionTicks() - sample.ticks);
+                    outputLatency.record(us);
+                    outputLatencyTotal.record(us);
+                }
+            }
+
+            // the full rate IMU stream; nothing consumes it here beyond counting
+            while (const auto n = c.imuReader.read(c.imuRecords.data(), (int)c.imuRecords.size()))
+            {
+                c.imuSamples += (juce::uint64)n;
+            }
+
+            if (c.pair != nullptr)
+            {
+                SourceFrame frame;
+
+                if (c.pair->read(frame) && frame.timeSeconds > c.lastPairSeconds)
+                {
+                    c.lastPairSeconds = frame.timeSeconds;
+
+                    midi.clear();
+                    c.mapping.process(frame, midi, audio);
+
+                    for (const auto m : midi)
+                    {
+                        output->write(nowMs, index, m);
+                        ++c.events;
+                    }
+
+                    c.osc.publish(frame, &c.gestures);
+                }
+            }
+            else if (numRecent > 0 && !c.isPartner)
+            {
+                c.osc.publish(SourceFrame::fromTelemetry(c.recent[(size_t)numRecent - 1]), &c.gestures);
+            }
+
+            midi.clear();
+            c.gestureNotes.process(c.gestures, midi, cycleSamples);
+
+            for (const auto m : midi)
+            {
+                output->write(nowMs + m.samplePosition * 1000.0 / sampleRate, index, m);
+                ++c.events;
+            }
+        }
+
+        output->flush();
+
+        const auto cycleEnd = juce::Time::getHighResolutionTicks();
+        cycleTiming.record(ticksToUs(cycleEnd - cycleStart));
+        cycleTimingTotal.record(ticksToUs(cycleEnd - cycleStart));
+        pipelineCpu = getThreadCpuSeconds();
+
+        // stop after --seconds, or once every controller is a replay that has run out
+        const bool allReplaysDone = std::all_of(controllers.begin(), controllers.end(),
+                                                [](auto& c) { return c->replay != nullptr && c->replay->isFinished(); });
+
+        if ((seconds > 0 && elapsedSeconds(cycleEnd) >= seconds) || allReplaysDone)
+        {
+            finished = true;
+        }
+    };
+
+    const auto cycleTask = scheduler->schedule(0.0, runCycle, cycleMs);
+    const auto summaryTask = summaryEvery > 0
+                           ? scheduler->schedule(summaryEvery * 1000.0, [&] { printSummary(juce::Time::getHighResolutionTicks(), false); }, summaryEvery * 1000.0)
+                           : 0;
+
+    while (!stopRequested && !finished)
+    {
+        juce::Thread::sleep(20);
+    }
+
+    scheduler->cancel(summaryTask);
+    scheduler->cancel(cycleTask);
+
+    printSummary(juce::Time::getHighResolutionTicks(), true);
+
+    for (auto& c : controllers)
+    {
+        c->osc.stop();
+        c->joycon->SetCapture(nullptr);
+        c->joycon->Detach();
+    }
+
+    controllers.clear();
+    capture.reset();
+    output->flush();
+
+    hid_exit();
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "ControllerParameters.h"
+
+ControllerParameters::ControllerParameters(juce::AudioProcessor& processor, double maxRateHz)
+    : minIntervalMs(1000.0 / juce::jmax(1.0, maxRateHz))
+{
+    for (int source = 0; source < MappingSource::numSources; ++source)
+    {
+        const auto name = MappingSource::getName(source);
+        juce::RangedAudioParameter* p = nullptr;
+
+        if (MappingSource::isButton(source))
+        {
+            p = new juce::AudioParameterBool(name, name, false);
+        }
+        else
+        {
+            const auto range = MappingSource::getRange(source);
+            p = new juce::AudioParameterFloat(name, name, juce::NormalisableRange<float>(range.getStart(), range.getEnd()),
+                                              juce::jlimit(range.getStart(), range.getEnd(), 0.f));
+        }
+
+        processor.addParameter(p);
+        slots[(size_t)source].parameter = p;
+    }
+}
+
+void ControllerParameters::publish(const SourceFrame& frame)
+{
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        auto& slot = slots[i];
+        const auto v = slot.parameter->convertTo0to1(frame.values[i]);
+
+        if (std::abs(v - slot.lastSent) < threshold)
+        {
+            if (slot.inGesture && now - slot.lastMovedMs > gestureIdleMs)
+            {
+                slot.parameter->endChangeGesture();
+                slot.inGesture = false;
+            }
+
+            continue;
+        }
+
+        slot.lastMovedMs = now;
+
+        if (now - slot.lastSentMs < minIntervalMs)
+        {
+            continue;
+        }
+
+        if (!slot.inGesture)
+        {
+            slot.parameter->beginChangeGesture();
+            slot.inGesture = true;
+        }
+
+        slot.parameter->setValueNotifyingHost(v);
+        slot.lastSent = v;
+        slot.lastSentMs = now;
+        ++numNotifications;
+    }
+}
+
+void ControllerParameters::endGestures()
+{
+    for (auto& slot : slots)
+    {
+        if (slot.inGesture)
+        {
+            slot.parameter->endChangeGesture();
+            slot.inGesture = false;
+        }
+    }
+}
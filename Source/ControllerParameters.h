@@ -0,0 +1,53 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "MappingMatrix.h"
+
+/*
+    Exposes every controller source as a host automatable parameter, so the
+    host can record and route motion like any other automation. Axes are
+    AudioParameterFloats in their own units (see MappingSource::getRange),
+    buttons are AudioParameterBools.
+
+    Reports arrive at up to 200 Hz per controller, far more than hosts want
+    to hear about, so publish() only notifies a parameter when it moved by
+    more than a small threshold and no more often than maxRateHz. Each burst
+    of movement is wrapped in a change gesture, ended after a short idle
+    period, so automation recording sees one touch per movement.
+*/
+class ControllerParameters
+{
+public:
+    /* Adds the parameters to the processor; call from its constructor. */
+    explicit ControllerParameters(juce::AudioProcessor& processor, double maxRateHz = 50.0);
+
+    /* Message thread. */
+    void publish(const SourceFrame& frame);
+
+    /* Ends any open gestures, e.g. when the controller is detached. */
+    void endGestures();
+
+    juce::uint32 getNumNotifications() const
+    {
+        return numNotifications;
+    }
+
+private:
+    static constexpr float threshold = 1.f / 512.f;     // normalised
+    static constexpr double gestureIdleMs = 250.0;
+
+    struct Slot
+    {
+        juce::RangedAudioParameter* parameter = nullptr;
+        float lastSent = -1.f;
+        double lastSentMs = 0.0;
+        double lastMovedMs = 0.0;
+        bool inGesture = false;
+    };
+
+    std::array<Slot, MappingSource::numSources> slots;
+    double minIntervalMs;
+    juce::uint32 numNotifications = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ControllerParameters)
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+#if ! JUCE_WINDOWS
+ #include <time.h>
+#endif
+
+#if JUCE_LINUX
+ #include <sys/resource.h>
+#endif
+
+/* CPU time consumed by the calling thread, in seconds. Returns 0 where unsupported. */
+inline double getThreadCpuSeconds()
+{
+   #if ! JUCE_WINDOWS
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    {
+        return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+    }
+   #endif
+
+    return 0.0;
+}
+
+/* CPU time consumed by every thread of the process, in seconds. Returns 0 where unsupported. */
+inline double getProcessCpuSeconds()
+{
+   #if ! JUCE_WINDOWS
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+    {
+        return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+    }
+   #endif
+
+    return 0.0;
+}
+
+/*
+    Times the calling thread has given up the CPU: voluntarily, because it
+    blocked (a contended lock, I/O, a sleep), and involuntarily, because it
+    was preempted. Linux only; zeros elsewhere.
+*/
+struct ThreadContextSwitches
+{
+    juce::int64 voluntary = 0;
+    juce::int64 involuntary = 0;
+
+    static ThreadContextSwitches now()
+    {
+        ThreadContextSwitches c;
+
+       #if JUCE_LINUX
+        rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0)
+        {
+            c.voluntary = usage.ru_nvcsw;
+            c.involuntary = usage.ru_nivcsw;
+        }
+       #endif
+
+        return c;
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    Maps a controller's 8 bit report timer onto the host clock
+    (juce::Time::getMillisecondCounterHiRes()). The timer counts 5 ms ticks,
+    three per 0x30 report, and wraps every 1.28 s; it is unwrapped against
+    the arrival times. The offset between the two clocks is the smallest
+    arrival - device time over the last couple of seconds, i.e. the report
+    that crossed the link fastest, so aligned times carry none of the
+    Bluetooth and scheduling jitter of arrival times and follow slow drift
+    between the clocks as the window moves on.
+*/
+class DeviceClock
+{
+public:
+    static constexpr double tickMs = 5.0;
+    static constexpr int windowReports = 128;       // about 2 s of 0x30 reports
+    static constexpr double maxGapMs = 500.0;       // longer without reports (a dropout) starts over
+
+    /* Report thread. Host time of the report's timer value; never later than arrivalMs. */
+    double align(juce::uint8 timer, double arrivalMs)
+    {
+        if (numReports == 0 || arrivalMs - lastArrivalMs > maxGapMs)
+        {
+            reset();
+            ticks = 0;
+        }
+        else
+        {
+            auto delta = (juce::int64)(juce::uint8)(timer - lastTimer);
+
+            // more than half a wrap since the last report: take the number of wraps from the host clock
+            const auto elapsedTicks = (arrivalMs - lastArrivalMs) / tickMs;
+            if (elapsedTicks > 128.0)
+            {
+                delta += 256 * (juce::int64)std::round((elapsedTicks - (double)delta) / 256.0);
+            }
+
+            ticks += delta;
+        }
+
+        lastTimer = timer;
+        lastArrivalMs = arrivalMs;
+
+        pushOffset(arrivalMs - (double)ticks * tickMs);
+        ++numReports;
+
+        const auto aligned = (double)ticks * tickMs + offsets[(size_t)head];
+        lastJitterMs = arrivalMs - aligned;
+
+        return aligned;
+    }
+
+    /* How much later than the fastest recent report the last one arrived. */
+    double getLastJitterMs() const
+    {
+        return lastJitterMs;
+    }
+
+    void reset()
+    {
+        numReports = 0;
+        head = 0;
+        count = 0;
+        lastJitterMs = 0;
+    }
+
+private:
+    // sliding window minimum: a monotonic queue of offsets, oldest and smallest at head
+    void pushOffset(double offset)
+    {
+        if (count > 0 && indices[(size_t)head] <= numReports - windowReports)
+        {
+            head = (head + 1) % windowReports;
+            --count;
+        }
+
+        while (count > 0 && offsets[(size_t)((head + count - 1) % windowReports)] >= offset)
+        {
+            --count;
+        }
+
+        const auto tail = (head + count) % windowReports;
+        offsets[(size_t)tail] = offset;
+        indices[(size_t)tail] = numReports;
+        ++count;
+    }
+
+    juce::int64 ticks = 0;
+    juce::int64 numReports = 0;
+    juce::uint8 lastTimer = 0;
+    double lastArrivalMs = 0;
+    double lastJitterMs = 0;
+
+    std::array<double, windowReports> offsets {};
+    std::array<juce::int64, windowReports> indices {};
+    int head = 0;
+    int count = 0;
+};
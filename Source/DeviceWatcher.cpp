@@ -0,0 +1,119 @@
+#include "DeviceWatcher.h"
+#include "joycon.hpp"
+
+DeviceWatcher::DeviceWatcher(int rescanIntervalMs) : juce::Thread("hid watcher"), interval(rescanIntervalMs)
+{
+}
+
+DeviceWatcher::~DeviceWatcher()
+{
+    stop();
+}
+
+void DeviceWatcher::start()
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+void DeviceWatcher::stop()
+{
+    stopThread(2000);
+    cancelPendingUpdate();
+}
+
+void DeviceWatcher::rescanNow()
+{
+    notify();
+}
+
+std::vector<HidDeviceEntry> DeviceWatcher::getDevices() const
+{
+    juce::ScopedLock l(lock);
+    return devices;
+}
+
+std::vector<HidDeviceEntry> DeviceWatcher::enumerate()
+{
+    std::vector<HidDeviceEntry> found;
+
+    auto* head = hid_enumerate(0, 0);
+
+    for (auto* info = head; info != nullptr; info = info->next)
+    {
+        juce::String product(info->product_string);
+
+        if (product.isNotEmpty() && (info->vendor_id == Joycon::vendor_id))
+        {
+            HidDeviceEntry e;
+            e.path = juce::String(info->path);
+            e.product = product;
+            e.serial = juce::String(info->serial_number);
+            e.vendorId = info->vendor_id;
+            e.productId = info->product_id;
+            found.push_back(e);
+        }
+    }
+
+    hid_free_enumeration(head);
+
+    return found;
+}
+
+void DeviceWatcher::run()
+{
+    while (!threadShouldExit())
+    {
+        auto found = enumerate();
+
+        {
+            juce::ScopedLock l(lock);
+
+            for (auto& d : devices)
+            {
+                if (std::find(found.begin(), found.end(), d) == found.end())
+                {
+                    pending.push_back({ false, d });
+                }
+            }
+
+            for (auto& d : found)
+            {
+                if (std::find(devices.begin(), devices.end(), d) == devices.end())
+                {
+                    pending.push_back({ true, d });
+                }
+            }
+
+            devices.swap(found);
+
+            if (!pending.empty())
+            {
+                triggerAsyncUpdate();
+            }
+        }
+
+        wait(interval);
+    }
+}
+
+void DeviceWatcher::handleAsyncUpdate()
+{
+    std::vector<Change> changes;
+
+    {
+        juce::ScopedLock l(lock);
+        changes.swap(pending);
+    }
+
+    for (auto& c : changes)
+    {
+        if (c.added)
+        {
+            listeners.call([&](Listener& l) { l.joyconAdded(c.device); });
+        }
+        else
+        {
+            listeners.call([&](Listener& l) { l.joyconRemoved(c.device); });
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "hidapi.h"
+
+/* Owned copy of the parts of hid_device_info we need after the enumeration is freed. */
+struct HidDeviceEntry
+{
+    juce::String path;
+    juce::String product;
+    juce::String serial;
+    juce::uint16 vendorId = 0;
+    juce::uint16 productId = 0;
+
+    bool operator== (const HidDeviceEntry& other) const
+    {
+        return path == other.path && serial == other.serial && productId == other.productId;
+    }
+
+    /* Bluetooth Joy-Cons report their MAC as serial, which survives a reconnect while the path does not. */
+    bool isSameController(const HidDeviceEntry& other) const
+    {
+        return serial.isNotEmpty() ? (serial == other.serial) : (path == other.path);
+    }
+};
+
+/*
+    Re-enumerates HID devices on a background thread and keeps a cached,
+    diffed list of Joy-Cons. Callers read the cache without touching hidapi;
+    add/remove notifications are delivered to listeners on the message thread.
+*/
+class DeviceWatcher : private juce::Thread, private juce::AsyncUpdater
+{
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+        virtual void joyconAdded(const HidDeviceEntry&) {}
+        virtual void joyconRemoved(const HidDeviceEntry&) {}
+    };
+
+    explicit DeviceWatcher(int rescanIntervalMs = 1000);
+    ~DeviceWatcher() override;
+
+    void start();
+    void stop();
+
+    /* Wakes the watcher for an immediate rescan, e.g. after a dropout. */
+    void rescanNow();
+
+    /* Snapshot of the last enumeration. Never blocks on hidapi. */
+    std::vector<HidDeviceEntry> getDevices() const;
+
+    void addListener(Listener* l)       { listeners.add(l); }
+    void removeListener(Listener* l)    { listeners.remove(l); }
+
+    /* Blocking enumeration of connected Joy-Cons. */
+    static std::vector<HidDeviceEntry> enumerate();
+
+private:
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    struct Change
+    {
+        bool added;
+        HidDeviceEntry device;
+    };
+
+    const int interval;
+
+    juce::CriticalSection lock;
+    std::vector<HidDeviceEntry> devices;
+    std::vector<Change> pending;
+
+    juce::ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeviceWatcher)
+};
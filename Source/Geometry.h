@@ -0,0 +1,12 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    juce::Vector3D lives in juce_opengl. The plugin links that module anyway;
+    headless targets don't, so they take the header-only template directly
+    rather than pulling in the GUI modules.
+*/
+#if ! JUCE_MODULE_AVAILABLE_juce_opengl
+ #include <juce_opengl/geometry/juce_Vector3D.h>
+#endif
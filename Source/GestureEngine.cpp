@@ -0,0 +1,408 @@
+#include "GestureEngine.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "joycon.hpp"
+
+namespace
+{
+    constexpr float gravityCoeff = 0.02f;          // low pass that tracks gravity
+    constexpr float crossingHysteresis = 0.25f;    // g
+    constexpr float activeEnergy = 0.02f;          // g^2
+    constexpr float activeRate = 60.f;             // deg/s
+    constexpr int quietToReset = 5;                // samples before a new movement gets a new onset
+}
+
+//==============================================================================
+void GestureEngine::WindowMax::push(juce::int64 i, float v)
+{
+    // drop entries that left the window, then everything the new value dominates
+    while (size > 0 && indices[(size_t)head] <= i - windowSize)
+    {
+        head = (head + 1) % windowSize;
+        --size;
+    }
+
+    while (size > 0 && values[(size_t)((head + size - 1) % windowSize)] <= v)
+    {
+        --size;
+    }
+
+    const auto back = (size_t)((head + size) % windowSize);
+    indices[back] = i;
+    values[back] = v;
+    ++size;
+}
+
+float GestureEngine::WindowMax::get() const
+{
+    return size > 0 ? values[(size_t)head] : 0.f;
+}
+
+//==============================================================================
+GestureEngine::GestureEngine()
+{
+    setTemplates(getDefaultTemplates());
+}
+
+std::vector<GestureTemplate> GestureEngine::getDefaultTemplates()
+{
+    std::vector<GestureTemplate> t(5);
+
+    t[0].name = "shake";
+    t[0].minEnergy = 0.8f;
+    t[0].minZeroCrossings = 6;
+    t[0].refractoryMs = 500;
+    t[0].note = 60;
+
+    t[1].name = "rotate cw";
+    t[1].rotationAxis = 2;
+    t[1].minRotation = 90.f;
+    t[1].maxZeroCrossings = 3;
+    t[1].note = 65;
+
+    t[2].name = "rotate ccw";
+    t[2].rotationAxis = 2;
+    t[2].minRotation = -90.f;
+    t[2].maxZeroCrossings = 3;
+    t[2].note = 67;
+
+    t[3].name = "flick";
+    t[3].minJerk = 120.f;
+    t[3].minPeakRate = 500.f;
+    t[3].maxZeroCrossings = 3;
+    t[3].note = 62;
+
+    t[4].name = "tap";
+    t[4].minJerk = 80.f;
+    t[4].maxPeakRate = 120.f;
+    t[4].maxEnergy = 0.3f;
+    t[4].maxZeroCrossings = 1;
+    t[4].settleSamples = 3;
+    t[4].maxDurationMs = 60;
+    t[4].refractoryMs = 150;
+    t[4].note = 64;
+
+    return t;
+}
+
+void GestureEngine::setTemplates(const std::vector<GestureTemplate>& newTemplates)
+{
+    templates.assign(newTemplates.begin(), newTemplates.begin() + juce::jmin((int)newTemplates.size(), maxTemplates));
+    lastFired.fill(-1.0e12);
+    lastOnset.fill(-1.0e12);
+}
+
+bool GestureEngine::matches(const GestureTemplate& t) const
+{
+    auto& f = features;
+
+    if (f.energy < t.minEnergy || f.energy > t.maxEnergy
+     || f.peakJerk < t.minJerk
+     || f.zeroCrossings < t.minZeroCrossings || f.zeroCrossings > t.maxZeroCrossings
+     || f.peakRate < t.minPeakRate || f.peakRate > t.maxPeakRate)
+    {
+        return false;
+    }
+
+    if (t.rotationAxis >= 0 && t.rotationAxis < 3)
+    {
+        const float rotation[3] = { f.rotation.x, f.rotation.y, f.rotation.z };
+        const auto r = rotation[t.rotationAxis];
+
+        return t.minRotation >= 0.f ? r >= t.minRotation : r <= t.minRotation;
+    }
+
+    return true;
+}
+
+void GestureEngine::push(const ImuSample& s)
+{
+    JOYCON_TRACE_SCOPE("GestureEngine::push");
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    const auto dt = index == 0 ? 0.005f : juce::jlimit(0.001f, 0.05f, (float)((s.timeMs - prevTimeMs) * 0.001));
+
+    gravity = gravity + (s.acc - gravity) * gravityCoeff;
+    const auto dynamic = s.acc - gravity;
+
+    const auto energy = dynamic.lengthSquared();
+    const auto jerk = index == 0 ? 0.f : (s.acc - prevAcc).length() / dt;
+    const auto rate = s.gyr.length();
+    const auto rotation = s.gyr * dt;
+
+    const float axes[3] = { dynamic.x, dynamic.y, dynamic.z };
+    juce::uint8 crossings = 0;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const int sign = axes[i] > crossingHysteresis ? 1 : (axes[i] < -crossingHysteresis ? -1 : 0);
+
+        if (sign != 0)
+        {
+            crossings += (lastSign[i] != 0 && sign != lastSign[i]) ? 1 : 0;
+            lastSign[i] = sign;
+        }
+    }
+
+    // running sums: add the new sample, drop the one leaving the window
+    const auto slot = (size_t)(index % windowSize);
+
+    if (index >= windowSize)
+    {
+        energySum -= energyRing[slot];
+        crossingSum -= crossingRing[slot];
+        rotationSum = rotationSum - rotationRing[slot];
+    }
+
+    energyRing[slot] = energy;
+    crossingRing[slot] = crossings;
+    rotationRing[slot] = rotation;
+
+    energySum += energy;
+    crossingSum += crossings;
+    rotationSum = rotationSum + rotation;
+
+    jerkMax.push(index, jerk);
+    rateMax.push(index, rate);
+
+    const auto n = (int)juce::jmin<juce::int64>(index + 1, windowSize);
+    features.energy = (float)(juce::jmax(0.0, energySum) / n);
+    features.peakJerk = jerkMax.get();
+    features.zeroCrossings = crossingSum;
+    features.peakRate = rateMax.get();
+    features.rotation = rotationSum;
+
+    // onset of the current movement, for latency measurement
+    if (energy > activeEnergy || rate > activeRate)
+    {
+        if (quietSamples >= quietToReset || index == 0)
+        {
+            onsetMs = s.timeMs;
+        }
+
+        quietSamples = 0;
+    }
+    else
+    {
+        ++quietSamples;
+    }
+
+    for (size_t i = 0; i < templates.size(); ++i)
+    {
+        auto& t = templates[i];
+
+        if (s.timeMs - lastFired[i] < t.refractoryMs || onsetMs == lastOnset[i]
+         || quietSamples < t.settleSamples || s.timeMs - onsetMs > t.maxDurationMs || !matches(t))
+        {
+            continue;
+        }
+
+        lastFired[i] = s.timeMs;
+        lastOnset[i] = onsetMs;
+        detectionCounts[i].fetch_add(1, std::memory_order_relaxed);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+        {
+            auto& e = events[(size_t)start1];
+            e.templateIndex = (int)i;
+            e.onsetMs = juce::jmin(onsetMs, s.timeMs);
+            e.detectedMs = s.timeMs;
+            e.channel = t.channel;
+            e.note = t.note;
+            e.velocity = t.velocity;
+            fifo.finishedWrite(1);
+        }
+        else
+        {
+            droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // one gesture per sample, earlier templates win
+        break;
+    }
+
+    prevAcc = s.acc;
+    prevTimeMs = s.timeMs;
+    ++index;
+
+    totalTicks.fetch_add(juce::Time::getHighResolutionTicks() - startTicks, std::memory_order_relaxed);
+    numSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+int GestureEngine::popEvents(GestureEvent* dest, int maxEvents)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(maxEvents, start1, size1, start2, size2);
+
+    for (int i = 0; i < size1; ++i)
+    {
+        dest[i] = events[(size_t)(start1 + i)];
+    }
+
+    for (int i = 0; i < size2; ++i)
+    {
+        dest[size1 + i] = events[(size_t)(start2 + i)];
+    }
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+double GestureEngine::getNanosecondsPerSample() const
+{
+    const auto n = numSamples.load(std::memory_order_relaxed);
+
+    return n > 0 ? juce::Time::highResolutionTicksToSeconds(totalTicks.load(std::memory_order_relaxed)) * 1.0e9 / (double)n
+                 : 0.0;
+}
+
+//==============================================================================
+void GestureNotePlayer::prepare(double sampleRate, double noteLengthMs)
+{
+    noteLengthSamples = juce::jmax(1, juce::roundToInt(sampleRate * noteLengthMs * 0.001));
+}
+
+void GestureNotePlayer::noteOff(juce::MidiBuffer& midi, int index, int offset)
+{
+    midi.addEvent(juce::MidiMessage::noteOff(held[(size_t)index].channel, held[(size_t)index].note), offset);
+    held[(size_t)index] = held[(size_t)--numHeld];
+}
+
+void GestureNotePlayer::process(GestureEngine& engine, juce::MidiBuffer& midi, int numSamples)
+{
+    for (int i = numHeld; --i >= 0;)
+    {
+        auto& h = held[(size_t)i];
+
+        if (h.samplesLeft < numSamples)
+        {
+            noteOff(midi, i, juce::jmax(0, h.samplesLeft));
+        }
+        else
+        {
+            h.samplesLeft -= numSamples;
+        }
+    }
+
+    const auto numEvents = engine.popEvents(popped.data(), (int)popped.size());
+
+    for (int e = 0; e < numEvents; ++e)
+    {
+        const auto& event = popped[(size_t)e];
+
+        // retrigger rather than stack the same note, and make room if every slot is taken
+        for (int i = numHeld; --i >= 0;)
+        {
+            if (held[(size_t)i].channel == event.channel && held[(size_t)i].note == event.note)
+            {
+                noteOff(midi, i, 0);
+            }
+        }
+
+        if (numHeld == (int)held.size())
+        {
+            noteOff(midi, 0, 0);
+        }
+
+        midi.addEvent(juce::MidiMessage::noteOn(event.channel, event.note, (juce::uint8)event.velocity), 0);
+        held[(size_t)numHeld++] = { event.channel, event.note, noteLengthSamples };
+    }
+}
+
+void GestureNotePlayer::allNotesOff(juce::MidiBuffer& midi)
+{
+    while (numHeld > 0)
+    {
+        noteOff(midi, numHeld - 1, 0);
+    }
+}
+
+//==============================================================================
+GestureEngine::Benchmark GestureEngine::benchmark(const juce::File& capture, const std::vector<GestureTemplate>& templates)
+{
+    Benchmark result;
+    CaptureReader reader(capture);
+
+    if (!reader.openedOk())
+    {
+        return result;
+    }
+
+    const auto& header = reader.getHeader();
+    const juce::Vector3D<int16_t> neutral { header.gyroNeutral[0], header.gyroNeutral[1], header.gyroNeutral[2] };
+
+    GestureEngine engine;
+    engine.setTemplates(templates);
+
+    std::array<juce::uint8, CaptureReader::maxReportLength> report {};
+    std::array<GestureEvent, 64> popped;
+    std::vector<double> latencies;
+    double timeMs = 0;
+    int length = 0;
+
+    while (reader.next(timeMs, report, length))
+    {
+        ++result.reports;
+
+        if (length < 49 || report[0] != 0x30)
+        {
+            continue;
+        }
+
+        for (size_t n = 0; n < 3; ++n)
+        {
+            engine.push(Joycon::DecodeIMUSample(report.data(), n, neutral, header.isLeft, timeMs));
+            ++result.samples;
+        }
+
+        const auto numEvents = engine.popEvents(popped.data(), (int)popped.size());
+
+        for (int i = 0; i < numEvents; ++i)
+        {
+            ++result.detections[(size_t)popped[(size_t)i].templateIndex];
+            latencies.push_back(popped[(size_t)i].detectedMs - popped[(size_t)i].onsetMs);
+        }
+    }
+
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+
+        double sum = 0;
+        for (auto l : latencies)
+        {
+            sum += l;
+        }
+
+        result.meanLatencyMs = sum / (double)latencies.size();
+        result.p95LatencyMs = latencies[(size_t)((double)(latencies.size() - 1) * 0.95)];
+        result.maxLatencyMs = latencies.back();
+    }
+
+    result.nanosecondsPerSample = engine.getNanosecondsPerSample();
+    result.cpuPerController = result.nanosecondsPerSample * 1.0e-9 * 200.0;
+
+    return result;
+}
+
+juce::String GestureEngine::Benchmark::toString(const std::vector<GestureTemplate>& templates) const
+{
+    juce::String s;
+    s << reports << " reports, " << samples << " samples\n";
+
+    for (size_t i = 0; i < templates.size() && i < detections.size(); ++i)
+    {
+        s << "  " << templates[i].name << ": " << detections[i] << "\n";
+    }
+
+    s << "latency mean " << juce::String(meanLatencyMs, 1) << " ms, p95 " << juce::String(p95LatencyMs, 1)
+      << " ms, max " << juce::String(maxLatencyMs, 1) << " ms\n";
+    s << juce::String(nanosecondsPerSample, 1) << " ns/sample, "
+      << juce::String(cpuPerController * 100.0, 4) << "% of a core per controller";
+
+    return s;
+}
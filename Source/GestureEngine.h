@@ -0,0 +1,207 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Geometry.h"
+
+/* One IMU sample after calibration, as ProcessIMU sees it. */
+struct ImuSample
+{
+    double timeMs = 0;                  // report arrival, minus 5 ms per older sample in the report
+    juce::Vector3D<float> acc;          // g
+    juce::Vector3D<float> gyr;          // degrees per second
+};
+
+/*
+    A gesture is the conjunction of these feature bounds, evaluated over the
+    sliding window ending at the current sample.
+*/
+struct GestureTemplate
+{
+    juce::String name;
+
+    float minEnergy = 0.f;              // mean squared dynamic acceleration, g^2
+    float maxEnergy = 1.0e9f;
+    float minJerk = 0.f;                // peak jerk, g/s
+    int minZeroCrossings = 0;           // dynamic acceleration sign changes, all axes
+    int maxZeroCrossings = 1 << 20;
+    float minPeakRate = 0.f;            // peak angular velocity, deg/s
+    float maxPeakRate = 1.0e9f;
+    int rotationAxis = -1;              // 0..2 to require a rotation on that gyro axis
+    float minRotation = 0.f;            // signed degrees over the window, negative for the other direction
+    int settleSamples = 0;              // quiet samples required after the movement, for short impulses
+    double maxDurationMs = 1.0e9;       // movement onset to detection
+
+    int refractoryMs = 300;             // each template also fires at most once per movement
+
+    int channel = 1;
+    int note = 60;
+    int velocity = 100;
+};
+
+struct GestureEvent
+{
+    int templateIndex = -1;
+    double onsetMs = 0;                 // first sample of the movement
+    double detectedMs = 0;              // sample that completed the match
+    int channel = 1;
+    int note = 60;
+    int velocity = 100;
+};
+
+/*
+    Streaming gesture recognition over the IMU sample stream. Every feature is
+    maintained incrementally over a fixed sliding window (running sums and
+    monotonic max queues), so push() is O(1) per sample plus one pass over
+    the templates, and a gesture is reported at most windowSize samples after
+    it starts. Matches go into a lock-free queue for the audio thread.
+*/
+class GestureEngine
+{
+public:
+    static constexpr int windowSize = 48;       // 240 ms at 200 Hz
+    static constexpr int maxTemplates = 16;
+
+    struct Features
+    {
+        float energy = 0;
+        float peakJerk = 0;
+        int zeroCrossings = 0;
+        float peakRate = 0;
+        juce::Vector3D<float> rotation;
+    };
+
+    GestureEngine();
+
+    static std::vector<GestureTemplate> getDefaultTemplates();
+
+    /* Same thread as push(). */
+    void setTemplates(const std::vector<GestureTemplate>& newTemplates);
+
+    const std::vector<GestureTemplate>& getTemplates() const
+    {
+        return templates;
+    }
+
+    /* Controller update thread, once per IMU sample. Never allocates. */
+    void push(const ImuSample& s);
+
+    /* Audio thread. Returns the number of events copied. */
+    int popEvents(GestureEvent* dest, int maxEvents);
+
+    const Features& getFeatures() const
+    {
+        return features;
+    }
+
+    /* Average CPU cost of push(). */
+    double getNanosecondsPerSample() const;
+
+    juce::uint32 getNumDroppedEvents() const
+    {
+        return droppedEvents.load(std::memory_order_relaxed);
+    }
+
+    /* Any thread. Detections of template i so far, for consumers other than the audio thread's queue. */
+    juce::uint32 getNumDetections(int templateIndex) const
+    {
+        return detectionCounts[(size_t)templateIndex].load(std::memory_order_relaxed);
+    }
+
+    struct Benchmark
+    {
+        int reports = 0;
+        int samples = 0;
+        std::array<int, maxTemplates> detections {};
+        double meanLatencyMs = 0;       // detection time minus movement onset
+        double p95LatencyMs = 0;
+        double maxLatencyMs = 0;
+        double nanosecondsPerSample = 0;
+        double cpuPerController = 0;    // fraction of one core at 200 samples/s
+
+        juce::String toString(const std::vector<GestureTemplate>& templates) const;
+    };
+
+    /* Replays a capture (see Capture.h) through a fresh engine with these templates. */
+    static Benchmark benchmark(const juce::File& capture, const std::vector<GestureTemplate>& templates = getDefaultTemplates());
+
+private:
+    /* Sliding window maximum in amortised O(1). */
+    class WindowMax
+    {
+    public:
+        void push(juce::int64 index, float v);
+        float get() const;
+
+    private:
+        std::array<juce::int64, windowSize> indices {};
+        std::array<float, windowSize> values {};
+        int head = 0, size = 0;
+    };
+
+    bool matches(const GestureTemplate& t) const;
+
+    std::vector<GestureTemplate> templates;
+    std::array<double, maxTemplates> lastFired {};
+    std::array<double, maxTemplates> lastOnset {};
+
+    // per sample history
+    std::array<float, windowSize> energyRing {};
+    std::array<juce::uint8, windowSize> crossingRing {};
+    std::array<juce::Vector3D<float>, windowSize> rotationRing {};
+
+    double energySum = 0;
+    int crossingSum = 0;
+    juce::Vector3D<float> rotationSum;
+    WindowMax jerkMax, rateMax;
+
+    juce::int64 index = 0;
+    juce::Vector3D<float> gravity { 0.f, 0.f, 1.f };
+    juce::Vector3D<float> prevAcc;
+    std::array<int, 3> lastSign {};
+    double prevTimeMs = 0;
+    double onsetMs = 0;
+    int quietSamples = 0;
+
+    Features features;
+
+    std::atomic<juce::int64> totalTicks { 0 };
+    std::atomic<juce::int64> numSamples { 0 };
+
+    juce::AbstractFifo fifo { 64 };
+    std::array<GestureEvent, 64> events;
+    std::atomic<juce::uint32> droppedEvents { 0 };
+    std::array<std::atomic<juce::uint32>, maxTemplates> detectionCounts {};
+
+    JUCE_DECLARE_NON_COPYABLE (GestureEngine)
+};
+
+/*
+    Audio thread side: plays each gesture as a fixed length note. Note ons go
+    at the start of the block, the earliest point after detection; note offs
+    are counted down in samples across blocks.
+*/
+class GestureNotePlayer
+{
+public:
+    void prepare(double sampleRate, double noteLengthMs = 100.0);
+
+    void process(GestureEngine& engine, juce::MidiBuffer& midi, int numSamples);
+
+    /* Ends every sounding note at the start of the block. */
+    void allNotesOff(juce::MidiBuffer& midi);
+
+private:
+    struct Held
+    {
+        int channel = 1;
+        int note = 0;
+        int samplesLeft = 0;
+    };
+
+    void noteOff(juce::MidiBuffer& midi, int index, int offset);
+
+    std::array<Held, 32> held;
+    int numHeld = 0;
+    int noteLengthSamples = 4410;
+    std::array<GestureEvent, 16> popped;
+};
@@ -0,0 +1,92 @@
+#include "HidTransport.h"
+
+#if JUCE_LINUX && JOYCON_HIDRAW
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <unistd.h>
+#endif
+
+std::unique_ptr<HidTransport> HidTransport::open(const juce::String& path)
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    if (path.startsWith("/dev/hidraw"))
+    {
+        if (auto t = HidrawTransport::open(path))
+        {
+            return t;
+        }
+    }
+   #endif
+
+    if (auto* dev = hid_open_path(path.toRawUTF8()))
+    {
+        return std::make_unique<HidapiTransport>(dev);
+    }
+
+    return nullptr;
+}
+
+#if JUCE_LINUX && JOYCON_HIDRAW
+HidrawTransport::~HidrawTransport()
+{
+    ::close(fd);
+}
+
+std::unique_ptr<HidTransport> HidrawTransport::open(const juce::String& path)
+{
+    auto fd = ::open(path.toRawUTF8(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    return std::make_unique<HidrawTransport>(fd);
+}
+
+int HidrawTransport::write(const uint8_t* data, size_t len)
+{
+    ssize_t res;
+
+    do
+    {
+        res = ::write(fd, data, len);
+    } while (res < 0 && errno == EINTR);
+
+    return (int)res;
+}
+
+int HidrawTransport::read(uint8_t* data, size_t len, int timeoutMs)
+{
+    if (timeoutMs != 0)
+    {
+        pollfd p { fd, POLLIN, 0 };
+        auto ready = ::poll(&p, 1, timeoutMs);
+
+        if (ready == 0)
+        {
+            return 0;
+        }
+
+        if (ready < 0)
+        {
+            return errno == EINTR ? 0 : -1;
+        }
+
+        if ((p.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+        {
+            return -1;
+        }
+    }
+
+    auto res = ::read(fd, data, len);
+
+    if (res < 0)
+    {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+
+    return (int)res;
+}
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "hidapi.h"
+
+/* Set to 1 (CMake option JOYCON_HIDRAW_BACKEND) to talk to /dev/hidraw* directly on Linux. */
+#ifndef JOYCON_HIDRAW
+ #define JOYCON_HIDRAW 0
+#endif
+
+/*
+    Raw report I/O for one controller. Joycon only talks to the device through
+    this, so the hidapi path, the native hidraw path and simulated devices are
+    interchangeable.
+*/
+class HidTransport
+{
+public:
+    virtual ~HidTransport() = default;
+
+    /* Returns bytes written or -1. data[0] is the report ID. */
+    virtual int write(const uint8_t* data, size_t len) = 0;
+
+    /* Returns bytes read, 0 on timeout, -1 on error. timeoutMs == 0 never blocks, < 0 blocks. */
+    virtual int read(uint8_t* data, size_t len, int timeoutMs) = 0;
+
+    /* Pollable descriptor for event multiplexing, or -1 if the transport has none. */
+    virtual int getFd() const { return -1; }
+
+    /* Opens the native hidraw transport for /dev/hidraw* paths when enabled, hidapi otherwise. */
+    static std::unique_ptr<HidTransport> open(const juce::String& path);
+};
+
+class HidapiTransport : public HidTransport
+{
+public:
+    explicit HidapiTransport(hid_device* d) : dev(d) {}
+
+    ~HidapiTransport() override
+    {
+        if (dev != nullptr)
+        {
+            hid_close(dev);
+        }
+    }
+
+    int write(const uint8_t* data, size_t len) override
+    {
+        return hid_write(dev, data, len);
+    }
+
+    int read(uint8_t* data, size_t len, int timeoutMs) override
+    {
+        // hid_read_timeout with 0 is a non-blocking read, no need to toggle hid_set_nonblocking
+        return hid_read_timeout(dev, data, len, timeoutMs);
+    }
+
+private:
+    hid_device* dev;
+
+    JUCE_DECLARE_NON_COPYABLE(HidapiTransport)
+};
+
+#if JUCE_LINUX && JOYCON_HIDRAW
+class HidrawTransport : public HidTransport
+{
+public:
+    /* Takes ownership of an fd opened O_RDWR | O_NONBLOCK on a /dev/hidraw* node. */
+    explicit HidrawTransport(int fileDescriptor) : fd(fileDescriptor) {}
+    ~HidrawTransport() override;
+
+    static std::unique_ptr<HidTransport> open(const juce::String& path);
+
+    int write(const uint8_t* data, size_t len) override;
+    int read(uint8_t* data, size_t len, int timeoutMs) override;
+    int getFd() const override { return fd; }
+
+private:
+    int fd;
+
+    JUCE_DECLARE_NON_COPYABLE(HidrawTransport)
+};
+#endif
@@ -0,0 +1,183 @@
+#include "HidrawHub.h"
+#include "CpuTime.h"
+
+#if JUCE_LINUX && JOYCON_HIDRAW
+ #include <cerrno>
+ #include <sys/epoll.h>
+ #include <sys/eventfd.h>
+ #include <unistd.h>
+#endif
+
+HidrawHub::HidrawHub() : juce::Thread("hidraw hub")
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epollFd >= 0 && wakeFd >= 0)
+    {
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;  // nullptr marks the wake-up descriptor
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+   #endif
+}
+
+HidrawHub::~HidrawHub()
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    signalThreadShouldExit();
+
+    if (wakeFd >= 0)
+    {
+        uint64_t one = 1;
+        (void)::write(wakeFd, &one, sizeof(one));
+    }
+
+    stopThread(1000);
+
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (epollFd >= 0) ::close(epollFd);
+   #endif
+}
+
+bool HidrawHub::isAvailable()
+{
+    return JUCE_LINUX && JOYCON_HIDRAW;
+}
+
+bool HidrawHub::add(Client& c)
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    if (epollFd < 0 || c.getHubFd() < 0)
+    {
+        return false;
+    }
+
+    {
+        juce::ScopedLock l(lock);
+
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c;
+
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, c.getHubFd(), &ev) != 0)
+        {
+            return false;
+        }
+
+        clients.push_back(&c);
+    }
+
+    if (!isThreadRunning())
+    {
+        startThread(juce::Thread::Priority::highest);
+    }
+
+    return true;
+   #else
+    (void)c;
+    return false;
+   #endif
+}
+
+void HidrawHub::remove(Client& c)
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    {
+        juce::ScopedLock l(lock);
+
+        auto it = std::find(clients.begin(), clients.end(), &c);
+        if (it != clients.end())
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, c.getHubFd(), nullptr);
+            clients.erase(it);
+        }
+    }
+
+    // the hub may have dropped it already and still be calling hubDropped()
+    const juce::ScopedLock waitForCycle(cycleLock);
+   #else
+    (void)c;
+   #endif
+}
+
+int HidrawHub::getNumClients() const
+{
+    juce::ScopedLock l(lock);
+    return (int)clients.size();
+}
+
+void HidrawHub::run()
+{
+   #if JUCE_LINUX && JOYCON_HIDRAW
+    std::array<epoll_event, 64> events;
+    juce::uint32 cycles = 0;
+
+    applyToCurrentThread(rtConfig);
+
+    while (!threadShouldExit())
+    {
+        auto n = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        // clients that fail are dropped once the lock is released: hubDropped() may block on the
+        // client's own thread, which must not hold up add() / remove() or take the locks out of order
+        const juce::ScopedLock cycle(cycleLock);
+        std::array<Client*, 64> dropped;
+        int numDropped = 0;
+
+        {
+            juce::ScopedLock l(lock);
+
+            for (int i = 0; i < n; ++i)
+            {
+                auto* c = static_cast<Client*>(events[(size_t)i].data.ptr);
+
+                if (c == nullptr)
+                {
+                    uint64_t drained;
+                    (void)::read(wakeFd, &drained, sizeof(drained));
+                    continue;
+                }
+
+                // may have been removed earlier in this batch
+                auto it = std::find(clients.begin(), clients.end(), c);
+                if (it == clients.end())
+                {
+                    continue;
+                }
+
+                const bool failed = (events[(size_t)i].events & (EPOLLERR | EPOLLHUP)) != 0;
+
+                if (failed || !c->hubReadable())
+                {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, c->getHubFd(), nullptr);
+                    clients.erase(it);
+                    dropped[(size_t)numDropped++] = c;
+                }
+            }
+        }
+
+        for (int i = 0; i < numDropped; ++i)
+        {
+            dropped[(size_t)i]->hubDropped();
+        }
+
+        if ((++cycles & 63) == 0)
+        {
+            cpuSeconds.store(getThreadCpuSeconds(), std::memory_order_relaxed);
+        }
+    }
+   #endif
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "HidTransport.h"
+#include "ThreadTuning.h"
+
+/*
+    Services every registered controller from one thread using a single epoll
+    set, instead of one polling thread per device. Only available on Linux when
+    built with JOYCON_HIDRAW; elsewhere add() returns false and callers fall
+    back to their own poll thread.
+*/
+class HidrawHub : private juce::Thread
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        virtual int getHubFd() const = 0;
+
+        /* Hub thread: the descriptor is readable. Return false if the device failed. */
+        virtual bool hubReadable() = 0;
+
+        /* Hub thread, outside the hub's lock: the client has been removed after a failure and may start recovering. */
+        virtual void hubDropped() = 0;
+    };
+
+    HidrawHub();
+    ~HidrawHub() override;
+
+    static bool isAvailable();
+
+    /* Registers a client whose getHubFd() is valid. Safe from any thread. */
+    bool add(Client& c);
+
+    /* Once this returns the hub thread no longer touches the client. */
+    void remove(Client& c);
+
+    int getNumClients() const;
+
+    /* Applied when the hub thread starts, i.e. on the first add(). */
+    void setRealtimeConfig(const RealtimeConfig& c)
+    {
+        rtConfig = c;
+    }
+
+    /* CPU time used by the hub thread so far. */
+    double getCpuSeconds() const
+    {
+        return cpuSeconds.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() override;
+
+    int epollFd = -1;
+    int wakeFd = -1;
+
+    juce::CriticalSection lock;
+    std::vector<Client*> clients;
+
+    // held by the hub thread for a whole service cycle, so remove() can wait out a hubDropped() call
+    juce::CriticalSection cycleLock;
+
+    std::atomic<double> cpuSeconds { 0.0 };
+    RealtimeConfig rtConfig;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HidrawHub)
+};
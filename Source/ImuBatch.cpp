@@ -0,0 +1,243 @@
+#include "ImuBatch.h"
+#include "SimdOps.h"
+#include "Trace.h"
+
+#include <cmath>
+
+namespace
+{
+    constexpr float accScale = 0.000244f;
+    constexpr float gyrScale = 0.070f;
+    constexpr float radToDeg = (float)(180.0 / juce::MathConstants<double>::pi);
+    constexpr float halfPi = juce::MathConstants<float>::halfPi;
+
+    // minimax atan on [0, 1], |error| < 1e-5 rad
+    constexpr float atanC0 = 0.9998660f;
+    constexpr float atanC1 = -0.3302995f;
+    constexpr float atanC2 = 0.1801410f;
+    constexpr float atanC3 = -0.0851330f;
+    constexpr float atanC4 = 0.0208351f;
+
+    /* atan(y / x) in degrees for x >= 0, without the division by x blowing up. */
+    template <typename S>
+    typename S::V fastAtanDegrees(typename S::V y, typename S::V x)
+    {
+        auto ay = S::abs(y);
+        auto a = S::div(S::min(ay, x), S::max(S::max(ay, x), S::set(1.0e-30f)));
+        auto s = S::mul(a, a);
+
+        auto p = S::add(S::set(atanC3), S::mul(s, S::set(atanC4)));
+        p = S::add(S::set(atanC2), S::mul(s, p));
+        p = S::add(S::set(atanC1), S::mul(s, p));
+        p = S::add(S::set(atanC0), S::mul(s, p));
+        p = S::mul(a, p);
+
+        auto r = S::select(S::greater(ay, x), S::sub(S::set(halfPi), p), p);
+        return S::mul(S::copySign(r, y), S::set(radToDeg));
+    }
+}
+
+struct ImuBatch::Kernel
+{
+    template <typename S>
+    static void run(ImuBatch& b, int start, int end)
+    {
+        using V = typename S::V;
+
+        for (int i = start; i + S::width <= end; i += S::width)
+        {
+            V ax = S::mul(S::load(b.rawAccX + i), S::set(accScale));
+            V ay = S::mul(S::load(b.rawAccY + i), S::set(accScale));
+            V az = S::mul(S::load(b.rawAccZ + i), S::set(accScale));
+
+            // bias removal
+            V gx = S::mul(S::sub(S::load(b.rawGyrX + i), S::load(b.biasX + i)), S::set(gyrScale));
+            V gy = S::mul(S::sub(S::load(b.rawGyrY + i), S::load(b.biasY + i)), S::set(gyrScale));
+            V gz = S::mul(S::sub(S::load(b.rawGyrZ + i), S::load(b.biasZ + i)), S::set(gyrScale));
+
+            V dt = S::load(b.dt + i);
+            S::store(b.sumX + i, S::mul(gx, dt));
+            S::store(b.sumY + i, S::mul(gy, dt));
+            S::store(b.sumZ + i, S::mul(gz, dt));
+
+            V sign = S::load(b.sign + i);
+            ay = S::mul(ay, sign);
+            az = S::mul(az, sign);
+            gy = S::mul(gy, sign);
+            gz = S::mul(gz, sign);
+
+            S::store(b.accX + i, ax);
+            S::store(b.accY + i, ay);
+            S::store(b.accZ + i, az);
+            S::store(b.gyrX + i, gx);
+            S::store(b.gyrY + i, gy);
+            S::store(b.gyrZ + i, gz);
+
+            V xx = S::mul(ax, ax);
+            V yy = S::mul(ay, ay);
+            V zz = S::mul(az, az);
+
+            V angleX = fastAtanDegrees<S>(ax, S::sqrt(S::add(yy, zz)));
+            V angleY = fastAtanDegrees<S>(ay, S::sqrt(S::add(xx, zz)));
+            V angleZ = fastAtanDegrees<S>(az, S::sqrt(S::add(xx, yy)));
+
+            // complementary filter
+            V alpha = S::load(b.alpha + i);
+            V beta = S::mul(S::sub(S::set(1.0f), alpha), dt);
+            S::store(b.outX + i, S::add(S::mul(alpha, angleX), S::mul(beta, gx)));
+            S::store(b.outY + i, S::add(S::mul(alpha, angleY), S::mul(beta, gy)));
+            S::store(b.outZ + i, S::add(S::mul(alpha, angleZ), S::mul(beta, gz)));
+        }
+    }
+};
+
+ImuBatch::ImuBatch()
+{
+    for (auto* lanes : { &rawAccX, &rawAccY, &rawAccZ, &rawGyrX, &rawGyrY, &rawGyrZ, &biasX, &biasY, &biasZ,
+                         &sign, &alpha, &dt, &accX, &accY, &accZ, &gyrX, &gyrY, &gyrZ,
+                         &sumX, &sumY, &sumZ, &outX, &outY, &outZ })
+    {
+        lanes->calloc((size_t)maxLanes);
+    }
+
+    time.calloc((size_t)maxLanes);
+}
+
+int ImuBatch::add(const juce::Vector3D<int16_t>& accRaw, const juce::Vector3D<int16_t>& gyrRaw,
+                  const juce::Vector3D<int16_t>& gyrNeutral, bool mirror, float a, float dtSec, double timeMs)
+{
+    if (numLanes >= maxLanes)
+    {
+        return -1;
+    }
+
+    const int i = numLanes++;
+
+    rawAccX[i] = accRaw.x;
+    rawAccY[i] = accRaw.y;
+    rawAccZ[i] = accRaw.z;
+    rawGyrX[i] = gyrRaw.x;
+    rawGyrY[i] = gyrRaw.y;
+    rawGyrZ[i] = gyrRaw.z;
+    biasX[i] = gyrNeutral.x;
+    biasY[i] = gyrNeutral.y;
+    biasZ[i] = gyrNeutral.z;
+    sign[i] = mirror ? -1.0f : 1.0f;
+    alpha[i] = a;
+    dt[i] = dtSec;
+    time[i] = timeMs;
+
+    return i;
+}
+
+void ImuBatch::process()
+{
+    JOYCON_TRACE_SCOPE("ImuBatch::process");
+
+    const int vectorEnd = numLanes - numLanes % SimdOps::width;
+
+    Kernel::run<SimdOps>(*this, 0, vectorEnd);
+    Kernel::run<ScalarOps>(*this, vectorEnd, numLanes);
+}
+
+void ImuBatch::processScalar()
+{
+    constexpr double toDegrees = 180.0 / juce::MathConstants<double>::pi;
+
+    for (int i = 0; i < numLanes; ++i)
+    {
+        // mirrors Joycon::ExtractIMUValues / ProcessIMU, in double so it can check the float paths
+        double ax = (double)(int16_t)rawAccX[i] * (double)accScale;
+        double ay = (double)(int16_t)rawAccY[i] * (double)accScale;
+        double az = (double)(int16_t)rawAccZ[i] * (double)accScale;
+        double gx = (double)((int)rawGyrX[i] - (int)biasX[i]) * (double)gyrScale;
+        double gy = (double)((int)rawGyrY[i] - (int)biasY[i]) * (double)gyrScale;
+        double gz = (double)((int)rawGyrZ[i] - (int)biasZ[i]) * (double)gyrScale;
+
+        const double dtSec = dt[i];
+        const double mirror = sign[i];
+
+        sumX[i] = (float)(gx * dtSec);
+        sumY[i] = (float)(gy * dtSec);
+        sumZ[i] = (float)(gz * dtSec);
+
+        ay *= mirror;
+        az *= mirror;
+        gy *= mirror;
+        gz *= mirror;
+
+        accX[i] = (float)ax;
+        accY[i] = (float)ay;
+        accZ[i] = (float)az;
+        gyrX[i] = (float)gx;
+        gyrY[i] = (float)gy;
+        gyrZ[i] = (float)gz;
+
+        const double angleX = std::atan(ax / std::sqrt(ay * ay + az * az)) * toDegrees;
+        const double angleY = std::atan(ay / std::sqrt(ax * ax + az * az)) * toDegrees;
+        const double angleZ = std::atan(az / std::sqrt(ax * ax + ay * ay)) * toDegrees;
+
+        const double a = alpha[i];
+        outX[i] = (float)((a * angleX) + ((1.0 - a) * gx * dtSec));
+        outY[i] = (float)((a * angleY) + ((1.0 - a) * gy * dtSec));
+        outZ[i] = (float)((a * angleZ) + ((1.0 - a) * gz * dtSec));
+    }
+}
+
+ImuBatch::Benchmark ImuBatch::benchmark(int numControllers, int iterations)
+{
+    ImuBatch batch;
+    juce::Random rng(0x3057);
+
+    auto randomAxis = [&rng](int range) { return (int16_t)(rng.nextInt(2 * range + 1) - range); };
+
+    const int lanes = juce::jlimit(1, maxLanes, numControllers * 3);
+
+    for (int i = 0; i < lanes; ++i)
+    {
+        batch.add({ randomAxis(8000), randomAxis(8000), randomAxis(8000) },
+                  { randomAxis(3000), randomAxis(3000), randomAxis(3000) },
+                  { randomAxis(30), randomAxis(30), randomAxis(30) },
+                  (i / 3) % 2 == 1, 0.05f, 0.005f * (float)(1 + (i % 3 == 0 ? rng.nextInt(3) : 0)));
+    }
+
+    Benchmark result;
+    result.lanes = lanes;
+    iterations = juce::jmax(1, iterations);
+
+    auto samplesPerSec = [&](auto&& fn)
+    {
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int n = 0; n < iterations; ++n)
+        {
+            fn();
+        }
+
+        const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return seconds > 0 ? (double)lanes * iterations / seconds : 0.0;
+    };
+
+    result.scalarSamplesPerSec = samplesPerSec([&] { batch.processScalar(); });
+    std::vector<juce::Vector3D<float>> reference;
+    for (int i = 0; i < lanes; ++i)
+    {
+        reference.push_back(batch.getOrientation(i));
+    }
+
+    result.batchSamplesPerSec = samplesPerSec([&] { batch.process(); });
+    for (int i = 0; i < lanes; ++i)
+    {
+        auto diff = batch.getOrientation(i) - reference[(size_t)i];
+        result.maxErrorDegrees = juce::jmax(result.maxErrorDegrees, std::abs(diff.x), std::abs(diff.y), std::abs(diff.z));
+    }
+
+    return result;
+}
+
+juce::String ImuBatch::Benchmark::toString() const
+{
+    return juce::String(lanes) + " samples/cycle: scalar " + juce::String(scalarSamplesPerSec / 1.0e6, 2)
+         + " M samples/s, batch " + juce::String(batchSamplesPerSec / 1.0e6, 2)
+         + " M samples/s, max error " + juce::String(maxErrorDegrees, 5) + " deg";
+}
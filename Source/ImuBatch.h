@@ -0,0 +1,99 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Geometry.h"
+
+/*
+    Structure-of-arrays IMU pipeline shared by every controller. During a poll
+    cycle each Joycon appends its raw samples (three per 0x30 report), then
+    process() runs scaling, gyro bias removal, the accelerometer angles and the
+    complementary filter over all lanes at once with SSE / NEON and a
+    polynomial atan, and each Joycon reads its own lanes back.
+
+    processScalar() is the reference: the same maths as Joycon::ProcessIMU with
+    std::atan / std::sqrt in double precision.
+*/
+class ImuBatch
+{
+public:
+    /* 8 controllers with a full report queue */
+    static constexpr int maxLanes = 64 * 3 * 8;
+
+    ImuBatch();
+
+    void clear()
+    {
+        numLanes = 0;
+    }
+
+    int size() const
+    {
+        return numLanes;
+    }
+
+    /*
+        Queues one sample. mirror negates Y and Z after the gyro integral, as
+        the left Joy-Con does. timeMs is passed through untouched for getTime().
+        Returns the lane, or -1 when the batch is full.
+    */
+    int add(const juce::Vector3D<int16_t>& accRaw, const juce::Vector3D<int16_t>& gyrRaw,
+            const juce::Vector3D<int16_t>& gyrNeutral, bool mirror, float alpha, float dtSec, double timeMs = 0);
+
+    void process();
+    void processScalar();
+
+    /* Accelerometer in g and gyro in deg/s, both after mirroring. */
+    juce::Vector3D<float> getAccel(int lane) const       { return { accX[lane], accY[lane], accZ[lane] }; }
+    juce::Vector3D<float> getGyro(int lane) const        { return { gyrX[lane], gyrY[lane], gyrZ[lane] }; }
+    juce::Vector3D<float> getOrientation(int lane) const { return { outX[lane], outY[lane], outZ[lane] }; }
+
+    /* The samples as queued, before scaling and mirroring. */
+    juce::Vector3D<int16_t> getRawAccel(int lane) const  { return { (int16_t)rawAccX[lane], (int16_t)rawAccY[lane], (int16_t)rawAccZ[lane] }; }
+    juce::Vector3D<int16_t> getRawGyro(int lane) const   { return { (int16_t)rawGyrX[lane], (int16_t)rawGyrY[lane], (int16_t)rawGyrZ[lane] }; }
+
+    /* Gyro integral for this sample, before mirroring (Joycon::sum). */
+    juce::Vector3D<float> getGyroDelta(int lane) const   { return { sumX[lane], sumY[lane], sumZ[lane] }; }
+
+    double getTime(int lane) const                       { return time[lane]; }
+
+    bool isMirrored(int lane) const
+    {
+        return sign[lane] < 0;
+    }
+
+    struct Benchmark
+    {
+        int lanes = 0;
+        double scalarSamplesPerSec = 0;
+        double batchSamplesPerSec = 0;
+        float maxErrorDegrees = 0;      // largest orientation difference between the two paths
+
+        juce::String toString() const;
+    };
+
+    /* Fills a batch with random controller data and compares both paths. */
+    static Benchmark benchmark(int numControllers, int iterations);
+
+private:
+    struct Kernel;
+    friend struct Kernel;
+
+    template <typename T> using Lanes = juce::HeapBlock<T>;
+
+    int numLanes = 0;
+
+    // inputs, one entry per sample
+    Lanes<float> rawAccX, rawAccY, rawAccZ;
+    Lanes<float> rawGyrX, rawGyrY, rawGyrZ;
+    Lanes<float> biasX, biasY, biasZ;
+    Lanes<float> sign, alpha, dt;
+    Lanes<double> time;
+
+    // outputs
+    Lanes<float> accX, accY, accZ;
+    Lanes<float> gyrX, gyrY, gyrZ;
+    Lanes<float> sumX, sumY, sumZ;
+    Lanes<float> outX, outY, outZ;
+
+    JUCE_DECLARE_NON_COPYABLE (ImuBatch)
+};
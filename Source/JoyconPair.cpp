@@ -0,0 +1,163 @@
+#include "JoyconPair.h"
+
+void JoyconPair::setSources(const Telemetry* newFirst, const Telemetry* newSecond)
+{
+    first.store(newFirst, std::memory_order_release);
+    second.store(newSecond, std::memory_order_release);
+
+    recordedTicks = 0;
+    lastSkewMs = 0;
+    maxAbsSkewMs = 0;
+    updates = 0;
+    held = 0;
+    skewHistogram.reset();
+}
+
+bool JoyconPair::read(SourceFrame& frame)
+{
+    const auto* a = first.load(std::memory_order_acquire);
+    const auto* b = second.load(std::memory_order_acquire);
+
+    std::array<TelemetrySample, searchDepth> fromFirst, fromSecond;
+    const auto numFirst = a != nullptr ? a->history.readLatest(fromFirst.data(), searchDepth) : 0;
+    const auto numSecond = b != nullptr ? b->history.readLatest(fromSecond.data(), searchDepth) : 0;
+
+    if (numFirst == 0 && numSecond == 0)
+    {
+        return false;
+    }
+
+    // only one half so far: it goes out on its own
+    if (numSecond == 0 || numFirst == 0)
+    {
+        const auto& only = numFirst > 0 ? fromFirst[(size_t)numFirst - 1] : fromSecond[(size_t)numSecond - 1];
+
+        frame = SourceFrame::fromTelemetry(numFirst > 0 ? only : TelemetrySample());
+        if (numSecond > 0)
+        {
+            frame.setPartner(only);
+        }
+
+        frame.timeSeconds = only.deviceMs * 0.001;
+        return true;
+    }
+
+    const auto& newestFirst = fromFirst[(size_t)numFirst - 1];
+    const auto& newestSecond = fromSecond[(size_t)numSecond - 1];
+    const auto skewMs = newestFirst.deviceMs - newestSecond.deviceMs;
+
+    // the newest instant both have reached, but never further back than maxWaitMs
+    const auto latest = juce::jmax(newestFirst.deviceMs, newestSecond.deviceMs);
+    const auto alignTo = juce::jmax(juce::jmin(newestFirst.deviceMs, newestSecond.deviceMs), latest - maxWaitMs);
+
+    frame = SourceFrame::fromTelemetry(sampleAt(fromFirst.data(), numFirst, alignTo));
+    frame.setPartner(sampleAt(fromSecond.data(), numSecond, alignTo));
+    frame.timeSeconds = alignTo * 0.001;
+
+    recordSkew(juce::jmax(newestFirst.ticks, newestSecond.ticks), skewMs, std::abs(skewMs) > maxWaitMs);
+    return true;
+}
+
+bool JoyconPair::readAt(double deviceMs, SourceFrame& frame) const
+{
+    const auto* a = first.load(std::memory_order_acquire);
+    const auto* b = second.load(std::memory_order_acquire);
+
+    std::array<TelemetrySample, searchDepth> fromFirst, fromSecond;
+    const auto numFirst = a != nullptr ? a->history.readLatest(fromFirst.data(), searchDepth) : 0;
+    const auto numSecond = b != nullptr ? b->history.readLatest(fromSecond.data(), searchDepth) : 0;
+
+    if (numFirst == 0 && numSecond == 0)
+    {
+        return false;
+    }
+
+    frame = SourceFrame::fromTelemetry(numFirst > 0 ? sampleAt(fromFirst.data(), numFirst, deviceMs) : TelemetrySample());
+    if (numSecond > 0)
+    {
+        frame.setPartner(sampleAt(fromSecond.data(), numSecond, deviceMs));
+    }
+
+    if (deviceMs > 0)
+    {
+        frame.timeSeconds = deviceMs * 0.001;
+    }
+
+    return true;
+}
+
+TelemetrySample JoyconPair::sampleAt(const TelemetrySample* samples, int num, double timeMs)
+{
+    if (timeMs >= samples[num - 1].deviceMs)
+    {
+        return samples[num - 1];
+    }
+
+    if (timeMs <= samples[0].deviceMs)
+    {
+        return samples[0];
+    }
+
+    // samples[i - 1] <= timeMs < samples[i]
+    auto i = num - 1;
+    while (samples[i - 1].deviceMs > timeMs)
+    {
+        --i;
+    }
+
+    const auto& before = samples[i - 1];
+    const auto& after = samples[i];
+    const auto span = after.deviceMs - before.deviceMs;
+    const auto w = span > 0 ? (float)((timeMs - before.deviceMs) / span) : 1.f;
+
+    auto lerp = [w](float x, float y) { return x + (y - x) * w; };
+
+    // buttons and ticks stay with the earlier sample
+    auto s = before;
+    s.deviceMs = timeMs;
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        s.pitchRollYaw[k] = lerp(before.pitchRollYaw[k], after.pitchRollYaw[k]);
+        s.acc[k] = lerp(before.acc[k], after.acc[k]);
+        s.gyr[k] = lerp(before.gyr[k], after.gyr[k]);
+    }
+
+    s.stick[0] = lerp(before.stick[0], after.stick[0]);
+    s.stick[1] = lerp(before.stick[1], after.stick[1]);
+
+    return s;
+}
+
+void JoyconPair::recordSkew(juce::int64 newestTicks, double skewMs, bool isHeld)
+{
+    auto previous = recordedTicks.load(std::memory_order_relaxed);
+    if (newestTicks <= previous || !recordedTicks.compare_exchange_strong(previous, newestTicks))
+    {
+        return;
+    }
+
+    lastSkewMs.store(skewMs, std::memory_order_relaxed);
+    if (std::abs(skewMs) > maxAbsSkewMs.load(std::memory_order_relaxed))
+    {
+        maxAbsSkewMs.store(std::abs(skewMs), std::memory_order_relaxed);
+    }
+
+    updates.fetch_add(1, std::memory_order_relaxed);
+    if (isHeld)
+    {
+        held.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    skewHistogram.record(std::abs(skewMs));
+}
+
+JoyconPair::SkewStats JoyconPair::getSkewStats() const
+{
+    SkewStats s;
+    s.lastMs = lastSkewMs.load(std::memory_order_relaxed);
+    s.maxAbsMs = maxAbsSkewMs.load(std::memory_order_relaxed);
+    s.updates = updates.load(std::memory_order_relaxed);
+    s.held = held.load(std::memory_order_relaxed);
+    return s;
+}
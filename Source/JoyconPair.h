@@ -0,0 +1,77 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Telemetry.h"
+#include "MappingMatrix.h"
+
+/*
+    Two Joy-Cons, usually a left and a right, merged into one virtual
+    controller. Each half runs its own poll thread and publishes into its own
+    Telemetry; the device timers are mapped onto the host clock (see
+    DeviceClock), so both streams share one timeline. read() takes the newest
+    instant both halves have reported, interpolates the half that is ahead
+    back to it, and fills the first controller's sources plus the partner
+    and relative ones (MappingSource::partnerPitch onwards).
+
+    The skew is how far apart the two halves' newest reports are on that
+    timeline: what the merge has to wait for. A half more than maxWaitMs
+    behind is held at its last state instead, so one that drops out doesn't
+    freeze the other.
+*/
+class JoyconPair
+{
+public:
+    static constexpr double maxWaitMs = 50.0;
+
+    JoyconPair() = default;
+
+    /* Message thread, before the first read(). Either may be null while that half isn't attached. */
+    void setSources(const Telemetry* first, const Telemetry* second);
+
+    /* Audio or poll thread; never blocks or allocates. False until either half has reported. */
+    bool read(SourceFrame& frame);
+
+    /*
+        Like read(), but both halves as they were at deviceMs on the shared
+        timeline, each interpolated or held at its nearest sample; for
+        stepping through reports as they arrived. Records no skew.
+    */
+    bool readAt(double deviceMs, SourceFrame& frame) const;
+
+    struct SkewStats
+    {
+        double lastMs = 0;                  // first minus second, positive while the first is ahead
+        double maxAbsMs = 0;
+        juce::uint64 updates = 0;           // new reports from either half
+        juce::uint64 held = 0;              // updates where one half was more than maxWaitMs behind
+    };
+
+    SkewStats getSkewStats() const;
+
+    /* |skew| per update, in 1 ms bins. */
+    const LatencyHistogram& getSkewHistogram() const
+    {
+        return skewHistogram;
+    }
+
+private:
+    static constexpr int searchDepth = 16;         // newest samples searched for the instant to align to
+
+    /* The half's state at timeMs, interpolated between the samples either side of it. */
+    static TelemetrySample sampleAt(const TelemetrySample* samples, int num, double timeMs);
+
+    void recordSkew(juce::int64 newestTicks, double skewMs, bool held);
+
+    std::atomic<const Telemetry*> first { nullptr };
+    std::atomic<const Telemetry*> second { nullptr };
+
+    // any thread may read(); the first to see a new update records its skew
+    std::atomic<juce::int64> recordedTicks { 0 };
+    std::atomic<double> lastSkewMs { 0 };
+    std::atomic<double> maxAbsSkewMs { 0 };
+    std::atomic<juce::uint64> updates { 0 };
+    std::atomic<juce::uint64> held { 0 };
+    LatencyHistogram skewHistogram;
+
+    JUCE_DECLARE_NON_COPYABLE (JoyconPair)
+};
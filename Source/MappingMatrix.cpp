@@ -0,0 +1,460 @@
+#include "MappingMatrix.h"
+#include "Trace.h"
+
+#include <cmath>
+
+namespace
+{
+    // same order as Joycon::Button
+    const char* const buttonNames[] = { "dpadDown", "dpadRight", "dpadLeft", "dpadUp", "sl", "sr", "minus",
+                                        "home", "plus", "capture", "stick", "shoulder1", "shoulder2" };
+
+    const char* const sourceNames[] = { "pitch", "roll", "yaw", "accX", "accY", "accZ", "gyroX", "gyroY", "gyroZ",
+                                        "stickX", "stickY", "accMagnitude", "gyroMagnitude", "stickRadius" };
+
+    const char* const partnerNames[] = { "partnerPitch", "partnerRoll", "partnerYaw", "partnerStickX", "partnerStickY",
+                                         "partnerGyroMagnitude", "relativePitch", "relativeRoll", "relativeYaw" };
+
+    const char* const partnerButtonNames[] = { "partnerDpadDown", "partnerDpadRight", "partnerDpadLeft", "partnerDpadUp", "partnerSl",
+                                               "partnerSr", "partnerMinus", "partnerHome", "partnerPlus", "partnerCapture",
+                                               "partnerStick", "partnerShoulder1", "partnerShoulder2" };
+
+    constexpr int numButtons = MappingSource::partnerPitch - MappingSource::firstButton;
+
+    static_assert(sizeof(sourceNames) / sizeof(sourceNames[0]) == MappingSource::firstButton, "source names out of date");
+    static_assert(sizeof(buttonNames) / sizeof(buttonNames[0]) == numButtons, "button names out of date");
+    static_assert(sizeof(partnerNames) / sizeof(partnerNames[0]) == MappingSource::firstPartnerButton - MappingSource::partnerPitch, "partner names out of date");
+    static_assert(sizeof(partnerButtonNames) / sizeof(partnerButtonNames[0]) == MappingSource::numSources - MappingSource::firstPartnerButton, "partner button names out of date");
+
+    float applyCurve(MappingCurve curve, float amount, float x)
+    {
+        const auto power = 1.f + 4.f * juce::jlimit(0.f, 1.f, amount);
+
+        switch (curve)
+        {
+            case MappingCurve::exponential:     return std::pow(x, power);
+            case MappingCurve::logarithmic:     return 1.f - std::pow(1.f - x, power);
+            case MappingCurve::sCurve:          return x + juce::jlimit(0.f, 1.f, amount) * (x * x * (3.f - 2.f * x) - x);
+            case MappingCurve::linear:
+            default:                            return x;
+        }
+    }
+
+    /* NaN safe clamp to 0..1 */
+    inline float clampUnit(float x)
+    {
+        return x > 0.f ? (x < 1.f ? x : 1.f) : 0.f;
+    }
+}
+
+juce::String MappingSource::getName(int source)
+{
+    if (source >= 0 && source < firstButton)
+    {
+        return sourceNames[source];
+    }
+
+    if (source >= firstButton && source < partnerPitch)
+    {
+        return buttonNames[source - firstButton];
+    }
+
+    if (source >= partnerPitch && source < firstPartnerButton)
+    {
+        return partnerNames[source - partnerPitch];
+    }
+
+    if (source >= firstPartnerButton && source < numSources)
+    {
+        return partnerButtonNames[source - firstPartnerButton];
+    }
+
+    return {};
+}
+
+bool MappingSource::isButton(int source)
+{
+    return (source >= firstButton && source < partnerPitch) || (source >= firstPartnerButton && source < numSources);
+}
+
+juce::Range<float> MappingSource::getRange(int source)
+{
+    switch (source)
+    {
+        case pitch: case roll: case yaw:            return { -4.5f, 4.5f };
+        case partnerPitch: case partnerRoll:
+        case partnerYaw:                            return { -4.5f, 4.5f };
+        case relativePitch: case relativeRoll:
+        case relativeYaw:                           return { -9.f, 9.f };
+        case partnerStickX: case partnerStickY:     return { -1.f, 1.f };
+        case partnerGyroMagnitude:                  return { 0.f, 3500.f };
+        case accX: case accY: case accZ:            return { -4.f, 4.f };
+        case gyroX: case gyroY: case gyroZ:         return { -2000.f, 2000.f };
+        case stickX: case stickY:                   return { -1.f, 1.f };
+        case accMagnitude:                          return { 0.f, 4.f };
+        case gyroMagnitude:                         return { 0.f, 3500.f };
+        default:                                    return { 0.f, 1.f };
+    }
+}
+
+int MappingSource::fromName(const juce::String& name)
+{
+    for (int i = 0; i < numSources; ++i)
+    {
+        if (getName(i) == name)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+std::vector<Mapping> Mapping::getDefaults()
+{
+    // the orientation filter reads about +-4.4 at 90 degrees of tilt
+    std::vector<Mapping> defaults(5);
+
+    defaults[0].source = MappingSource::pitch;
+    defaults[0].inMin = 0.f;
+    defaults[0].inMax = 4.4f;
+    defaults[0].number = 16;
+
+    defaults[1].source = MappingSource::roll;
+    defaults[1].inMin = -4.4f;
+    defaults[1].inMax = 4.4f;
+    defaults[1].number = 17;
+
+    defaults[2].source = MappingSource::yaw;
+    defaults[2].inMin = -4.4f;
+    defaults[2].inMax = 4.4f;
+    defaults[2].number = 18;
+
+    // the stick at full 14 bit resolution, CC 20/52 and 21/53
+    for (size_t i = 0; i < 2; ++i)
+    {
+        defaults[3 + i].source = MappingSource::stickX + (int)i;
+        defaults[3 + i].inMin = -1.f;
+        defaults[3 + i].inMax = 1.f;
+        defaults[3 + i].destination = MappingDestination::cc14;
+        defaults[3 + i].number = 20 + (int)i;
+    }
+
+    return defaults;
+}
+
+SourceFrame SourceFrame::fromTelemetry(const TelemetrySample& s)
+{
+    SourceFrame f;
+    auto& v = f.values;
+
+    // the report timer on the host clock is free of transport jitter; processing time for samples without one
+    f.timeSeconds = s.deviceMs > 0 ? s.deviceMs * 0.001 : juce::Time::highResolutionTicksToSeconds(s.ticks);
+
+    v[MappingSource::pitch] = s.pitchRollYaw[0];
+    v[MappingSource::roll] = s.pitchRollYaw[1];
+    v[MappingSource::yaw] = s.pitchRollYaw[2];
+    v[MappingSource::accX] = s.acc[0];
+    v[MappingSource::accY] = s.acc[1];
+    v[MappingSource::accZ] = s.acc[2];
+    v[MappingSource::gyroX] = s.gyr[0];
+    v[MappingSource::gyroY] = s.gyr[1];
+    v[MappingSource::gyroZ] = s.gyr[2];
+    v[MappingSource::stickX] = s.stick[0];
+    v[MappingSource::stickY] = s.stick[1];
+    v[MappingSource::accMagnitude] = std::sqrt(s.acc[0] * s.acc[0] + s.acc[1] * s.acc[1] + s.acc[2] * s.acc[2]);
+    v[MappingSource::gyroMagnitude] = std::sqrt(s.gyr[0] * s.gyr[0] + s.gyr[1] * s.gyr[1] + s.gyr[2] * s.gyr[2]);
+    v[MappingSource::stickRadius] = juce::jmin(1.f, std::sqrt(s.stick[0] * s.stick[0] + s.stick[1] * s.stick[1]));
+
+    for (int b = 0; b < numButtons; ++b)
+    {
+        v[(size_t)(MappingSource::firstButton + b)] = (float)((s.buttons >> b) & 1u);
+    }
+
+    return f;
+}
+
+void SourceFrame::setPartner(const TelemetrySample& s)
+{
+    auto& v = values;
+
+    v[MappingSource::partnerPitch] = s.pitchRollYaw[0];
+    v[MappingSource::partnerRoll] = s.pitchRollYaw[1];
+    v[MappingSource::partnerYaw] = s.pitchRollYaw[2];
+    v[MappingSource::partnerStickX] = s.stick[0];
+    v[MappingSource::partnerStickY] = s.stick[1];
+    v[MappingSource::partnerGyroMagnitude] = std::sqrt(s.gyr[0] * s.gyr[0] + s.gyr[1] * s.gyr[1] + s.gyr[2] * s.gyr[2]);
+    v[MappingSource::relativePitch] = v[MappingSource::pitch] - s.pitchRollYaw[0];
+    v[MappingSource::relativeRoll] = v[MappingSource::roll] - s.pitchRollYaw[1];
+    v[MappingSource::relativeYaw] = v[MappingSource::yaw] - s.pitchRollYaw[2];
+
+    for (int b = 0; b < numButtons; ++b)
+    {
+        v[(size_t)(MappingSource::firstPartnerButton + b)] = (float)((s.buttons >> b) & 1u);
+    }
+}
+
+//==============================================================================
+MappingProgram::MappingProgram(const std::vector<Mapping>& mappings)
+{
+    auto groupOf = [](MappingDestination d)
+    {
+        switch (d)
+        {
+            case MappingDestination::cc14:          return cc14Group;
+            case MappingDestination::pitchBend:     return pitchBendGroup;
+            case MappingDestination::note:          return noteGroup;
+            case MappingDestination::audio:         return audioGroup;
+            case MappingDestination::cc:
+            default:                                return ccGroup;
+        }
+    };
+
+    const float groupResolution[numGroups] = { 127.f, 16383.f, 16383.f, 1.f, 0.f };
+    const int maxNumber[numGroups] = { 127, 31, 0, 127, 1023 };
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        groupStart[(size_t)group] = (int)source.size();
+
+        for (auto& m : mappings)
+        {
+            if (groupOf(m.destination) != group || m.source < 0 || m.source >= MappingSource::numSources)
+            {
+                continue;
+            }
+
+            const auto range = m.inMax - m.inMin;
+
+            source.push_back(m.source);
+            inOffset.push_back(m.inMin);
+            inScale.push_back(range != 0.f ? 1.f / range : 0.f);
+            resolution.push_back(groupResolution[group]);
+            channel.push_back(juce::jlimit(1, 16, m.channel));
+            number.push_back(juce::jlimit(0, maxNumber[group], m.number));
+
+            for (int k = 0; k < curvePoints; ++k)
+            {
+                auto x = (float)k / (float)(curvePoints - 1);
+                auto y = applyCurve(m.curve, m.curveAmount, m.invert ? 1.f - x : x);
+                table.push_back(m.outMin + (m.outMax - m.outMin) * y);
+            }
+        }
+    }
+
+    groupStart[numGroups] = (int)source.size();
+
+    // smoothing follows the instruction order
+    std::vector<OneEuroParameters> filters;
+    for (int group = 0; group < numGroups; ++group)
+    {
+        for (auto& m : mappings)
+        {
+            if (groupOf(m.destination) == group && m.source >= 0 && m.source < MappingSource::numSources)
+            {
+                filters.push_back(m.smoothing);
+                anySmoothing = anySmoothing || m.smoothing.isEnabled();
+            }
+        }
+    }
+
+    smoothing.configure(filters);
+
+    value.resize(source.size());
+    quantised.resize(source.size());
+    lastSent.assign(source.size(), -1);
+    lastAudio.resize(source.size());
+
+    // held notes start released, so nothing is sent until a note turns on
+    std::fill(lastSent.begin() + groupStart[noteGroup], lastSent.begin() + groupStart[noteGroup + 1], 0);
+}
+
+void MappingProgram::process(const SourceFrame& frame, juce::MidiBuffer& midi, int offset)
+{
+    JOYCON_TRACE_SCOPE("MappingProgram::process");
+
+    const auto n = size();
+    const auto* in = frame.values.data();
+
+    for (int i = 0; i < n; ++i)
+    {
+        value[(size_t)i] = (in[source[(size_t)i]] - inOffset[(size_t)i]) * inScale[(size_t)i];
+    }
+
+    if (anySmoothing && frame.timeSeconds > 0)
+    {
+        smoothing.process(value.data(), (float)(frame.timeSeconds - lastFrameSeconds));
+        lastFrameSeconds = frame.timeSeconds;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        const auto x = clampUnit(value[(size_t)i]) * (float)(curvePoints - 1);
+        const auto idx = juce::jmin((int)x, curvePoints - 2);
+        const auto* t = table.data() + (size_t)(i * curvePoints + idx);
+        const auto y = t[0] + (x - (float)idx) * (t[1] - t[0]);
+
+        value[(size_t)i] = y;
+        quantised[(size_t)i] = (int)(clampUnit(y) * resolution[(size_t)i] + 0.5f);
+    }
+
+    auto changed = [this](int i)
+    {
+        if (quantised[(size_t)i] == lastSent[(size_t)i])
+        {
+            return false;
+        }
+
+        lastSent[(size_t)i] = quantised[(size_t)i];
+        return true;
+    };
+
+    for (int i = groupStart[ccGroup]; i < groupStart[ccGroup + 1]; ++i)
+    {
+        if (changed(i))
+        {
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel[(size_t)i], number[(size_t)i], quantised[(size_t)i]), offset);
+        }
+    }
+
+    for (int i = groupStart[cc14Group]; i < groupStart[cc14Group + 1]; ++i)
+    {
+        if (changed(i))
+        {
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel[(size_t)i], number[(size_t)i], quantised[(size_t)i] >> 7), offset);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel[(size_t)i], number[(size_t)i] + 32, quantised[(size_t)i] & 0x7f), offset);
+        }
+    }
+
+    for (int i = groupStart[pitchBendGroup]; i < groupStart[pitchBendGroup + 1]; ++i)
+    {
+        if (changed(i))
+        {
+            midi.addEvent(juce::MidiMessage::pitchWheel(channel[(size_t)i], quantised[(size_t)i]), offset);
+        }
+    }
+
+    for (int i = groupStart[noteGroup]; i < groupStart[noteGroup + 1]; ++i)
+    {
+        if (changed(i))
+        {
+            midi.addEvent(quantised[(size_t)i] != 0 ? juce::MidiMessage::noteOn(channel[(size_t)i], number[(size_t)i], (juce::uint8)100)
+                                                    : juce::MidiMessage::noteOff(channel[(size_t)i], number[(size_t)i]), offset);
+        }
+    }
+}
+
+void MappingProgram::renderAudio(juce::AudioBuffer<float>& audio)
+{
+    const auto numSamples = audio.getNumSamples();
+
+    for (int i = groupStart[audioGroup]; i < groupStart[audioGroup + 1]; ++i)
+    {
+        if (number[(size_t)i] >= audio.getNumChannels() || numSamples == 0)
+        {
+            continue;
+        }
+
+        // ramp from the previous block's value to avoid stepping
+        auto* dest = audio.getWritePointer(number[(size_t)i]);
+        const auto start = lastAudio[(size_t)i];
+        const auto step = (value[(size_t)i] - start) / (float)numSamples;
+
+        for (int s = 0; s < numSamples; ++s)
+        {
+            dest[s] = start + step * (float)(s + 1);
+        }
+
+        lastAudio[(size_t)i] = value[(size_t)i];
+    }
+}
+
+void MappingProgram::releaseNotes(juce::MidiBuffer& midi)
+{
+    for (int i = groupStart[noteGroup]; i < groupStart[noteGroup + 1]; ++i)
+    {
+        if (lastSent[(size_t)i] != 0)
+        {
+            midi.addEvent(juce::MidiMessage::noteOff(channel[(size_t)i], number[(size_t)i]), 0);
+            lastSent[(size_t)i] = 0;
+        }
+    }
+}
+
+//==============================================================================
+MappingEngine::MappingEngine()
+{
+    setMappings(Mapping::getDefaults());
+}
+
+MappingEngine::~MappingEngine()
+{
+    delete active;
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+void MappingEngine::setMappings(const std::vector<Mapping>& newMappings)
+{
+    {
+        juce::ScopedLock l(mappingsLock);
+        mappings = newMappings;
+    }
+
+    // a program the audio thread never picked up can go straight away
+    delete pending.exchange(new MappingProgram(newMappings), std::memory_order_acq_rel);
+
+    collectGarbage();
+}
+
+std::vector<Mapping> MappingEngine::getMappings() const
+{
+    juce::ScopedLock l(mappingsLock);
+    return mappings;
+}
+
+void MappingEngine::beginBlock(juce::MidiBuffer& midi)
+{
+    // only swap once the previous program has been collected, so retired holds at most one
+    if (retired.load(std::memory_order_acquire) == nullptr)
+    {
+        if (auto* next = pending.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            if (active != nullptr)
+            {
+                active->releaseNotes(midi);
+                retired.store(active, std::memory_order_release);
+            }
+
+            active = next;
+        }
+    }
+}
+
+void MappingEngine::evaluate(const SourceFrame& frame, juce::MidiBuffer& midi, int offset)
+{
+    if (active != nullptr)
+    {
+        active->process(frame, midi, offset);
+    }
+}
+
+void MappingEngine::renderAudio(juce::AudioBuffer<float>& audio)
+{
+    if (active != nullptr)
+    {
+        active->renderAudio(audio);
+    }
+}
+
+void MappingEngine::process(const SourceFrame& frame, juce::MidiBuffer& midi, juce::AudioBuffer<float>& audio)
+{
+    beginBlock(midi);
+    evaluate(frame, midi, 0);
+    renderAudio(audio);
+}
+
+void MappingEngine::collectGarbage()
+{
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Telemetry.h"
+#include "OneEuroFilter.h"
+
+/*
+    User defined motion -> MIDI mapping. Each Mapping routes one source
+    (an axis, the stick, a button or a derived feature) through an input range,
+    curve, inversion and output range to one destination. The list is compiled
+    on the message thread into a MappingProgram, a flat table driven program
+    that the audio thread evaluates without allocating or locking.
+*/
+namespace MappingSource
+{
+    enum Id
+    {
+        pitch,
+        roll,
+        yaw,
+        accX,
+        accY,
+        accZ,
+        gyroX,
+        gyroY,
+        gyroZ,
+        stickX,
+        stickY,
+        accMagnitude,       // g
+        gyroMagnitude,      // degrees per second
+        stickRadius,        // 0..1
+        firstButton,        // + Joycon::Button, 1 when held
+
+        // the second controller of a pair (see JoyconPair), 0 without one
+        partnerPitch = firstButton + 13,
+        partnerRoll,
+        partnerYaw,
+        partnerStickX,
+        partnerStickY,
+        partnerGyroMagnitude,
+        relativePitch,      // first minus second controller
+        relativeRoll,
+        relativeYaw,
+        firstPartnerButton,
+        numSources = firstPartnerButton + 13
+    };
+
+    juce::String getName(int source);
+    int fromName(const juce::String& name);
+
+    /* Buttons are 0 or 1; everything else is continuous. */
+    bool isButton(int source);
+
+    /* Full scale of a source in its own units. */
+    juce::Range<float> getRange(int source);
+}
+
+enum class MappingCurve
+{
+    linear,
+    exponential,
+    logarithmic,
+    sCurve
+};
+
+enum class MappingDestination
+{
+    cc,             // 7 bit controller
+    cc14,           // 14 bit controller, number and number + 32
+    pitchBend,
+    note,           // note on above 0.5, off below
+    audio           // written into output channel `number` at audio rate
+};
+
+struct Mapping
+{
+    int source = MappingSource::pitch;
+    float inMin = 0.f;
+    float inMax = 1.f;
+    MappingCurve curve = MappingCurve::linear;
+    float curveAmount = 0.5f;       // 0..1, how far the curve bends away from linear
+    bool invert = false;
+    float outMin = 0.f;
+    float outMax = 1.f;
+    MappingDestination destination = MappingDestination::cc;
+    int channel = 1;
+    int number = 0;
+    OneEuroParameters smoothing;    // on the input scaled to 0..1 over inMin..inMax, off by default
+
+    /* CC 16/17/18 from pitch/roll/yaw, as the plugin always sent, and 14 bit CC 20/21 from the stick. */
+    static std::vector<Mapping> getDefaults();
+};
+
+/* Every source value for one instant, indexed by MappingSource::Id. */
+struct SourceFrame
+{
+    std::array<float, MappingSource::numSources> values {};
+    double timeSeconds = 0;         // when the sample was taken, only differences matter; 0 if unknown (no smoothing)
+
+    static SourceFrame fromTelemetry(const TelemetrySample& s);
+
+    /* Fills the partner and relative sources from the second controller of a pair. */
+    void setPartner(const TelemetrySample& s);
+};
+
+/*
+    A compiled mapping list. Instructions are grouped by destination so each
+    group is one tight loop; range, curve, inversion and output range are
+    folded into a per-instruction lookup table, so evaluating a mapping is a
+    gather, a clamp and an interpolated table read. Mappings with smoothing
+    run their scaled input through a One-Euro filter bank in between.
+*/
+class MappingProgram
+{
+public:
+    static constexpr int curvePoints = 65;
+
+    explicit MappingProgram(const std::vector<Mapping>& mappings);
+
+    int size() const
+    {
+        return (int)source.size();
+    }
+
+    /* Audio thread. Evaluates one frame; MIDI goes out at offset when a quantised value changes. */
+    void process(const SourceFrame& frame, juce::MidiBuffer& midi, int offset);
+
+    /* Audio thread, once per block: audio outputs ramp from the last block's values to the latest frame's. */
+    void renderAudio(juce::AudioBuffer<float>& audio);
+
+    /* Audio thread. Note offs for every held note, sent before a program is replaced. */
+    void releaseNotes(juce::MidiBuffer& midi);
+
+private:
+    enum Group
+    {
+        ccGroup,
+        cc14Group,
+        pitchBendGroup,
+        noteGroup,
+        audioGroup,
+        numGroups
+    };
+
+    // one entry per instruction, ordered by group
+    std::vector<int> source;
+    std::vector<float> inOffset, inScale;
+    std::vector<float> table;               // curvePoints per instruction
+    std::vector<float> resolution;          // quantisation steps, 0 for audio
+    std::vector<int> channel, number;
+
+    std::vector<float> value;
+    OneEuroBank smoothing;
+    bool anySmoothing = false;
+    double lastFrameSeconds = 0;
+    std::vector<int> quantised, lastSent;
+    std::vector<float> lastAudio;
+
+    std::array<int, numGroups + 1> groupStart {};
+
+    JUCE_DECLARE_NON_COPYABLE (MappingProgram)
+};
+
+/*
+    Owns the live program. setMappings() compiles on the calling (message)
+    thread and hands the result over through an atomic pointer; the audio
+    thread picks it up at the start of its next block, and the program it
+    replaced is deleted on the next message thread call.
+*/
+class MappingEngine
+{
+public:
+    MappingEngine();
+    ~MappingEngine();
+
+    void setMappings(const std::vector<Mapping>& newMappings);
+    std::vector<Mapping> getMappings() const;
+
+    /*
+        Audio thread, per block: beginBlock() picks up a new program, then
+        evaluate() runs once for every frame that arrived, at its own offset,
+        and renderAudio() fills the audio outputs.
+    */
+    void beginBlock(juce::MidiBuffer& midi);
+    void evaluate(const SourceFrame& frame, juce::MidiBuffer& midi, int offset);
+    void renderAudio(juce::AudioBuffer<float>& audio);
+
+    /* All three for a single frame at offset 0. */
+    void process(const SourceFrame& frame, juce::MidiBuffer& midi, juce::AudioBuffer<float>& audio);
+
+    /* Message thread: frees programs the audio thread has finished with. */
+    void collectGarbage();
+
+private:
+    juce::CriticalSection mappingsLock;
+    std::vector<Mapping> mappings;
+
+    MappingProgram* active = nullptr;       // audio thread only
+    std::atomic<MappingProgram*> pending { nullptr };
+    std::atomic<MappingProgram*> retired { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE (MappingEngine)
+};
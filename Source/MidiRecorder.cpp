@@ -0,0 +1,222 @@
+#include "MidiRecorder.h"
+
+namespace
+{
+    /* Standard MIDI File variable length quantity; returns the number of bytes used. */
+    int writeVariableLength(juce::uint8* dest, juce::uint32 v)
+    {
+        juce::uint8 reversed[5];
+        int n = 0;
+
+        do
+        {
+            reversed[n++] = (juce::uint8)(v & 0x7f);
+            v >>= 7;
+        }
+        while (v != 0 && n < 5);
+
+        for (int i = 0; i < n; ++i)
+        {
+            dest[i] = (juce::uint8)(reversed[n - 1 - i] | (i < n - 1 ? 0x80 : 0));
+        }
+
+        return n;
+    }
+}
+
+MidiRecorder::MidiRecorder()
+    : juce::Thread("MIDI recorder")
+{
+}
+
+MidiRecorder::~MidiRecorder()
+{
+    stop();
+}
+
+bool MidiRecorder::start(const juce::File& newFile, double newSampleRate)
+{
+    stop();
+
+    newFile.deleteFile();
+    auto s = std::make_unique<juce::FileOutputStream>(newFile);
+
+    if (!s->openedOk())
+    {
+        return false;
+    }
+
+    // header: format 0, one track, ticks per quarter note
+    s->write("MThd", 4);
+    s->writeIntBigEndian(6);
+    s->writeShortBigEndian(0);
+    s->writeShortBigEndian(1);
+    s->writeShortBigEndian((short)ticksPerQuarter);
+
+    // track chunk, its length is patched in as it grows
+    s->write("MTrk", 4);
+    s->writeIntBigEndian(0);
+    trackStart = s->getPosition();
+
+    const juce::uint8 tempo[] = { 0x00, 0xff, 0x51, 0x03,
+                                  (juce::uint8)(microsecondsPerQuarter >> 16), (juce::uint8)(microsecondsPerQuarter >> 8), (juce::uint8)microsecondsPerQuarter };
+    s->write(tempo, sizeof(tempo));
+
+    file = newFile;
+    stream = std::move(s);
+    sampleRate = newSampleRate > 0 ? newSampleRate : 48000.0;
+    ticksPerSample = (double)ticksPerQuarter * 1.0e6 / (double)microsecondsPerQuarter / sampleRate;
+    lastTick = 0;
+
+    events = 0;
+    dropped = 0;
+    bytes = stream->getPosition();
+    samples = 0;
+
+    session.fetch_add(1, std::memory_order_acq_rel);
+    recording.store(true, std::memory_order_release);
+
+    startThread();
+    return true;
+}
+
+void MidiRecorder::stop()
+{
+    if (stream == nullptr)
+    {
+        return;
+    }
+
+    recording.store(false, std::memory_order_release);
+    stopThread(1000);
+    drain();
+
+    // end of track at the end of the session rather than at the last event
+    const auto endTick = juce::jmax(lastTick, (juce::int64)std::llround((double)samples.load() * ticksPerSample));
+    juce::uint8 end[8];
+    auto n = writeVariableLength(end, (juce::uint32)(endTick - lastTick));
+    end[n++] = 0xff;
+    end[n++] = 0x2f;
+    end[n++] = 0x00;
+    stream->write(end, (size_t)n);
+
+    writeTrackLength();
+    bytes = stream->getPosition();
+    stream.reset();
+}
+
+void MidiRecorder::record(const juce::MidiBuffer& midi, int numSamples)
+{
+    if (!recording.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    const auto current = session.load(std::memory_order_acquire);
+    if (current != seenSession)
+    {
+        seenSession = current;
+        sessionSamples = 0;
+    }
+
+    for (const auto event : midi)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 == 0 || event.numBytes <= 0 || event.numBytes > maxEventSize)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        auto& e = queue[(size_t)start1];
+        e.sample = sessionSamples + event.samplePosition;
+        e.session = current;
+        e.size = (juce::uint8)event.numBytes;
+        std::memcpy(e.data.data(), event.data, (size_t)event.numBytes);
+
+        fifo.finishedWrite(1);
+    }
+
+    sessionSamples += numSamples;
+    samples.store(sessionSamples, std::memory_order_relaxed);
+}
+
+void MidiRecorder::run()
+{
+    auto lastPatch = juce::Time::getMillisecondCounterHiRes();
+
+    while (!threadShouldExit())
+    {
+        wait(50);
+        drain();
+
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        if (now - lastPatch >= 1000.0)
+        {
+            writeTrackLength();
+            stream->flush();
+            lastPatch = now;
+        }
+    }
+}
+
+void MidiRecorder::drain()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+    const auto current = session.load(std::memory_order_acquire);
+    std::array<juce::uint8, 5 + maxEventSize> encoded;
+
+    auto write = [&](const Event& e)
+    {
+        if (e.session != current)
+        {
+            return;
+        }
+
+        // blocks arrive in order and each block's events are sorted, so ticks only go forward
+        const auto tick = juce::jmax(lastTick, (juce::int64)std::llround((double)e.sample * ticksPerSample));
+        auto n = writeVariableLength(encoded.data(), (juce::uint32)(tick - lastTick));
+        std::memcpy(encoded.data() + n, e.data.data(), e.size);
+        n += e.size;
+
+        stream->write(encoded.data(), (size_t)n);
+        lastTick = tick;
+        events.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    for (int i = 0; i < size1; ++i)
+    {
+        write(queue[(size_t)(start1 + i)]);
+    }
+
+    for (int i = 0; i < size2; ++i)
+    {
+        write(queue[(size_t)(start2 + i)]);
+    }
+
+    fifo.finishedRead(size1 + size2);
+    bytes = stream->getPosition();
+}
+
+void MidiRecorder::writeTrackLength()
+{
+    const auto end = stream->getPosition();
+
+    stream->setPosition(trackStart - 4);
+    stream->writeIntBigEndian((int)(end - trackStart));
+    stream->setPosition(end);
+}
+
+MidiRecorder::Stats MidiRecorder::getStats() const
+{
+    Stats s;
+    s.events = events.load(std::memory_order_relaxed);
+    s.dropped = dropped.load(std::memory_order_relaxed);
+    s.bytes = bytes.load(std::memory_order_relaxed);
+    s.seconds = (double)samples.load(std::memory_order_relaxed) / sampleRate;
+    return s;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    Records the MIDI the plugin generates to a Standard MIDI File while it
+    plays. record() copies each block's events, stamped with their sample
+    position in the session, into a lock-free queue; a writer thread drains
+    it and appends them to the file as they come, so an hour-long set takes
+    the same memory as a minute and the audio thread never touches the disk.
+
+    The file is format 0, one track, 120 bpm at 24000 ticks per quarter note:
+    48000 ticks a second, one per sample at 48 kHz. The track length is
+    patched in every second and at stop(), so a session cut short still
+    leaves a readable file.
+*/
+class MidiRecorder : private juce::Thread
+{
+public:
+    static constexpr int queueSize = 8192;              // events, about 1.5 s of dense output
+    static constexpr int maxEventSize = 12;             // longer messages (sysex) are counted and skipped
+    static constexpr int ticksPerQuarter = 24000;
+    static constexpr int microsecondsPerQuarter = 500000;
+
+    MidiRecorder();
+    ~MidiRecorder() override;
+
+    /* Message thread. Starts a new file, replacing any that exists. */
+    bool start(const juce::File& file, double sampleRate);
+
+    /* Message thread. Writes out what is queued and closes the file. */
+    void stop();
+
+    bool isRecording() const
+    {
+        return recording.load(std::memory_order_acquire);
+    }
+
+    const juce::File& getFile() const
+    {
+        return file;
+    }
+
+    /* Audio thread, once per block with the block's final output. Never allocates or blocks. */
+    void record(const juce::MidiBuffer& midi, int numSamples);
+
+    struct Stats
+    {
+        juce::uint64 events = 0;            // written to the file
+        juce::uint64 dropped = 0;           // queue full, or too long for a queue slot
+        juce::int64 bytes = 0;              // file size so far
+        double seconds = 0;                 // session length
+    };
+
+    Stats getStats() const;
+
+private:
+    struct Event
+    {
+        juce::int64 sample = 0;
+        juce::uint32 session = 0;           // events a stopped session left queued are dropped
+        juce::uint8 size = 0;
+        std::array<juce::uint8, maxEventSize> data {};
+    };
+
+    void run() override;
+    void drain();
+    void writeTrackLength();
+
+    juce::File file;
+    std::unique_ptr<juce::FileOutputStream> stream;
+    double ticksPerSample = 1.0;
+
+    std::atomic<bool> recording { false };
+
+    // audio thread
+    juce::AbstractFifo fifo { queueSize };
+    std::array<Event, queueSize> queue;
+    juce::int64 sessionSamples = 0;
+    std::atomic<juce::uint32> session { 0 };
+    juce::uint32 seenSession = 0;
+
+    // writer thread
+    juce::int64 lastTick = 0;
+    juce::int64 trackStart = 0;             // file position of the first track event
+
+    std::atomic<juce::uint64> events { 0 }, dropped { 0 };
+    std::atomic<juce::int64> bytes { 0 }, samples { 0 };
+    double sampleRate = 48000.0;
+
+    JUCE_DECLARE_NON_COPYABLE (MidiRecorder)
+};
@@ -0,0 +1,274 @@
+#include "MpeOutput.h"
+#include "Trace.h"
+
+void MpeOutput::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    scratch.ensureSize((size_t)juce::jmax(256, maximumBlockSize) * 3);
+}
+
+void MpeOutput::setSettings(const MpeSettings& s)
+{
+    auto clamped = s;
+    clamped.memberChannels = juce::jlimit(1, 15, s.memberChannels);
+    requested.publish(clamped);
+}
+
+MpeSettings MpeOutput::getSettings() const
+{
+    return requested.get();
+}
+
+void MpeOutput::applyPendingSettings(juce::MidiBuffer& out)
+{
+    const SnapshotCell<MpeSettings>::ScopedRead latest(requestedReader);
+    if (requestedReader.getVersion() == appliedVersion)
+    {
+        return;
+    }
+
+    appliedVersion = requestedReader.getVersion();
+
+    const auto& s = *latest;
+
+    if (settings.enabled != s.enabled || settings.memberChannels != s.memberChannels)
+    {
+        releaseAll(out, 0);
+        sendZoneConfiguration(out, s.enabled ? s.memberChannels : 0);
+    }
+
+    settings = s;
+    enabled = s.enabled;
+}
+
+void MpeOutput::sendZoneConfiguration(juce::MidiBuffer& out, int memberChannels)
+{
+    // MPE configuration message: RPN 6 on the master channel
+    out.addEvent(juce::MidiMessage::controllerEvent(1, 101, 0), 0);
+    out.addEvent(juce::MidiMessage::controllerEvent(1, 100, 6), 0);
+    out.addEvent(juce::MidiMessage::controllerEvent(1, 6, memberChannels), 0);
+}
+
+void MpeOutput::releaseAll(juce::MidiBuffer& out, int offset)
+{
+    for (int c = 0; c < (int)voices.size(); ++c)
+    {
+        auto& v = voices[(size_t)c];
+
+        if (v.active)
+        {
+            out.addEvent(juce::MidiMessage::noteOff(c + 1, v.note), offset);
+            v.active = false;
+        }
+
+        v.lastBend = v.lastPressure = v.lastSlide = -1;
+    }
+}
+
+void MpeOutput::filterInput(juce::MidiBuffer& midi)
+{
+    if (!isEnabled())
+    {
+        midi.clear();
+        return;
+    }
+
+    scratch.clear();
+
+    for (const auto m : midi)
+    {
+        const auto status = m.numBytes == 3 ? (m.data[0] & 0xf0) : 0;
+
+        if (status == 0x80 || status == 0x90)
+        {
+            scratch.addEvent(m.data, m.numBytes, m.samplePosition);
+        }
+    }
+
+    midi.swapWith(scratch);
+}
+
+float MpeOutput::normalised(int source) const
+{
+    if (source < 0 || source >= MappingSource::numSources)
+    {
+        return 0.f;
+    }
+
+    const auto range = MappingSource::getRange(source);
+    return juce::jlimit(0.f, 1.f, (frame.values[(size_t)source] - range.getStart()) / range.getLength());
+}
+
+void MpeOutput::sendExpression(juce::MidiBuffer& out, int member, int offset)
+{
+    auto& v = voices[(size_t)member];
+    const auto channel = member + 1;
+
+    if (settings.bendSource >= 0 && settings.bendSource < MappingSource::numSources)
+    {
+        const auto halfRange = MappingSource::getRange(settings.bendSource).getLength() * 0.5f;
+        const auto moved = (frame.values[(size_t)settings.bendSource] - v.bendReference) / halfRange;
+        const auto semitones = moved * settings.bendSemitones;
+        const auto bend = juce::jlimit(0, 16383, 8192 + juce::roundToInt(semitones / settings.bendRange * 8191.f));
+
+        if (v.lastBend < 0 || std::abs(bend - v.lastBend) >= settings.bendThreshold)
+        {
+            out.addEvent(juce::MidiMessage::pitchWheel(channel, bend), offset);
+            v.lastBend = bend;
+        }
+    }
+
+    const auto pressure = juce::roundToInt(normalised(settings.pressureSource) * 127.f);
+    if (pressure != v.lastPressure)
+    {
+        out.addEvent(juce::MidiMessage::channelPressureChange(channel, pressure), offset);
+        v.lastPressure = pressure;
+    }
+
+    const auto slide = juce::roundToInt(normalised(settings.slideSource) * 127.f);
+    if (slide != v.lastSlide)
+    {
+        out.addEvent(juce::MidiMessage::controllerEvent(channel, slideController, slide), offset);
+        v.lastSlide = slide;
+    }
+}
+
+void MpeOutput::noteOn(juce::MidiBuffer& out, int inChannel, int note, int velocity, int offset)
+{
+    // a free member channel released longest ago, else steal the oldest note
+    int best = -1;
+
+    for (int c = 1; c <= settings.memberChannels; ++c)
+    {
+        const auto& v = voices[(size_t)c];
+
+        if (best < 0
+         || (!v.active && voices[(size_t)best].active)
+         || (v.active == voices[(size_t)best].active && v.startedOrReleased < voices[(size_t)best].startedOrReleased))
+        {
+            best = c;
+        }
+    }
+
+    auto& v = voices[(size_t)best];
+
+    if (v.active)
+    {
+        out.addEvent(juce::MidiMessage::noteOff(best + 1, v.note), offset);
+    }
+
+    v.active = true;
+    v.inChannel = inChannel;
+    v.note = note;
+    v.startedOrReleased = ++counter;
+    v.bendReference = settings.bendSource >= 0 && settings.bendSource < MappingSource::numSources
+                    ? frame.values[(size_t)settings.bendSource] : 0.f;
+
+    // expression first, so the note starts from its own values rather than the last note's
+    v.lastBend = v.lastPressure = v.lastSlide = -1;
+    sendExpression(out, best, offset);
+
+    out.addEvent(juce::MidiMessage::noteOn(best + 1, note, (juce::uint8)velocity), offset);
+}
+
+void MpeOutput::noteOff(juce::MidiBuffer& out, int inChannel, int note, int velocity, int offset)
+{
+    for (int c = 1; c <= settings.memberChannels; ++c)
+    {
+        auto& v = voices[(size_t)c];
+
+        if (v.active && v.inChannel == inChannel && v.note == note)
+        {
+            out.addEvent(juce::MidiMessage::noteOff(c + 1, note, (juce::uint8)velocity), offset);
+            v.active = false;
+            v.startedOrReleased = ++counter;
+            return;
+        }
+    }
+}
+
+void MpeOutput::process(juce::MidiBuffer& midi, int numSamples, const TelemetryHistory& history, juce::int64 blockEndTicks)
+{
+    JOYCON_TRACE_SCOPE("MpeOutput::process");
+
+    scratch.clear();
+    applyPendingSettings(scratch);
+
+    if (!settings.enabled)
+    {
+        if (!scratch.isEmpty())
+        {
+            for (const auto m : midi)
+            {
+                scratch.addEvent(m.data, m.numBytes, m.samplePosition);
+            }
+
+            midi.swapWith(scratch);
+        }
+
+        return;
+    }
+
+    // telemetry that arrived during the last block, placed at its arrival offset one block later
+    const auto ticksPerSample = (double)juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+    const auto blockStart = blockEndTicks - (juce::int64)(numSamples * ticksPerSample);
+
+    const auto numRecent = history.readLatest(recent.data(), (int)recent.size());
+    int next = 0;
+
+    while (next < numRecent && recent[(size_t)next].ticks <= lastTicks)
+    {
+        ++next;
+    }
+
+    auto applyFramesUntil = [&](int offset)
+    {
+        while (next < numRecent)
+        {
+            const auto& sample = recent[(size_t)next];
+            const auto at = juce::jlimit(0, numSamples - 1, (int)((double)(sample.ticks - blockStart) / ticksPerSample));
+
+            if (at > offset)
+            {
+                return;
+            }
+
+            frame = SourceFrame::fromTelemetry(sample);
+            lastTicks = sample.ticks;
+            ++next;
+
+            for (int c = 1; c <= settings.memberChannels; ++c)
+            {
+                if (voices[(size_t)c].active)
+                {
+                    sendExpression(scratch, c, at);
+                }
+            }
+        }
+    };
+
+    for (const auto m : midi)
+    {
+        applyFramesUntil(m.samplePosition);
+
+        const auto status = m.numBytes == 3 ? (m.data[0] & 0xf0) : 0;
+        const auto inChannel = (m.data[0] & 0x0f) + 1;
+
+        if (status == 0x90 && m.data[2] > 0)
+        {
+            noteOn(scratch, inChannel, m.data[1], m.data[2], m.samplePosition);
+        }
+        else if (status == 0x80 || status == 0x90)
+        {
+            noteOff(scratch, inChannel, m.data[1], m.data[2], m.samplePosition);
+        }
+        else
+        {
+            scratch.addEvent(m.data, m.numBytes, m.samplePosition);
+        }
+    }
+
+    applyFramesUntil(numSamples);
+
+    midi.swapWith(scratch);
+}
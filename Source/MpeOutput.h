@@ -0,0 +1,100 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "MappingMatrix.h"
+#include "Snapshot.h"
+
+struct MpeSettings
+{
+    bool enabled = false;
+    int memberChannels = 15;            // lower zone: master channel 1, members 2..memberChannels + 1
+
+    int bendSource = MappingSource::roll;
+    float bendSemitones = 2.f;          // bend from half the source range of movement after the note starts
+    float bendRange = 48.f;             // receiver's member channel bend range, the MPE default
+
+    int pressureSource = MappingSource::pitch;
+    int slideSource = MappingSource::stickY;
+
+    int bendThreshold = 16;             // 14 bit steps a bend must move before it is resent
+};
+
+/*
+    MPE output. Every note on (from the mapping, gestures or the MIDI input)
+    is moved to its own member channel, and that channel then follows the
+    controller: pitch bend relative to where the bend source was when the
+    note started, channel pressure and slide (CC 74) from absolute sources.
+
+    Each telemetry sample newer than the last block is placed at its own
+    offset in the block (arrival time, one block behind), and a channel only
+    gets a message when its quantised value actually changed, so dense
+    polyphony doesn't repeat identical expression on every sample.
+*/
+class MpeOutput
+{
+public:
+    static constexpr int slideController = 74;
+
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    /* Message thread; picked up at the start of the next block. */
+    void setSettings(const MpeSettings& s);
+    MpeSettings getSettings() const;
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /* Audio thread. Drops everything but note messages from the host's MIDI input. */
+    void filterInput(juce::MidiBuffer& midi);
+
+    /*
+        Audio thread. Rewrites the block's notes onto member channels and adds
+        their expression. blockEndTicks is when the block ends on the clock
+        the telemetry is stamped with, normally Time::getHighResolutionTicks().
+    */
+    void process(juce::MidiBuffer& midi, int numSamples, const TelemetryHistory& history, juce::int64 blockEndTicks);
+
+private:
+    struct Voice
+    {
+        bool active = false;
+        int inChannel = 0;
+        int note = 0;
+        float bendReference = 0;
+        juce::uint32 startedOrReleased = 0;
+
+        int lastBend = -1;
+        int lastPressure = -1;
+        int lastSlide = -1;
+    };
+
+    static constexpr int historyBlock = 32;
+
+    void applyPendingSettings(juce::MidiBuffer& out);
+    void sendZoneConfiguration(juce::MidiBuffer& out, int memberChannels);
+    void releaseAll(juce::MidiBuffer& out, int offset);
+
+    void noteOn(juce::MidiBuffer& out, int inChannel, int note, int velocity, int offset);
+    void noteOff(juce::MidiBuffer& out, int inChannel, int note, int velocity, int offset);
+    void sendExpression(juce::MidiBuffer& out, int member, int offset);
+
+    float normalised(int source) const;
+
+    double sampleRate = 44100.0;
+    juce::MidiBuffer scratch;
+
+    SnapshotCell<MpeSettings> requested;
+    SnapshotCell<MpeSettings>::Reader requestedReader { requested };
+    juce::uint64 appliedVersion = 1;    // the defaults
+    std::atomic<bool> enabled { false };
+
+    MpeSettings settings;               // audio thread copy
+    std::array<Voice, 16> voices;       // indexed by MIDI channel - 1
+    juce::uint32 counter = 0;
+
+    SourceFrame frame;
+    juce::int64 lastTicks = 0;
+    std::array<TelemetrySample, historyBlock> recent;
+};
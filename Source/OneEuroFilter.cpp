@@ -0,0 +1,275 @@
+#include "OneEuroFilter.h"
+#include "SimdOps.h"
+#include "ImuBatch.h"
+#include "Capture.h"
+#include "joycon.hpp"
+
+namespace
+{
+    constexpr float twoPi = juce::MathConstants<float>::twoPi;
+}
+
+struct OneEuroBank::Kernel
+{
+    template <typename S>
+    static void run(OneEuroBank& b, float* values, float dtSec, int start, int end)
+    {
+        using V = typename S::V;
+
+        const V one = S::set(1.f);
+        const V zero = S::set(0.f);
+        const V twoPiDt = S::set(twoPi * dtSec);
+        const V invDt = S::set(1.f / dtSec);
+
+        // smoothing factor of a first order low pass at cutoff: r / (r + 1), r = 2 pi cutoff dt
+        auto smoothing = [&](V cutoff)
+        {
+            const auto r = S::mul(twoPiDt, cutoff);
+            return S::div(r, S::add(r, one));
+        };
+
+        for (int i = start; i < end; i += S::width)
+        {
+            const V x = S::load(values + i);
+            const V previous = S::load(b.filtered.data() + i);
+            const V previousSpeed = S::load(b.speed.data() + i);
+            const V minCutoff = S::load(b.minCutoff.data() + i);
+
+            const V rawSpeed = S::mul(S::sub(x, previous), invDt);
+            const V speed = S::add(previousSpeed, S::mul(smoothing(S::load(b.derivativeCutoff.data() + i)), S::sub(rawSpeed, previousSpeed)));
+
+            const V cutoff = S::add(minCutoff, S::mul(S::load(b.beta.data() + i), S::abs(speed)));
+            const V y = S::add(previous, S::mul(smoothing(cutoff), S::sub(x, previous)));
+
+            // channels that are off pass through exactly
+            const auto enabled = S::greater(minCutoff, zero);
+            const V out = S::select(enabled, y, x);
+
+            S::store(b.filtered.data() + i, out);
+            S::store(b.speed.data() + i, S::select(enabled, speed, zero));
+            S::store(values + i, out);
+        }
+    }
+};
+
+void OneEuroBank::configure(const std::vector<OneEuroParameters>& channels)
+{
+    numChannels = (int)channels.size();
+
+    minCutoff.resize(channels.size());
+    beta.resize(channels.size());
+    derivativeCutoff.resize(channels.size());
+    filtered.assign(channels.size(), 0.f);
+    speed.assign(channels.size(), 0.f);
+
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        minCutoff[i] = juce::jmax(0.f, channels[i].minCutoff);
+        beta[i] = juce::jmax(0.f, channels[i].beta);
+        derivativeCutoff[i] = juce::jmax(0.01f, channels[i].derivativeCutoff);
+    }
+
+    primed = false;
+}
+
+void OneEuroBank::process(float* values, float dtSec)
+{
+    if (!primed)
+    {
+        std::copy(values, values + numChannels, filtered.begin());
+        std::fill(speed.begin(), speed.end(), 0.f);
+        primed = true;
+        return;
+    }
+
+    if (dtSec <= 0.f)
+    {
+        for (int i = 0; i < numChannels; ++i)
+        {
+            if (minCutoff[(size_t)i] > 0.f)
+            {
+                values[i] = filtered[(size_t)i];
+            }
+        }
+
+        return;
+    }
+
+    const int vectorEnd = numChannels - numChannels % SimdOps::width;
+
+    Kernel::run<SimdOps>(*this, values, dtSec, 0, vectorEnd);
+    Kernel::run<ScalarOps>(*this, values, dtSec, vectorEnd, numChannels);
+}
+
+//==============================================================================
+void JitterLagScore::add(const float* pitch, const float* roll, const float* referencePitch, const float* referenceRoll,
+                         const float* rate, int n)
+{
+    for (int i = 1; i < n; ++i)
+    {
+        if (rate[i] < stillBelow && rate[i - 1] < stillBelow)
+        {
+            ++stillPairs;
+            jitterSquares += juce::square(pitch[i] - pitch[i - 1]) + juce::square(roll[i] - roll[i - 1]);
+        }
+    }
+
+    for (int i = maxLagSamples; i < n; ++i)
+    {
+        if (rate[i] <= movingAbove)
+        {
+            continue;
+        }
+
+        ++movingSamples;
+
+        for (int lag = 0; lag <= maxLagSamples; ++lag)
+        {
+            errorSquares[(size_t)lag] += juce::square(pitch[i] - referencePitch[i - lag])
+                                       + juce::square(roll[i] - referenceRoll[i - lag]);
+        }
+    }
+}
+
+double JitterLagScore::getJitterRms() const
+{
+    return stillPairs > 0 ? std::sqrt(jitterSquares / (2.0 * stillPairs)) : 0.0;
+}
+
+double JitterLagScore::getTrackingRms() const
+{
+    return movingSamples > 0 ? std::sqrt(errorSquares[0] / (2.0 * movingSamples)) : 0.0;
+}
+
+double JitterLagScore::getLagSamples() const
+{
+    if (movingSamples == 0)
+    {
+        return 0.0;
+    }
+
+    const auto best = (int)(std::min_element(errorSquares.begin(), errorSquares.end()) - errorSquares.begin());
+    double offset = 0;
+
+    // parabolic interpolation between samples
+    if (best > 0 && best < maxLagSamples)
+    {
+        const auto a = errorSquares[(size_t)best - 1], c = errorSquares[(size_t)best + 1], m = errorSquares[(size_t)best];
+        const auto denominator = a - 2.0 * m + c;
+        offset = denominator > 0 ? 0.5 * (a - c) / denominator : 0.0;
+    }
+
+    return juce::jmax(0.0, (double)best + offset);
+}
+
+//==============================================================================
+std::vector<OneEuroParameters> OneEuroBank::getBenchmarkCandidates()
+{
+    return { { 0.f, 0.f, 1.f },
+             { 0.5f, 0.f, 1.f }, { 1.f, 0.f, 1.f }, { 4.f, 0.f, 1.f },
+             { 0.5f, 5.f, 1.f }, { 1.f, 5.f, 1.f }, { 1.f, 20.f, 1.f }, { 2.f, 20.f, 1.f }, { 1.f, 80.f, 1.f } };
+}
+
+std::vector<OneEuroBank::Benchmark> OneEuroBank::benchmark(const juce::File& capture, const std::vector<OneEuroParameters>& candidates)
+{
+    constexpr float alpha = 0.05f;                  // the orientation filter as the plugin sets it up
+
+    std::vector<Benchmark> results;
+    CaptureImuStream stream;
+
+    if (!stream.read(capture))
+    {
+        return results;
+    }
+
+    const auto numSamples = stream.getNumSamples();
+    if (numSamples < JitterLagScore::maxLagSamples * 2)
+    {
+        return results;
+    }
+
+    const auto neutral = stream.getGyroNeutral();
+
+    // pitch and roll normalised like the default mappings (0..4.4 and -4.4..4.4), and the rotation rate
+    std::vector<float> pitch((size_t)numSamples), roll((size_t)numSamples), rate((size_t)numSamples);
+
+    ImuBatch batch;
+
+    for (int start = 0; start < numSamples; start += CaptureImuStream::samplesPerReport)
+    {
+        batch.clear();
+
+        for (int i = start; i < start + CaptureImuStream::samplesPerReport; ++i)
+        {
+            batch.add(stream.acc[(size_t)i], stream.gyr[(size_t)i], neutral, stream.header.isLeft, alpha, stream.dtSec[(size_t)i]);
+        }
+
+        batch.processScalar();
+
+        for (int lane = 0; lane < batch.size(); ++lane)
+        {
+            const auto o = batch.getOrientation(lane);
+            pitch[(size_t)(start + lane)] = o.x / 4.4f;
+            roll[(size_t)(start + lane)] = (o.y + 4.4f) / 8.8f;
+            rate[(size_t)(start + lane)] = batch.getGyro(lane).length();
+        }
+    }
+
+    const auto sampleMs = (stream.timeMs.back() - stream.timeMs.front()) / (double)(numSamples - 1);
+
+    JitterLagScore raw;
+    raw.add(pitch.data(), roll.data(), pitch.data(), roll.data(), rate.data(), numSamples);
+
+    std::vector<float> outPitch((size_t)numSamples), outRoll((size_t)numSamples);
+
+    for (auto& candidate : candidates)
+    {
+        OneEuroBank bank;
+        bank.configure({ candidate, candidate });
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float v[2] = { pitch[(size_t)i], roll[(size_t)i] };
+            bank.process(v, i > 0 ? (float)((stream.timeMs[(size_t)i] - stream.timeMs[(size_t)i - 1]) * 0.001) : 0.f);
+            outPitch[(size_t)i] = v[0];
+            outRoll[(size_t)i] = v[1];
+        }
+
+        JitterLagScore score;
+        score.add(outPitch.data(), outRoll.data(), pitch.data(), roll.data(), rate.data(), numSamples);
+
+        Benchmark b;
+        b.parameters = candidate;
+        b.stillSamples = score.stillPairs;
+        b.movingSamples = score.movingSamples;
+        b.jitterRms = score.getJitterRms();
+        b.rawJitterRms = raw.getJitterRms();
+        b.lagMs = score.getLagSamples() * sampleMs;
+
+        results.push_back(b);
+    }
+
+    return results;
+}
+
+juce::String OneEuroBank::toString(const std::vector<Benchmark>& results)
+{
+    juce::String s;
+
+    if (results.empty())
+    {
+        return "no usable IMU data";
+    }
+
+    s << "still samples " << results.front().stillSamples << ", moving samples " << results.front().movingSamples
+      << ", unfiltered jitter " << juce::String(results.front().rawJitterRms * 1.0e3, 3) << "e-3\n";
+    s << "min cutoff Hz   beta   jitter rms e-3   lag ms\n";
+
+    for (auto& r : results)
+    {
+        s << juce::String(r.parameters.minCutoff, 2).paddedLeft(' ', 13) << juce::String(r.parameters.beta, 1).paddedLeft(' ', 7)
+          << juce::String(r.jitterRms * 1.0e3, 3).paddedLeft(' ', 17) << juce::String(r.lagMs, 1).paddedLeft(' ', 9) << "\n";
+    }
+
+    return s;
+}
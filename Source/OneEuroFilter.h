@@ -0,0 +1,115 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/* Settings for one One-Euro filter; a minCutoff of 0 turns it off. */
+struct OneEuroParameters
+{
+    float minCutoff = 0.f;              // Hz while still; lower is smoother and laggier at rest
+    float beta = 0.f;                   // Hz added per unit/s of speed; higher follows fast moves more closely
+    float derivativeCutoff = 1.f;       // Hz, smoothing of the speed estimate
+
+    bool isEnabled() const
+    {
+        return minCutoff > 0.f;
+    }
+
+    bool operator== (const OneEuroParameters& other) const
+    {
+        return minCutoff == other.minCutoff && beta == other.beta && derivativeCutoff == other.derivativeCutoff;
+    }
+};
+
+/*
+    Jitter and lag of a smoothed pitch / roll stream against a reference, the
+    one scoring OneEuroBank::benchmark and joycon-tune share. Samples are
+    still or moving by rotation rate; jitter is the output's sample to sample
+    change over still pairs, and while moving the output is compared with the
+    reference at each delay, the least error giving the lag.
+*/
+struct JitterLagScore
+{
+    static constexpr float stillBelow = 5.f;        // deg/s
+    static constexpr float movingAbove = 30.f;
+    static constexpr int maxLagSamples = 40;
+
+    int stillPairs = 0;
+    double jitterSquares = 0;                       // both channels, summed over still pairs
+    int movingSamples = 0;
+    std::array<double, maxLagSamples + 1> errorSquares {};     // both channels, at each delay of the reference
+
+    /* Accumulates n samples; rate is in deg/s. The first maxLagSamples only count for jitter. */
+    void add(const float* pitch, const float* roll, const float* referencePitch, const float* referenceRoll,
+             const float* rate, int n);
+
+    /* Per channel, in the streams' units. */
+    double getJitterRms() const;
+
+    /* Error while moving at no delay, per channel, in the streams' units. */
+    double getTrackingRms() const;
+
+    /* The delay with the least error, interpolated between samples; 0 without moving samples. */
+    double getLagSamples() const;
+};
+
+/*
+    A bank of One-Euro filters (Casiez, Roussel and Vogel), one per channel:
+    first order low passes whose cutoff rises with the filtered speed, so a
+    still controller is smoothed heavily while a fast movement comes through
+    with little lag. The state is structure-of-arrays and process() filters
+    every channel in one pass, four at a time with SSE / NEON.
+*/
+class OneEuroBank
+{
+public:
+    /* Allocates; call off the audio thread. */
+    void configure(const std::vector<OneEuroParameters>& channels);
+
+    int size() const
+    {
+        return numChannels;
+    }
+
+    /* The next process() passes its input through and restarts the filters from it. */
+    void reset()
+    {
+        primed = false;
+    }
+
+    /*
+        Filters values (size() of them) in place. Channels that are off pass
+        through. dtSec <= 0, i.e. the same input again, repeats the previous
+        outputs without advancing the filters.
+    */
+    void process(float* values, float dtSec);
+
+    struct Benchmark
+    {
+        OneEuroParameters parameters;
+        int stillSamples = 0;
+        int movingSamples = 0;
+        double jitterRms = 0;           // sample to sample change while still, in mapping units (0..1 over the range)
+        double rawJitterRms = 0;        // the same, unfiltered
+        double lagMs = 0;               // delay that best aligns the output with the input while moving
+    };
+
+    /*
+        Replays a capture (see Capture.h) through the orientation filter and
+        smooths pitch and roll, normalised like the default mappings, with
+        each candidate setting.
+    */
+    static std::vector<Benchmark> benchmark(const juce::File& capture, const std::vector<OneEuroParameters>& candidates);
+
+    static std::vector<OneEuroParameters> getBenchmarkCandidates();
+    static juce::String toString(const std::vector<Benchmark>& results);
+
+private:
+    struct Kernel;
+    friend struct Kernel;
+
+    int numChannels = 0;
+    bool primed = false;
+
+    std::vector<float> minCutoff, beta, derivativeCutoff;
+    std::vector<float> filtered, speed;
+};
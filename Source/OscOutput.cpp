@@ -0,0 +1,465 @@
+#include "OscOutput.h"
+
+namespace
+{
+    constexpr int bundleHeaderSize = 16;    // "#bundle\0" and the time tag
+
+    inline void writeInt32(juce::uint8* dest, juce::uint32 v)
+    {
+        dest[0] = (juce::uint8)(v >> 24);
+        dest[1] = (juce::uint8)(v >> 16);
+        dest[2] = (juce::uint8)(v >> 8);
+        dest[3] = (juce::uint8)v;
+    }
+
+    inline void writeFloat32(juce::uint8* dest, float v)
+    {
+        juce::uint32 bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        writeInt32(dest, bits);
+    }
+
+    inline juce::int32 readInt32(const juce::uint8* src)
+    {
+        return (juce::int32)(((juce::uint32)src[0] << 24) | ((juce::uint32)src[1] << 16) | ((juce::uint32)src[2] << 8) | (juce::uint32)src[3]);
+    }
+
+    int writeBundleHeader(juce::uint8* dest)
+    {
+        std::memcpy(dest, "#bundle", 8);
+
+        // time tag 1: "immediately"
+        writeInt32(dest + 8, 0);
+        writeInt32(dest + 12, 1);
+        return bundleHeaderSize;
+    }
+}
+
+//==============================================================================
+OscSettings OscSettings::fromString(const juce::String& s)
+{
+    OscSettings o;
+    juce::StringArray tokens;
+    tokens.addTokens(s, ",", {});
+
+    for (auto t : tokens)
+    {
+        t = t.trim();
+
+        if (t.startsWithIgnoreCase("rate="))
+        {
+            o.maxRateHz = juce::jmax(0.0, t.fromFirstOccurrenceOf("=", false, false).getDoubleValue());
+        }
+        else if (t.startsWithIgnoreCase("prefix="))
+        {
+            o.prefix = t.fromFirstOccurrenceOf("=", false, false);
+        }
+        else if (t.containsChar(':'))
+        {
+            o.host = t.upToLastOccurrenceOf(":", false, false);
+            o.port = t.fromLastOccurrenceOf(":", false, false).getIntValue();
+        }
+        else if (t.containsOnly("0123456789") && t.isNotEmpty())
+        {
+            o.port = t.getIntValue();
+        }
+    }
+
+    return o;
+}
+
+juce::String OscSettings::toString() const
+{
+    return host + ":" + juce::String(port) + ",rate=" + juce::String(maxRateHz) + ",prefix=" + prefix;
+}
+
+//==============================================================================
+OscSender::OscSender()
+    : juce::Thread("OSC sender")
+{
+}
+
+OscSender::~OscSender()
+{
+    stop();
+}
+
+OscSender::Address OscSender::encodeAddress(const juce::String& address, const char* typeTag)
+{
+    Address a;
+
+    auto append = [&a](const char* text)
+    {
+        const auto length = (int)std::strlen(text);
+        const auto padded = (length + 4) & ~3;      // at least one terminating zero
+
+        if (a.size + padded <= (int)a.bytes.size())
+        {
+            std::memcpy(a.bytes.data() + a.size, text, (size_t)length);
+            a.size += padded;
+        }
+    };
+
+    append(address.toRawUTF8());
+    append(typeTag);
+    return a;
+}
+
+bool OscSender::start(const OscSettings& newSettings, const std::vector<GestureTemplate>& templates)
+{
+    stop();
+
+    settings = newSettings;
+    auto prefix = settings.prefix.trimCharactersAtEnd("/");
+    if (!prefix.startsWithChar('/'))
+    {
+        prefix = "/" + prefix;
+    }
+
+    for (int i = 0; i < MappingSource::numSources; ++i)
+    {
+        const bool isButton = MappingSource::isButton(i);
+        sourceAddresses[(size_t)i] = encodeAddress(prefix + "/" + MappingSource::getName(i), isButton ? ",i" : ",f");
+
+        // about 12 bits of resolution over the source's range
+        thresholds[(size_t)i] = isButton ? 0.5f : MappingSource::getRange(i).getLength() / 4096.f;
+    }
+
+    numGestures = juce::jmin((int)templates.size(), GestureEngine::maxTemplates);
+    for (int i = 0; i < numGestures; ++i)
+    {
+        gestureAddresses[(size_t)i] = encodeAddress(prefix + "/gesture/" + templates[(size_t)i].name, ",i");
+    }
+
+    lastSent.fill(0.f);
+    seenDetections.fill(0);
+    pendingDetections.fill(0);
+    sentAny = false;
+    lastBundleMs = 0;
+    fifo.reset();
+
+    packets = 0;
+    bytes = 0;
+    queueFull = 0;
+    sendErrors = 0;
+    packetsPerSecond = 0;
+    bytesPerSecond = 0;
+
+    socket = std::make_unique<juce::DatagramSocket>(false);
+    running = startThread();
+    return running;
+}
+
+void OscSender::stop()
+{
+    running = false;
+    stopThread(1000);
+    socket.reset();
+}
+
+void OscSender::publish(const SourceFrame& frame, const GestureEngine* gestures)
+{
+    if (!running)
+    {
+        return;
+    }
+
+    if (gestures != nullptr)
+    {
+        // the first cycle only catches up with detections made before we started
+        for (int i = 0; i < numGestures; ++i)
+        {
+            const auto n = gestures->getNumDetections(i);
+            pendingDetections[(size_t)i] += sentAny ? n - seenDetections[(size_t)i] : 0;
+            seenDetections[(size_t)i] = n;
+        }
+    }
+
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    if (sentAny && settings.maxRateHz > 0 && now - lastBundleMs < 1000.0 / settings.maxRateHz)
+    {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+    {
+        // changes stay pending against lastSent, so the next bundle carries them
+        queueFull.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto* packet = slots[(size_t)start1].data();
+    auto size = writeBundleHeader(packet);
+
+    auto appendMessage = [&](const Address& address) -> juce::uint8*
+    {
+        if (size + 4 + address.size + 4 > maxPacketSize)
+        {
+            return nullptr;
+        }
+
+        writeInt32(packet + size, (juce::uint32)(address.size + 4));
+        std::memcpy(packet + size + 4, address.bytes.data(), (size_t)address.size);
+        size += 4 + address.size + 4;
+        return packet + size - 4;
+    };
+
+    for (int i = 0; i < MappingSource::numSources; ++i)
+    {
+        const auto v = frame.values[(size_t)i];
+        const bool isButton = MappingSource::isButton(i);
+
+        if (sentAny && std::abs(v - lastSent[(size_t)i]) < thresholds[(size_t)i])
+        {
+            continue;
+        }
+
+        auto* argument = appendMessage(sourceAddresses[(size_t)i]);
+        if (argument == nullptr)
+        {
+            break;
+        }
+
+        if (isButton)
+        {
+            writeInt32(argument, v > 0.5f ? 1 : 0);
+        }
+        else
+        {
+            writeFloat32(argument, v);
+        }
+
+        lastSent[(size_t)i] = v;
+    }
+
+    for (int i = 0; i < numGestures; ++i)
+    {
+        if (pendingDetections[(size_t)i] == 0)
+        {
+            continue;
+        }
+
+        auto* argument = appendMessage(gestureAddresses[(size_t)i]);
+        if (argument == nullptr)
+        {
+            break;
+        }
+
+        writeInt32(argument, pendingDetections[(size_t)i]);
+        pendingDetections[(size_t)i] = 0;
+    }
+
+    sentAny = true;
+
+    if (size == bundleHeaderSize)
+    {
+        return;
+    }
+
+    slotSizes[(size_t)start1] = size;
+    fifo.finishedWrite(1);
+    lastBundleMs = now;
+    notify();
+}
+
+void OscSender::run()
+{
+    auto windowStart = juce::Time::getMillisecondCounterHiRes();
+    juce::uint64 windowPackets = 0, windowBytes = 0;
+
+    while (!threadShouldExit())
+    {
+        wait(100);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numSlots, start1, size1, start2, size2);
+
+        auto send = [this](int slot)
+        {
+            const auto size = slotSizes[(size_t)slot];
+
+            if (socket->write(settings.host, settings.port, slots[(size_t)slot].data(), size) == size)
+            {
+                packets.fetch_add(1, std::memory_order_relaxed);
+                bytes.fetch_add((juce::uint64)size, std::memory_order_relaxed);
+            }
+            else
+            {
+                sendErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        for (int i = 0; i < size1; ++i)
+        {
+            send(start1 + i);
+        }
+
+        for (int i = 0; i < size2; ++i)
+        {
+            send(start2 + i);
+        }
+
+        fifo.finishedRead(size1 + size2);
+
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        if (now - windowStart >= 1000.0)
+        {
+            const auto p = packets.load(std::memory_order_relaxed);
+            const auto b = bytes.load(std::memory_order_relaxed);
+            const auto seconds = (now - windowStart) * 0.001;
+
+            packetsPerSecond = (double)(p - windowPackets) / seconds;
+            bytesPerSecond = (double)(b - windowBytes) / seconds;
+
+            windowStart = now;
+            windowPackets = p;
+            windowBytes = b;
+        }
+    }
+}
+
+OscSender::Stats OscSender::getStats() const
+{
+    Stats s;
+    s.packets = packets.load(std::memory_order_relaxed);
+    s.bytes = bytes.load(std::memory_order_relaxed);
+    s.queueFull = queueFull.load(std::memory_order_relaxed);
+    s.sendErrors = sendErrors.load(std::memory_order_relaxed);
+    s.packetsPerSecond = packetsPerSecond.load(std::memory_order_relaxed);
+    s.bytesPerSecond = bytesPerSecond.load(std::memory_order_relaxed);
+    return s;
+}
+
+//==============================================================================
+int OscSender::countBundleMessages(const juce::uint8* data, int size)
+{
+    if (size < bundleHeaderSize || std::memcmp(data, "#bundle", 8) != 0)
+    {
+        return -1;
+    }
+
+    int count = 0;
+    for (int pos = bundleHeaderSize; pos < size;)
+    {
+        if (pos + 4 > size)
+        {
+            return -1;
+        }
+
+        const auto elementSize = readInt32(data + pos);
+        if (elementSize <= 0 || (elementSize & 3) != 0 || pos + 4 + elementSize > size || data[pos + 4] != '/')
+        {
+            return -1;
+        }
+
+        pos += 4 + elementSize;
+        ++count;
+    }
+
+    return count;
+}
+
+juce::String OscSender::LoopbackTest::toString() const
+{
+    juce::String s;
+    s << framesPublished << " poll cycles, " << (int)packetsSent << " bundles sent, " << (int)packetsReceived << " received ("
+      << (int)messagesReceived << " messages, " << malformed << " malformed)\n";
+    s << juce::String(packetsPerSecond, 1) << " packets/s, " << juce::String(bytesPerSecond / 1024.0, 1) << " KiB/s, "
+      << juce::String(publishNanoseconds, 0) << " ns per publish()";
+    return s;
+}
+
+OscSender::LoopbackTest OscSender::testLoopback(double seconds, double pollHz, double maxRateHz)
+{
+    LoopbackTest result;
+
+    juce::DatagramSocket receiver(false);
+    if (!receiver.bindToPort(0, "127.0.0.1"))
+    {
+        return result;
+    }
+
+    OscSettings s;
+    s.port = receiver.getBoundPort();
+    s.maxRateHz = maxRateHz;
+
+    OscSender sender;
+    if (!sender.start(s, GestureEngine::getDefaultTemplates()))
+    {
+        return result;
+    }
+
+    std::array<juce::uint8, maxPacketSize> buffer;
+
+    auto drain = [&]
+    {
+        while (receiver.waitUntilReady(true, 0) == 1)
+        {
+            const auto n = receiver.read(buffer.data(), (int)buffer.size(), false);
+            if (n <= 0)
+            {
+                break;
+            }
+
+            const auto messages = countBundleMessages(buffer.data(), n);
+            ++result.packetsReceived;
+            result.bytesReceived += (juce::uint64)n;
+
+            if (messages < 0)
+            {
+                ++result.malformed;
+            }
+            else
+            {
+                result.messagesReceived += (juce::uint64)messages;
+            }
+        }
+    };
+
+    const auto numFrames = juce::jmax(1, (int)(seconds * pollHz));
+    const auto intervalMs = 1000.0 / pollHz;
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+    juce::int64 publishTicks = 0;
+
+    for (int f = 0; f < numFrames; ++f)
+    {
+        // slow tilt, a circling stick and a button tapped every half second
+        const auto t = f / pollHz;
+        SourceFrame frame;
+        frame.values[MappingSource::pitch] = 2.f * (float)std::sin(juce::MathConstants<double>::twoPi * 0.3 * t);
+        frame.values[MappingSource::roll] = 3.f * (float)std::sin(juce::MathConstants<double>::twoPi * 0.2 * t);
+        frame.values[MappingSource::stickX] = (float)std::cos(juce::MathConstants<double>::twoPi * 0.5 * t);
+        frame.values[MappingSource::stickY] = (float)std::sin(juce::MathConstants<double>::twoPi * 0.5 * t);
+        frame.values[MappingSource::accZ] = 1.f;
+        frame.values[MappingSource::firstButton] = std::fmod(t, 0.5) < 0.1 ? 1.f : 0.f;
+
+        const auto before = juce::Time::getHighResolutionTicks();
+        sender.publish(frame, nullptr);
+        publishTicks += juce::Time::getHighResolutionTicks() - before;
+        ++result.framesPublished;
+
+        const auto nextMs = startMs + (f + 1) * intervalMs;
+        while (juce::Time::getMillisecondCounterHiRes() < nextMs)
+        {
+            drain();
+            juce::Thread::sleep(1);
+        }
+    }
+
+    // let the last bundles arrive
+    const auto elapsed = (juce::Time::getMillisecondCounterHiRes() - startMs) * 0.001;
+    for (int i = 0; i < 20; ++i)
+    {
+        drain();
+        juce::Thread::sleep(5);
+    }
+
+    result.packetsSent = sender.getStats().packets;
+    result.publishNanoseconds = juce::Time::highResolutionTicksToSeconds(publishTicks) * 1.0e9 / result.framesPublished;
+    result.packetsPerSecond = (double)result.packetsReceived / elapsed;
+    result.bytesPerSecond = (double)result.bytesReceived / elapsed;
+    return result;
+}
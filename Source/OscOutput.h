@@ -0,0 +1,130 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "MappingMatrix.h"
+#include "GestureEngine.h"
+
+struct OscSettings
+{
+    juce::String host = "127.0.0.1";
+    int port = 9000;
+    double maxRateHz = 100.0;           // bundles per second, 0 for one every poll cycle
+    juce::String prefix = "/joycon";
+
+    /* Parses e.g. "127.0.0.1:9000,rate=60,prefix=/left". Unknown tokens are ignored. */
+    static OscSettings fromString(const juce::String& s);
+
+    juce::String toString() const;
+};
+
+/*
+    Streams the controller state as OSC over UDP, for visuals and lighting
+    software on the same machine. Each poll cycle's changes (axes that moved,
+    buttons that changed, gestures detected since the last bundle) go out as
+    one OSC bundle in one datagram:
+
+        <prefix>/<source name>          f   axes, in MappingSource units
+        <prefix>/<button name>          i   1 held, 0 released
+        <prefix>/gesture/<name>         i   detections since the last bundle
+
+    publish() encodes straight into a preallocated slot using precomputed
+    addresses and hands it to a dedicated send thread through a lock-free
+    queue, so the poll cycle never touches the socket. With a rate limit,
+    changes carry over until the next bundle is due.
+*/
+class OscSender : private juce::Thread
+{
+public:
+    static constexpr int maxPacketSize = 1472;          // fits an Ethernet MTU; loopback takes it unfragmented
+    static constexpr int numSlots = 16;
+
+    OscSender();
+    ~OscSender() override;
+
+    /* Message thread. Gesture names are taken from templates for the gesture addresses. */
+    bool start(const OscSettings& settings, const std::vector<GestureTemplate>& templates);
+    void stop();
+
+    bool isRunning() const
+    {
+        return running;
+    }
+
+    const OscSettings& getSettings() const
+    {
+        return settings;
+    }
+
+    /* Poll thread, once per cycle. Never allocates or blocks; gestures may be null. */
+    void publish(const SourceFrame& frame, const GestureEngine* gestures);
+
+    struct Stats
+    {
+        juce::uint64 packets = 0;
+        juce::uint64 bytes = 0;
+        juce::uint64 queueFull = 0;         // bundles deferred because the send thread fell behind
+        juce::uint64 sendErrors = 0;
+        double packetsPerSecond = 0;        // over the last second
+        double bytesPerSecond = 0;
+    };
+
+    Stats getStats() const;
+
+    struct LoopbackTest
+    {
+        int framesPublished = 0;
+        juce::uint64 packetsSent = 0;
+        juce::uint64 packetsReceived = 0;
+        juce::uint64 bytesReceived = 0;
+        juce::uint64 messagesReceived = 0;
+        int malformed = 0;
+        double publishNanoseconds = 0;      // mean cost of publish()
+        double packetsPerSecond = 0;
+        double bytesPerSecond = 0;
+
+        juce::String toString() const;
+    };
+
+    /* Sends synthetic motion to a receiver on 127.0.0.1 for the given time, at pollHz cycles a second. */
+    static LoopbackTest testLoopback(double seconds = 2.0, double pollHz = 200.0, double maxRateHz = 0.0);
+
+    /* Number of messages in a bundle, or -1 if it isn't a well formed one. */
+    static int countBundleMessages(const juce::uint8* data, int size);
+
+private:
+    void run() override;
+
+    struct Address
+    {
+        std::array<char, 64> bytes {};      // address and type tag, each zero padded to 4 bytes
+        int size = 0;
+    };
+
+    static Address encodeAddress(const juce::String& address, const char* typeTag);
+
+    OscSettings settings;
+    bool running = false;
+
+    std::array<Address, MappingSource::numSources> sourceAddresses;
+    std::array<Address, GestureEngine::maxTemplates> gestureAddresses;
+    int numGestures = 0;
+
+    // poll thread state
+    std::array<float, MappingSource::numSources> lastSent {};
+    std::array<float, MappingSource::numSources> thresholds {};
+    std::array<juce::uint32, GestureEngine::maxTemplates> seenDetections {};
+    std::array<juce::uint32, GestureEngine::maxTemplates> pendingDetections {};
+    bool sentAny = false;
+    double lastBundleMs = 0;
+
+    juce::AbstractFifo fifo { numSlots };
+    std::array<std::array<juce::uint8, maxPacketSize>, numSlots> slots {};
+    std::array<int, numSlots> slotSizes {};
+
+    std::unique_ptr<juce::DatagramSocket> socket;
+
+    std::atomic<juce::uint64> packets { 0 }, bytes { 0 }, queueFull { 0 }, sendErrors { 0 };
+    std::atomic<double> packetsPerSecond { 0 }, bytesPerSecond { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (OscSender)
+};
@@ -19,8 +19,90 @@ JoyconGoodnessAudioProcessorEditor::JoyconGoodnessAudioProcessorEditor (JoyconGo
 
     addAndMakeVisible(hidText);
 
+    // item id - 1 indexes gridDivisions
+    gridSelector.addItemList({ "No quantize", "1/4", "1/8", "1/16", "1/32", "1/8 triplet", "1/16 triplet" }, 1);
+    gridSelector.setSelectedItemIndex(juce::jmax(0, gridDivisions.indexOf(audioProcessor.getQuantizer().getDivision())), juce::dontSendNotification);
+    gridSelector.addListener(this);
+    addAndMakeVisible(gridSelector);
+
+    mpeToggle.setToggleState(audioProcessor.getMpeSettings().enabled, juce::dontSendNotification);
+    mpeToggle.onClick = [this]
+    {
+        auto s = audioProcessor.getMpeSettings();
+        s.enabled = mpeToggle.getToggleState();
+        audioProcessor.setMpeSettings(s);
+    };
+    addAndMakeVisible(mpeToggle);
+
+    // while on, the next controller picked is attached as the second of a pair
+    pairToggle.setToggleState(audioProcessor.isPaired(), juce::dontSendNotification);
+    pairToggle.onClick = [this]
+    {
+        if (!pairToggle.getToggleState())
+        {
+            audioProcessor.clearPartner();
+            scope.setSources({ &audioProcessor.getTelemetry() });
+        }
+    };
+    addAndMakeVisible(pairToggle);
+
+    presetSelector.setTextWhenNothingSelected("No preset");
+    presetSelector.addListener(this);
+    refreshPresets();
+    addAndMakeVisible(presetSelector);
+
+    storePreset.onClick = [this]
+    {
+        audioProcessor.storePreset("Preset " + juce::String(audioProcessor.getPresetNames().size() + 1));
+        refreshPresets();
+    };
+    addAndMakeVisible(storePreset);
+
+    // item id 1 is none, then id - 2 + firstButton
+    presetButtonSelector.addItem("No preset button", 1);
+    for (int b = MappingSource::firstButton; b < MappingSource::partnerPitch; ++b)
+    {
+        presetButtonSelector.addItem("Presets on " + MappingSource::getName(b), b - MappingSource::firstButton + 2);
+    }
+
+    const auto presetButton = audioProcessor.getPresetButton();
+    presetButtonSelector.setSelectedId(presetButton >= 0 ? presetButton - MappingSource::firstButton + 2 : 1, juce::dontSendNotification);
+    presetButtonSelector.addListener(this);
+    addAndMakeVisible(presetButtonSelector);
+
+    // each take goes to a new file in the user's music folder
+    recordToggle.setToggleState(audioProcessor.getRecorder().isRecording(), juce::dontSendNotification);
+    recordToggle.onClick = [this]
+    {
+        if (recordToggle.getToggleState())
+        {
+            auto name = "Joycon " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S");
+            auto file = juce::File::getSpecialLocation(juce::File::userMusicDirectory).getNonexistentChildFile(name, ".mid");
+
+            if (!audioProcessor.startRecording(file))
+            {
+                recordToggle.setToggleState(false, juce::dontSendNotification);
+            }
+        }
+        else
+        {
+            audioProcessor.stopRecording();
+        }
+    };
+    addAndMakeVisible(recordToggle);
+
     addAndMakeVisible(outText);
 
+    if (audioProcessor.isPaired())
+    {
+        scope.setSources({ &audioProcessor.getTelemetry(), &audioProcessor.getPartnerTelemetry() });
+    }
+    else
+    {
+        scope.setSources({ &audioProcessor.getTelemetry() });
+    }
+    addAndMakeVisible(scope);
+
     setSize (800, 600);
 
     getLocalBounds();
@@ -45,7 +127,15 @@ void JoyconGoodnessAudioProcessorEditor::resized()
 {
     hidSelector.setBoundsRelative(.0f, .0f, .3f, .1f);
     hidText.setBoundsRelative(.3f, .0f, .3f, .1f);
+    gridSelector.setBoundsRelative(.6f, .0f, .2f, .1f);
+    mpeToggle.setBoundsRelative(.8f, .0f, .1f, .1f);
+    pairToggle.setBoundsRelative(.9f, .0f, .1f, .1f);
+    presetSelector.setBoundsRelative(.0f, .1f, .3f, .1f);
+    storePreset.setBoundsRelative(.3f, .1f, .1f, .1f);
+    presetButtonSelector.setBoundsRelative(.4f, .1f, .3f, .1f);
+    recordToggle.setBoundsRelative(.7f, .1f, .1f, .1f);
     outText.setBoundsRelative(0.f, .2f, .3f, .1f);
+    scope.setBoundsRelative(0.f, .3f, 1.f, .7f);
 }
 
 void JoyconGoodnessAudioProcessorEditor::mouseDown (const MouseEvent& event)
@@ -58,13 +148,29 @@ void JoyconGoodnessAudioProcessorEditor::mouseDown (const MouseEvent& event)
         hidSelector.clear();
         for (auto iter = hidDevies.begin(); iter < hidDevies.end(); iter++)
         {
-            hidSelector.addItem(juce::String{iter->product_string}, idx++);
+            hidSelector.addItem(iter->product, idx++);
         }
     }
 }
 
 void JoyconGoodnessAudioProcessorEditor::comboBoxChanged (ComboBox* comboBoxThatHasChanged)
 {
+    if (comboBoxThatHasChanged == &gridSelector)
+    {
+        audioProcessor.setQuantizeDivision(gridDivisions[gridSelector.getSelectedItemIndex()]);
+    }
+
+    if (comboBoxThatHasChanged == &presetSelector)
+    {
+        audioProcessor.selectPreset(presetSelector.getSelectedItemIndex());
+    }
+
+    if (comboBoxThatHasChanged == &presetButtonSelector)
+    {
+        const auto id = presetButtonSelector.getSelectedId();
+        audioProcessor.setPresetButton(id > 1 ? id - 2 + MappingSource::firstButton : -1);
+    }
+
     if (comboBoxThatHasChanged == &hidSelector)
     {
         auto id = hidSelector.getSelectedId();
@@ -73,7 +179,14 @@ void JoyconGoodnessAudioProcessorEditor::comboBoxChanged (ComboBox* comboBoxThat
         {
             auto info = hidDevies[(u_long)id - 1];
 
-            if (true == audioProcessor.setHidDevice(info))
+            if (pairToggle.getToggleState() && nullptr != audioProcessor.getJoycon())
+            {
+                if (audioProcessor.setPartnerDevice(info))
+                {
+                    scope.setSources({ &audioProcessor.getTelemetry(), &audioProcessor.getPartnerTelemetry() });
+                }
+            }
+            else if (true == audioProcessor.setHidDevice(info))
             {
                 joyconAttached();
             }
@@ -10,6 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "TelemetryScope.h"
 
 //==============================================================================
 /**
@@ -31,28 +32,82 @@ private:
     JoyconGoodnessAudioProcessor& audioProcessor;
 
     juce::ComboBox hidSelector;
+    juce::ComboBox gridSelector;
+    juce::ToggleButton mpeToggle { "MPE" };
+    juce::ToggleButton pairToggle { "Pair" };
+    juce::ComboBox presetSelector;
+    juce::TextButton storePreset { "Store" };
+    juce::ComboBox presetButtonSelector;
+    juce::ToggleButton recordToggle { "Rec" };
     juce::TextButton hidText;
     juce::TextButton outText;
-    std::vector<hid_device_info> hidDevies;
+    TelemetryScope scope;
+    std::vector<HidDeviceEntry> hidDevies;
+    const juce::Array<double> gridDivisions { 0.0, 1.0, 0.5, 0.25, 0.125, 1.0 / 3.0, 1.0 / 6.0 };
 
+    // the scope shows the live signal, this is only a coarse numeric readout
     void timerCallback() override
     {
         if (nullptr != audioProcessor.getJoycon())
         {
+            auto pry = audioProcessor.getJoycon()->GetOrientation();
+
             juce::String str = "";
-            str += "pitch: " + juce::String(audioProcessor.getJoycon()->getPitchRollYaw().x, 2) + " ";
-            str += "roll: " + juce::String(audioProcessor.getJoycon()->getPitchRollYaw().y, 2) + " ";
-            str += "yaw: " + juce::String(audioProcessor.getJoycon()->getPitchRollYaw().z, 2) + " ";
+            str += "pitch: " + juce::String(pry.x, 2) + " ";
+            str += "roll: " + juce::String(pry.y, 2) + " ";
+            str += "yaw: " + juce::String(pry.z, 2) + " ";
+
+            auto& stats = audioProcessor.getJoycon()->GetConnectionStats();
+            if (stats.drops > 0)
+            {
+                str += "reconnects: " + juce::String(stats.reconnects.load()) + "/" + juce::String(stats.drops.load());
+                str += " (last " + juce::String(stats.lastRecoveryMs.load()) + "ms)";
+            }
+
+            if (audioProcessor.isPaired())
+            {
+                auto skew = audioProcessor.getPair().getSkewStats();
+                str += "skew: " + juce::String(skew.lastMs, 1) + "ms (max " + juce::String(skew.maxAbsMs, 1) + "ms) ";
+            }
+
+            str += "late: " + juce::String(audioProcessor.getScheduler().getMaxLatenessMs(), 1) + "ms max ";
+
+            auto grid = audioProcessor.getQuantizer().getStats();
+            if (grid.notes > 0)
+            {
+                str += "grid error: " + juce::String(grid.meanAbsErrorMs, 1) + "ms avg, " + juce::String(grid.maxAbsErrorMs, 1) + "ms max";
+            }
+
+            if (audioProcessor.getRecorder().isRecording())
+            {
+                auto rec = audioProcessor.getRecorder().getStats();
+                str += " rec: " + juce::String(rec.seconds, 0) + "s " + juce::String((juce::int64)rec.events) + " events";
+                if (rec.dropped > 0)
+                {
+                    str += " (" + juce::String((juce::int64)rec.dropped) + " dropped)";
+                }
+            }
+
             outText.setButtonText(str);
+
+            // the preset button may have changed it
+            presetSelector.setSelectedItemIndex(audioProcessor.getCurrentPreset(), juce::dontSendNotification);
         }
     }
 
+    void refreshPresets()
+    {
+        presetSelector.clear(juce::dontSendNotification);
+        presetSelector.addItemList(audioProcessor.getPresetNames(), 1);
+        presetSelector.setSelectedItemIndex(audioProcessor.getCurrentPreset(), juce::dontSendNotification);
+    }
+
     void joyconAttached()
     {
         if (nullptr != audioProcessor.getJoycon())
         {
-            hidText.setButtonText(juce::String{audioProcessor.getHidDeviceInfo()->product_string});
-            startTimer(10);
+            hidText.setButtonText(audioProcessor.getHidDeviceInfo()->product);
+            startTimerHz(4);
         }
     }
 
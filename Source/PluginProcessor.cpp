@@ -17,17 +17,48 @@ JoyconGoodnessAudioProcessor::JoyconGoodnessAudioProcessor()
                        )
 {
     hid_init();
+
+    // e.g. JOYCON_RT=fifo:80,cpu=2,mlock for the controller threads
+    realtimeConfig = RealtimeConfig::fromString(juce::SystemStats::getEnvironmentVariable("JOYCON_RT", {}));
+    hidrawHub.setRealtimeConfig(realtimeConfig);
+    scheduler->setRealtimeConfig(realtimeConfig);
+
+    deviceWatcher.addListener(this);
+    deviceWatcher.start();
+
+    // Opt-in timeline tracing, e.g. JOYCON_TRACE=/tmp/joycon-trace.json
+    auto tracePath = juce::SystemStats::getEnvironmentVariable("JOYCON_TRACE", {});
+    if (tracePath.isNotEmpty() && juce::File::isAbsolutePath(tracePath))
+    {
+        startTrace(juce::File(tracePath));
+    }
+
+    // Opt-in OSC output for visuals and lighting, e.g. JOYCON_OSC=127.0.0.1:9000,rate=60
+    auto oscSpec = juce::SystemStats::getEnvironmentVariable("JOYCON_OSC", {});
+    if (oscSpec.isNotEmpty())
+    {
+        oscSender.start(OscSettings::fromString(oscSpec), gestureEngine.getTemplates());
+    }
 }
 
 JoyconGoodnessAudioProcessor::~JoyconGoodnessAudioProcessor()
 {
+    deviceWatcher.removeListener(this);
+    deviceWatcher.stop();
+
     stopTimer();
+    scheduler->cancel(pollTask);
+    clearPartner();
+
     if (nullptr != joycon)
     {
         joycon->Detach();
         delete joycon;
     }
     hid_exit();
+
+    stopTrace();
+    stopRecording();
 }
 
 //==============================================================================
@@ -101,8 +132,18 @@ void JoyconGoodnessAudioProcessor::prepareToPlay (double sampleRate, int samples
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    (void)sampleRate;
-    (void)samplesPerBlock;
+    gestureNotes.prepare(sampleRate);
+    quantizer.prepare(sampleRate, samplesPerBlock);
+    controllerMidi.ensureSize((size_t)juce::jmax(256, samplesPerBlock) * 3);
+    mpeOutput.prepare(sampleRate, samplesPerBlock);
+    renderedSamples = 0;
+
+    // Opt-in recording of everything played, e.g. JOYCON_MIDI_RECORD=/tmp/joycon-take.mid
+    auto recordPath = juce::SystemStats::getEnvironmentVariable("JOYCON_MIDI_RECORD", {});
+    if (!midiRecorder.isRecording() && recordPath.isNotEmpty() && juce::File::isAbsolutePath(recordPath))
+    {
+        startRecording(juce::File(recordPath));
+    }
 }
 
 void JoyconGoodnessAudioProcessor::releaseResources()
@@ -119,6 +160,9 @@ bool JoyconGoodnessAudioProcessor::isBusesLayoutSupported (const BusesLayout& la
 
 void JoyconGoodnessAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    JOYCON_TRACE_SCOPE("processBlock");
+    ScopedAllocationCheck steadyState ("processBlock");
+
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -132,12 +176,202 @@ void JoyconGoodnessAudioProcessor::processBlock (juce::AudioBuffer<float>& buffe
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    midiMessages.clear();
-    if (nullptr != joycon)
+    // incoming notes are only used by MPE mode, which gives them per-note expression
+    mpeOutput.filterInput(midiMessages);
+
+    // offline, blocks are timed by the samples rendered since prepareToPlay (tick 0), so the same
+    // telemetry stamped on that clock renders the same output whatever the block size or CPU load
+    renderedSamples += buffer.getNumSamples();
+    const auto blockEndTicks = isNonRealtime() ? juce::Time::secondsToHighResolutionTicks((double)renderedSamples / getSampleRate())
+                                               : juce::Time::getHighResolutionTicks();
+
+    // the controller's notes are gathered apart so only they are quantized; the host's are already
+    // where the host wants them
+    controllerMidi.clear();
+
+    if (telemetry.active)
+    {
+        applyMappings(controllerMidi, buffer, blockEndTicks);
+    }
+
+    gestureNotes.process(gestureEngine, controllerMidi, buffer.getNumSamples());
+
+    quantizer.process(controllerMidi, buffer.getNumSamples(), getPlayHead());
+    midiMessages.addEvents(controllerMidi, 0, buffer.getNumSamples(), 0);
+
+    mpeOutput.process(midiMessages, buffer.getNumSamples(), telemetry.history, blockEndTicks);
+
+    midiRecorder.record(midiMessages, buffer.getNumSamples());
+}
+
+void JoyconGoodnessAudioProcessor::applyMappings(juce::MidiBuffer& midi, juce::AudioBuffer<float>& audio, juce::int64 blockEndTicks)
+{
+    JOYCON_TRACE_SCOPE("applyMappings");
+
+    mappingEngine.beginBlock(midi);
+
+    // every report that arrived during the last block, at its arrival offset one block later (as MpeOutput
+    // places them); a pair steps through both halves' reports in arrival order
+    const auto numSamples = audio.getNumSamples();
+    const auto ticksPerSample = (double)juce::Time::getHighResolutionTicksPerSecond() / getSampleRate();
+    const auto blockStart = blockEndTicks - (juce::int64)(numSamples * ticksPerSample);
+    const bool isPaired = paired;
+
+    const auto numFirst = telemetry.history.readLatest(recentTelemetry.data(), (int)recentTelemetry.size());
+    const auto numSecond = isPaired ? partnerTelemetry.history.readLatest(recentPartnerTelemetry.data(), (int)recentPartnerTelemetry.size()) : 0;
+    int nextFirst = 0, nextSecond = 0;
+
+    while (nextFirst < numFirst && recentTelemetry[(size_t)nextFirst].ticks <= lastMappedTicks)
+    {
+        ++nextFirst;
+    }
+
+    while (nextSecond < numSecond && recentPartnerTelemetry[(size_t)nextSecond].ticks <= lastMappedTicks)
+    {
+        ++nextSecond;
+    }
+
+    while (nextFirst < numFirst || nextSecond < numSecond)
+    {
+        const bool fromFirst = nextSecond >= numSecond
+                            || (nextFirst < numFirst && recentTelemetry[(size_t)nextFirst].ticks <= recentPartnerTelemetry[(size_t)nextSecond].ticks);
+        const auto& sample = fromFirst ? recentTelemetry[(size_t)nextFirst++] : recentPartnerTelemetry[(size_t)nextSecond++];
+
+        SourceFrame frame;
+        if (isPaired)
+        {
+            if (!pair.readAt(sample.deviceMs, frame))
+            {
+                continue;
+            }
+        }
+        else
+        {
+            frame = SourceFrame::fromTelemetry(sample);
+        }
+
+        const auto at = juce::jlimit(0, numSamples - 1, (int)((double)(sample.ticks - blockStart) / ticksPerSample));
+        mappingEngine.evaluate(frame, midi, at);
+        lastMappedTicks = juce::jmax(lastMappedTicks, sample.ticks);
+    }
+
+    // audio outputs hold the last value between reports, but stay untouched until there has been one
+    if (lastMappedTicks > 0)
     {
-        midiMessages.addEvent(juce::MidiMessage::controllerEvent(1,  16, (int)(joycon->getPitchRollYaw().x * 127.f)), 0);
-        midiMessages.addEvent(juce::MidiMessage::controllerEvent(1,  17, (int)(joycon->getPitchRollYaw().y * 127.f)), 0);
-        midiMessages.addEvent(juce::MidiMessage::controllerEvent(1,  18, (int)(joycon->getPitchRollYaw().z * 127.f)), 0);
+        mappingEngine.renderAudio(audio);
+    }
+}
+
+bool JoyconGoodnessAudioProcessor::setPartnerDevice(const HidDeviceEntry& info)
+{
+    if (joycon == nullptr)
+    {
+        return setHidDevice(info);
+    }
+
+    clearPartner();
+    return setPartnerDevice(HidTransport::open(info.path), info);
+}
+
+bool JoyconGoodnessAudioProcessor::setPartnerDevice(std::unique_ptr<HidTransport> dev, const HidDeviceEntry& info)
+{
+    if (joycon == nullptr)
+    {
+        return setHidDevice(std::move(dev), info);
+    }
+
+    clearPartner();
+
+    if (dev == nullptr)
+    {
+        return false;
+    }
+
+    // attached before it is swapped in, like setHidDevice(), so the poll task keeps running meanwhile;
+    // gestures stay with the first controller, the engine follows one sample stream
+    auto* next = new Joycon(std::move(dev), true, true, 0.05f, info.productId == Joycon::product_id_left, info.path);
+    next->SetTelemetry(&partnerTelemetry);
+    next->SetSettings(getControllerSettings());
+    next->SetRealtimeConfig(realtimeConfig);
+
+    if (HidrawHub::isAvailable())
+    {
+        next->SetHub(&hidrawHub);
+    }
+
+    partnerTelemetry.active = true;
+
+    if (!next->Attach())
+    {
+        next->Detach();
+        delete next;
+        partnerTelemetry.active = false;
+        return false;
+    }
+
+    {
+        const juce::ScopedLock sl(controllerLock);
+        partner = next;
+        partnerHidInfo = info;
+        partner->Begin();
+    }
+
+    pair.setSources(&telemetry, &partnerTelemetry);
+    paired = true;
+
+    return true;
+}
+
+void JoyconGoodnessAudioProcessor::clearPartner()
+{
+    paired = false;
+
+    Joycon* previous = nullptr;
+
+    {
+        const juce::ScopedLock sl(controllerLock);
+        previous = partner;
+        partner = nullptr;
+        partnerHidInfo = {};
+    }
+
+    if (previous != nullptr)
+    {
+        previous->Detach();
+        delete previous;
+    }
+
+    partnerTelemetry.active = false;
+}
+
+void JoyconGoodnessAudioProcessor::startCapture()
+{
+    if (joycon != nullptr)
+    {
+        joycon->SetCapture(nullptr);
+    }
+
+    capture.reset();
+
+    auto capturePath = juce::SystemStats::getEnvironmentVariable("JOYCON_CAPTURE", {});
+    if (joycon == nullptr || capturePath.isEmpty() || !juce::File::isAbsolutePath(capturePath))
+    {
+        return;
+    }
+
+    const auto cal = joycon->GetCalibration();
+
+    CaptureHeader header;
+    header.isLeft = currentHidInfo.productId == Joycon::product_id_left;
+    header.stickCalibration = cal.stick;
+    header.deadzone = cal.deadzone;
+    header.gyroNeutral = { cal.gyroNeutral.x, cal.gyroNeutral.y, cal.gyroNeutral.z };
+
+    capture = std::make_unique<CaptureWriter>(juce::File(capturePath), header);
+
+    if (capture->openedOk())
+    {
+        joycon->SetCapture(capture.get());
     }
 }
 
@@ -155,18 +389,255 @@ juce::AudioProcessorEditor* JoyconGoodnessAudioProcessor::createEditor()
 //==============================================================================
 void JoyconGoodnessAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    (void)destData;
+    PluginState state;
+    state.mappings = mappingEngine.getMappings();
+    state.quantizeDivision = quantizer.getDivision();
+    state.mpe = mpeOutput.getSettings();
+
+    {
+        // hosts save from any thread; the controller itself is only touched on the message thread, so this
+        // reads the copy taken when it attached
+        juce::ScopedLock l(stateLock);
+
+        state.controller = controllerSettings;
+        state.presets = presets;
+        state.currentPreset = currentPreset;
+        state.presetButton = presetButton;
+
+        if (hasAttachedState)
+        {
+            state.device = attachedState.device;
+            state.calibration = attachedState.calibration;
+            state.hasCalibration = true;
+        }
+        else
+        {
+            // still waiting for the restored controller to show up
+            state.device = restoredState.device;
+            state.calibration = restoredState.calibration;
+            state.hasCalibration = restoredState.hasCalibration;
+        }
+    }
+
+    state.writeTo(destData);
 }
 
 void JoyconGoodnessAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    (void)data;
-    (void)sizeInBytes;
+    PluginState state;
+
+    if (!state.readFrom(data, sizeInBytes))
+    {
+        return;
+    }
+
+    mappingEngine.setMappings(state.mappings);
+    quantizer.setDivision(state.quantizeDivision);
+    mpeOutput.setSettings(state.mpe);
+
+    {
+        juce::ScopedLock l(stateLock);
+        controllerSettings = state.controller;
+        presets = state.presets;
+        currentPreset = state.currentPreset;
+        presetButton = state.presetButton;
+        restoredState = std::move(state);
+    }
+
+    // hosts may restore from any thread, the controller is attached on the message thread
+    triggerAsyncUpdate();
+}
+
+void JoyconGoodnessAudioProcessor::handleAsyncUpdate()
+{
+    PluginState state;
+
+    {
+        juce::ScopedLock l(stateLock);
+        state = restoredState;
+    }
+
+    // the controllers are only touched on the message thread
+    setControllerSettings(state.controller);
+
+    if (state.device.path.isEmpty() || (joycon != nullptr && state.device.isSameController(currentHidInfo)))
+    {
+        return;
+    }
+
+    for (auto& d : deviceWatcher.getDevices())
+    {
+        if (d.isSameController(state.device))
+        {
+            setHidDevice(d);
+            return;
+        }
+    }
+
+    // not plugged in yet, joyconAdded() attaches it when it appears
+    currentHidInfo = state.device;
+    reattachPending = true;
+}
+
+//==============================================================================
+void JoyconGoodnessAudioProcessor::setControllerSettings(const Joycon::Settings& s)
+{
+    {
+        juce::ScopedLock l(stateLock);
+        controllerSettings = s;
+    }
+
+    // each controller swaps in a new snapshot; its poll cycle never sees a half written one
+    if (joycon != nullptr)
+    {
+        joycon->SetSettings(s);
+    }
+
+    if (partner != nullptr)
+    {
+        partner->SetSettings(s);
+    }
+}
+
+Joycon::Settings JoyconGoodnessAudioProcessor::getControllerSettings() const
+{
+    juce::ScopedLock l(stateLock);
+    return controllerSettings;
+}
+
+int JoyconGoodnessAudioProcessor::storePreset(const juce::String& name)
+{
+    Preset p;
+    p.name = name;
+    p.mappings = mappingEngine.getMappings();
+    p.quantizeDivision = quantizer.getDivision();
+    p.mpe = mpeOutput.getSettings();
+
+    juce::ScopedLock l(stateLock);
+    p.controller = controllerSettings;
+
+    // storing under an existing name replaces that preset
+    auto existing = std::find_if(presets.begin(), presets.end(), [&name](const Preset& q) { return q.name == name; });
+    if (existing != presets.end())
+    {
+        *existing = std::move(p);
+        currentPreset = (int)(existing - presets.begin());
+    }
+    else
+    {
+        presets.push_back(std::move(p));
+        currentPreset = (int)presets.size() - 1;
+    }
+
+    return currentPreset;
+}
+
+void JoyconGoodnessAudioProcessor::selectPreset(int index)
+{
+    Preset p;
+
+    {
+        juce::ScopedLock l(stateLock);
+
+        if (!juce::isPositiveAndBelow(index, (int)presets.size()))
+        {
+            return;
+        }
+
+        p = presets[(size_t)index];
+        currentPreset = index;
+    }
+
+    // every part goes through its own lock-free handoff; the audio thread picks them up on its next block
+    mappingEngine.setMappings(p.mappings);
+    quantizer.setDivision(p.quantizeDivision);
+    mpeOutput.setSettings(p.mpe);
+    setControllerSettings(p.controller);
+}
+
+juce::StringArray JoyconGoodnessAudioProcessor::getPresetNames() const
+{
+    juce::StringArray names;
+
+    juce::ScopedLock l(stateLock);
+    for (auto& p : presets)
+    {
+        names.add(p.name);
+    }
+
+    return names;
+}
+
+int JoyconGoodnessAudioProcessor::getCurrentPreset() const
+{
+    juce::ScopedLock l(stateLock);
+    return currentPreset;
+}
+
+void JoyconGoodnessAudioProcessor::setPresetButton(int source)
+{
+    juce::ScopedLock l(stateLock);
+    presetButton = MappingSource::isButton(source) ? source : -1;
+}
+
+int JoyconGoodnessAudioProcessor::getPresetButton() const
+{
+    juce::ScopedLock l(stateLock);
+    return presetButton;
+}
+
+void JoyconGoodnessAudioProcessor::stepPresetOnButton(const SourceFrame& frame)
+{
+    int button, next;
+
+    {
+        juce::ScopedLock l(stateLock);
+        button = presetButton;
+        next = presets.empty() ? -1 : (currentPreset + 1) % (int)presets.size();
+    }
+
+    const auto down = button >= 0 && frame.values[(size_t)button] > 0.5f;
+
+    if (down && !presetButtonDown && next >= 0)
+    {
+        selectPreset(next);
+    }
+
+    presetButtonDown = down;
+}
+
+//==============================================================================
+void JoyconGoodnessAudioProcessor::startTrace (const juce::File& file)
+{
+    traceFile = file;
+    Trace::setEnabled(true);
+}
+
+bool JoyconGoodnessAudioProcessor::stopTrace()
+{
+    if (traceFile == juce::File())
+    {
+        return false;
+    }
+
+    Trace::setEnabled(false);
+
+    auto ok = Trace::writeJson(traceFile);
+    traceFile = juce::File();
+
+    return ok;
+}
+
+bool JoyconGoodnessAudioProcessor::startRecording (const juce::File& file)
+{
+    // before prepareToPlay the rate is unknown; the file's timing follows whatever rate it was started with
+    const auto rate = getSampleRate() > 0.0 ? getSampleRate() : 48000.0;
+    return midiRecorder.start(file, rate);
+}
+
+void JoyconGoodnessAudioProcessor::stopRecording()
+{
+    midiRecorder.stop();
 }
 
 //==============================================================================
@@ -11,11 +11,23 @@
 #include <JuceHeader.h>
 #include "hidapi.h"
 #include "joycon.hpp"
+#include "DeviceWatcher.h"
+#include "MappingMatrix.h"
+#include "ControllerParameters.h"
+#include "PluginState.h"
+#include "GestureEngine.h"
+#include "Capture.h"
+#include "Quantizer.h"
+#include "MpeOutput.h"
+#include "OscOutput.h"
+#include "JoyconPair.h"
+#include "Scheduler.h"
+#include "MidiRecorder.h"
 
 //==============================================================================
 /**
 */
-class JoyconGoodnessAudioProcessor  : public juce::AudioProcessor, public juce::Timer
+class JoyconGoodnessAudioProcessor  : public juce::AudioProcessor, public juce::Timer, private DeviceWatcher::Listener, private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -55,51 +67,95 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    std::vector<hid_device_info> getHidDevices(void)
+    /* Cached by the background watcher, so this never enumerates on the calling thread. */
+    std::vector<HidDeviceEntry> getHidDevices(void)
     {
-        auto info = hid_enumerate(0, 0);
-        std::vector<hid_device_info> devices;
+        return deviceWatcher.getDevices();
+    }
 
-        while (nullptr != info)
+    bool setHidDevice(const HidDeviceEntry& info)
+    {
+        return setHidDevice(HidTransport::open(info.path), info);
+    }
+
+    /* Attaches a controller on a transport that is already open, e.g. a SimulatedTransport. Message thread. */
+    bool setHidDevice(std::unique_ptr<HidTransport> dev, const HidDeviceEntry& info)
+    {
+        if (nullptr == dev)
         {
-            juce::String str(info->product_string);
-            if (str.isNotEmpty() && (info->vendor_id == joycon->vendor_id))
-            {
-                devices.push_back(*info);
-            }
-            info = info->next;
+            return false;
         }
 
-        hid_free_enumeration(info);
+        // Detach() and Attach() take round trips to the controller, seconds over a poor link, so they run
+        // on a controller nobody else can see; controllerLock only covers the swaps
+        Joycon* previous = nullptr;
 
-        return devices;
-    }
+        {
+            const juce::ScopedLock sl(controllerLock);
+            previous = joycon;
+            joycon = nullptr;
+            currentHidInfo = info;
+        }
 
-    bool setHidDevice(hid_device_info info)
-    {
-        auto dev = hid_open(info.vendor_id, info.product_id, nullptr);
-        bool ret = false;
+        {
+            juce::ScopedLock l(stateLock);
+            hasAttachedState = false;
+        }
 
-        if (nullptr != dev)
+        if (previous != nullptr)
         {
-            currentHidInfo = info;
+            previous->Detach();
+            delete previous;
+        }
 
-            if (joycon != nullptr)
+        auto* next = new Joycon(std::move(dev), true, true, 0.05f, (info.productId == Joycon::product_id_left) ? true : false, info.path);
+        next->SetTelemetry(&telemetry);
+        next->SetGestureEngine(&gestureEngine);
+        next->SetSettings(getControllerSettings());
+
+        {
+            juce::ScopedLock l(stateLock);
+            if (restoredState.hasCalibration && info.isSameController(restoredState.device))
             {
-                joycon->Detach();
-                delete joycon;
+                next->SetCalibration(restoredState.calibration);
             }
+        }
+
+        next->SetRealtimeConfig(realtimeConfig);
+
+        if (HidrawHub::isAvailable())
+        {
+            next->SetHub(&hidrawHub);
+        }
+        telemetry.active = true;
+
+        const bool ret = next->Attach();
+
+        if (ret)
+        {
+            juce::ScopedLock l(stateLock);
+            attachedState.device = info;
+            attachedState.calibration = next->GetCalibration();
+            hasAttachedState = true;
+        }
 
-            joycon = new Joycon(dev, true, true, 0.05f, (info.product_id == Joycon::product_id_left) ? true : false);
+        {
+            // the poll task skips a cycle rather than see the swap
+            const juce::ScopedLock sl(controllerLock);
+            joycon = next;
 
-            if (true == joycon->Attach())
+            if (ret)
             {
-                ret = true;
+                startCapture();
                 joycon->Begin();
-                startTimer(5);
             }
         }
 
+        if (ret)
+        {
+            startPolling();
+        }
+
         return ret;
     }
 
@@ -108,20 +164,299 @@ public:
         return joycon;
     }
 
-    hid_device_info* const getHidDeviceInfo(void)
+    Joycon* const getPartner(void)
+    {
+        return partner;
+    }
+
+    /*
+        Pairing mode: attaches a second controller, usually the other half,
+        and merges both into one time aligned state (see JoyconPair). The
+        first controller keeps the usual sources; the second feeds the
+        partner and relative ones. Without a first controller this attaches
+        it as the first instead.
+    */
+    bool setPartnerDevice(const HidDeviceEntry& info);
+    bool setPartnerDevice(std::unique_ptr<HidTransport> dev, const HidDeviceEntry& info);
+    void clearPartner();
+
+    bool isPaired() const
+    {
+        return paired;
+    }
+
+    const JoyconPair& getPair() const
+    {
+        return pair;
+    }
+
+    /* Runs the poll cycle, rumble timeouts and any other time-critical work off the message thread. */
+    const Scheduler& getScheduler() const
+    {
+        return *scheduler;
+    }
+
+    Telemetry& getPartnerTelemetry(void)
+    {
+        return partnerTelemetry;
+    }
+
+    const HidDeviceEntry* getHidDeviceInfo(void)
     {
         return &currentHidInfo;
     }
 
+    Telemetry& getTelemetry(void)
+    {
+        return telemetry;
+    }
+
+    /* Fed by the attached controller; offline renders push their own samples (same thread as the pushes). */
+    GestureEngine& getGestureEngine()
+    {
+        return gestureEngine;
+    }
+
+    /* Recompiles the motion -> MIDI mapping; picked up by the audio thread on its next block. */
+    void setMappings(const std::vector<Mapping>& mappings)
+    {
+        mappingEngine.setMappings(mappings);
+    }
+
+    std::vector<Mapping> getMappings() const
+    {
+        return mappingEngine.getMappings();
+    }
+
+    /* Grid for controller notes in quarter notes, 0 for off. */
+    void setQuantizeDivision(double beats)
+    {
+        quantizer.setDivision(beats);
+    }
+
+    const Quantizer& getQuantizer() const
+    {
+        return quantizer;
+    }
+
+    void setMpeSettings(const MpeSettings& s)
+    {
+        mpeOutput.setSettings(s);
+    }
+
+    MpeSettings getMpeSettings() const
+    {
+        return mpeOutput.getSettings();
+    }
+
+    /* Orientation filter and stick response for the attached controllers. Message thread. */
+    void setControllerSettings(const Joycon::Settings& s);
+    Joycon::Settings getControllerSettings() const;
+
+    /*
+        Presets: snapshots of the mappings, grid, MPE and controller settings.
+        Selecting one swaps every part lock-free, so it is safe mid-performance;
+        the preset button (a MappingSource button, -1 for none) steps through
+        them from the controller. Message thread.
+    */
+    int storePreset(const juce::String& name);
+    void selectPreset(int index);
+    juce::StringArray getPresetNames() const;
+    int getCurrentPreset() const;
+
+    void setPresetButton(int source);
+    int getPresetButton() const;
+
+    /* Streams the generated MIDI to a Standard MIDI File until stopRecording(). Message thread. */
+    bool startRecording(const juce::File& file);
+    void stopRecording();
+
+    const MidiRecorder& getRecorder() const
+    {
+        return midiRecorder;
+    }
+
+    /* Records a pipeline timeline until stopTrace(), which writes it to file as Chrome/Perfetto JSON. */
+    void startTrace(const juce::File& file);
+    bool stopTrace();
+
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JoyconGoodnessAudioProcessor)
 
     Joycon* joycon = nullptr;
-    hid_device_info currentHidInfo;
+    HidDeviceEntry currentHidInfo;
+    Joycon* partner = nullptr;
+    HidDeviceEntry partnerHidInfo;
+    Telemetry partnerTelemetry;
+    JoyconPair pair;
+    std::atomic<bool> paired { false };
+    DeviceWatcher deviceWatcher;
+    HidrawHub hidrawHub;
+    RealtimeConfig realtimeConfig;
+    bool reattachPending = false;
+    juce::File traceFile;
+    Telemetry telemetry;
+    ImuBatch imuBatch;
+    MappingEngine mappingEngine;
+    ControllerParameters controllerParameters { *this };
+    GestureEngine gestureEngine;
+    GestureNotePlayer gestureNotes;
+    Quantizer quantizer;
+    juce::MidiBuffer controllerMidi;                // audio thread, this block's controller notes before the merge
+    MpeOutput mpeOutput;
+    OscSender oscSender;
+    MidiRecorder midiRecorder;
+    juce::int64 renderedSamples = 0;                // audio thread, since prepareToPlay
+    juce::int64 lastMappedTicks = 0;                // audio thread, the newest report the mappings have seen
+    std::array<TelemetrySample, 32> recentTelemetry, recentPartnerTelemetry;
+    std::unique_ptr<CaptureWriter> capture;
+
+    juce::CriticalSection stateLock;
+    PluginState restoredState;
+
+    // under stateLock: the attached controller as getStateInformation() saves it, copied once Attach() succeeded
+    struct AttachedState
+    {
+        HidDeviceEntry device;
+        Joycon::Calibration calibration;
+    };
+
+    AttachedState attachedState;
+    bool hasAttachedState = false;
+
+    // under stateLock, hosts may save or restore from any thread
+    Joycon::Settings controllerSettings;
+    std::vector<Preset> presets;
+    int currentPreset = -1;
+    int presetButton = -1;
+    bool presetButtonDown = false;              // message thread
+
+    juce::SharedResourcePointer<Scheduler> scheduler;
+    Scheduler::TaskId pollTask = 0;
+    juce::CriticalSection controllerLock;           // held while joycon, partner or currentHidInfo are swapped; before stateLock
+
+    static constexpr double pollIntervalMs = 5.0;
+    static constexpr int parameterIntervalMs = 20;  // host automation, on the message thread
+
+    void startPolling()
+    {
+        if (pollTask == 0)
+        {
+            pollTask = scheduler->schedule(pollIntervalMs, [this] { poll(); }, pollIntervalMs);
+        }
+
+        startTimer(parameterIntervalMs);
+    }
+
+    /* Scheduler thread, every pollIntervalMs. */
+    void poll()
+    {
+        const juce::ScopedTryLock sl(controllerLock);
+        if (!sl.isLocked() || joycon == nullptr)
+        {
+            return;
+        }
+
+        // the whole fusion path: batch IMU, gestures, the sample broadcast and OSC, not just Update()
+        ScopedAllocationCheck steadyState ("poll");
+
+        imuBatch.clear();
+        joycon->Update(&imuBatch);
+        if (partner != nullptr)
+        {
+            partner->Update(&imuBatch);
+        }
+
+        imuBatch.process();
+        joycon->ApplyImuBatch(imuBatch);
+        if (partner != nullptr)
+        {
+            partner->ApplyImuBatch(imuBatch);
+        }
+
+        SourceFrame frame;
+        if (readFrame(frame))
+        {
+            oscSender.publish(frame, &gestureEngine);
+        }
+    }
 
     void timerCallback() override
     {
-        joycon->Update();
+        mappingEngine.collectGarbage();
+
+        SourceFrame frame;
+        if (readFrame(frame))
+        {
+            controllerParameters.publish(frame);
+            stepPresetOnButton(frame);
+        }
+    }
+
+    void stepPresetOnButton(const SourceFrame& frame);
+
+    /* Audio thread: runs the mappings over every report since the last block, each at its own offset. */
+    void applyMappings(juce::MidiBuffer& midi, juce::AudioBuffer<float>& audio, juce::int64 blockEndTicks);
+
+    /* The newest state, or the merged pair, for the host parameters and OSC. Message or scheduler thread. */
+    bool readFrame(SourceFrame& frame)
+    {
+        if (paired)
+        {
+            return pair.read(frame);
+        }
+
+        TelemetrySample latest;
+        if (telemetry.history.readLatest(&latest, 1) != 1)
+        {
+            return false;
+        }
+
+        frame = SourceFrame::fromTelemetry(latest);
+        return true;
+    }
+
+    void handleAsyncUpdate() override;
+
+    /* Opt-in raw report recording for GestureEngine::benchmark and replay, e.g. JOYCON_CAPTURE=/tmp/session.jcap */
+    void startCapture();
+
+    void joyconRemoved(const HidDeviceEntry& device) override
+    {
+        if (joycon != nullptr && device.isSameController(currentHidInfo))
+        {
+            reattachPending = true;
+        }
+    }
+
+    void joyconAdded(const HidDeviceEntry& device) override
+    {
+        if (partner != nullptr && partner->IsReconnecting() && device.isSameController(partnerHidInfo))
+        {
+            partnerHidInfo = device;
+            partner->ReconnectNow(device.path);
+            return;
+        }
+
+        if (reattachPending && device.isSameController(currentHidInfo))
+        {
+            reattachPending = false;
+
+            if (joycon != nullptr && joycon->IsReconnecting())
+            {
+                // the poll thread resumes with cached calibration
+                const juce::ScopedLock sl(controllerLock);
+                currentHidInfo = device;
+                joycon->ReconnectNow(device.path);
+
+                juce::ScopedLock l(stateLock);
+                attachedState.device = device;
+            }
+            else
+            {
+                setHidDevice(device);
+            }
+        }
     }
 };
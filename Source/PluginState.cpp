@@ -0,0 +1,284 @@
+#include "PluginState.h"
+
+namespace
+{
+    constexpr int magic = 0x4a434753;    // "JCGS"
+    constexpr int version = 3;          // 2: per mapping smoothing, 3: controller settings and presets
+
+    enum Flags
+    {
+        hasDevice = 1 << 0,
+        hasCalibrationData = 1 << 1,
+        hasQuantize = 1 << 2,
+        hasMpe = 1 << 3,
+        hasController = 1 << 4,
+        hasPresets = 1 << 5
+    };
+
+    void writeMappings(juce::OutputStream& out, const std::vector<Mapping>& mappings)
+    {
+        out.writeCompressedInt((int)mappings.size());
+
+        for (auto& m : mappings)
+        {
+            // curve (2 bits), destination (3 bits), invert (1 bit), smoothing follows (1 bit)
+            out.writeByte((char)m.source);
+            out.writeByte((char)((int)m.curve | ((int)m.destination << 2) | (m.invert ? 0x20 : 0) | (m.smoothing.isEnabled() ? 0x40 : 0)));
+            out.writeByte((char)m.channel);
+            out.writeShort((short)m.number);
+            out.writeFloat(m.inMin);
+            out.writeFloat(m.inMax);
+            out.writeFloat(m.curveAmount);
+            out.writeFloat(m.outMin);
+            out.writeFloat(m.outMax);
+
+            if (m.smoothing.isEnabled())
+            {
+                out.writeFloat(m.smoothing.minCutoff);
+                out.writeFloat(m.smoothing.beta);
+                out.writeFloat(m.smoothing.derivativeCutoff);
+            }
+        }
+    }
+
+    bool readMappings(juce::InputStream& in, std::vector<Mapping>& mappings)
+    {
+        const auto numMappings = in.readCompressedInt();
+
+        // at least 25 bytes per mapping
+        if (numMappings < 0 || (juce::int64)numMappings * 25 > in.getNumBytesRemaining())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < numMappings; ++i)
+        {
+            Mapping m;
+            m.source = (juce::uint8)in.readByte();
+
+            const auto packed = (int)(juce::uint8)in.readByte();
+            m.curve = (MappingCurve)(packed & 0x3);
+            m.destination = (MappingDestination)juce::jmin((packed >> 2) & 0x7, (int)MappingDestination::audio);
+            m.invert = (packed & 0x20) != 0;
+
+            m.channel = (juce::uint8)in.readByte();
+            m.number = (juce::uint16)in.readShort();
+            m.inMin = in.readFloat();
+            m.inMax = in.readFloat();
+            m.curveAmount = in.readFloat();
+            m.outMin = in.readFloat();
+            m.outMax = in.readFloat();
+
+            if ((packed & 0x40) != 0)
+            {
+                m.smoothing.minCutoff = in.readFloat();
+                m.smoothing.beta = in.readFloat();
+                m.smoothing.derivativeCutoff = in.readFloat();
+            }
+
+            mappings.push_back(m);
+        }
+
+        return true;
+    }
+
+    void writeMpe(juce::OutputStream& out, const MpeSettings& mpe)
+    {
+        out.writeByte((char)mpe.memberChannels);
+        out.writeByte((char)mpe.bendSource);
+        out.writeByte((char)mpe.pressureSource);
+        out.writeByte((char)mpe.slideSource);
+        out.writeFloat(mpe.bendSemitones);
+        out.writeFloat(mpe.bendRange);
+        out.writeShort((short)mpe.bendThreshold);
+    }
+
+    void readMpe(juce::InputStream& in, MpeSettings& mpe)
+    {
+        mpe.memberChannels = juce::jlimit(1, 15, (int)in.readByte());
+        mpe.bendSource = (int)in.readByte();
+        mpe.pressureSource = (int)in.readByte();
+        mpe.slideSource = (int)in.readByte();
+        mpe.bendSemitones = in.readFloat();
+        mpe.bendRange = in.readFloat();
+        mpe.bendThreshold = (int)in.readShort();
+    }
+
+    void writeController(juce::OutputStream& out, const Joycon::Settings& c)
+    {
+        out.writeFloat(c.alpha);
+        out.writeFloat(c.stick.deadzoneScale);
+        out.writeFloat(c.stick.outerRing);
+        out.writeFloat(c.stick.curve);
+    }
+
+    void readController(juce::InputStream& in, Joycon::Settings& c)
+    {
+        c.alpha = juce::jlimit(0.f, 1.f, in.readFloat());
+        c.stick.deadzoneScale = in.readFloat();
+        c.stick.outerRing = in.readFloat();
+        c.stick.curve = in.readFloat();
+    }
+}
+
+void PluginState::writeTo(juce::MemoryBlock& dest) const
+{
+    juce::MemoryOutputStream out(dest, false);
+
+    out.writeInt(magic);
+    out.writeByte((char)version);
+    out.writeByte((char)((device.path.isNotEmpty() ? hasDevice : 0) | (hasCalibration ? hasCalibrationData : 0)
+                         | (quantizeDivision > 0 ? hasQuantize : 0) | (mpe.enabled ? hasMpe : 0)
+                         | hasController | (presets.empty() ? 0 : hasPresets)));
+
+    writeMappings(out, mappings);
+
+    if (device.path.isNotEmpty())
+    {
+        out.writeString(device.path);
+        out.writeString(device.product);
+        out.writeString(device.serial);
+        out.writeShort((short)device.vendorId);
+        out.writeShort((short)device.productId);
+    }
+
+    if (hasCalibration)
+    {
+        for (auto v : calibration.stick)
+        {
+            out.writeShort((short)v);
+        }
+
+        out.writeShort((short)calibration.deadzone);
+        out.writeShort(calibration.gyroNeutral.x);
+        out.writeShort(calibration.gyroNeutral.y);
+        out.writeShort(calibration.gyroNeutral.z);
+    }
+
+    if (quantizeDivision > 0)
+    {
+        out.writeDouble(quantizeDivision);
+    }
+
+    if (mpe.enabled)
+    {
+        writeMpe(out, mpe);
+    }
+
+    writeController(out, controller);
+
+    if (!presets.empty())
+    {
+        out.writeCompressedInt((int)presets.size());
+
+        for (auto& p : presets)
+        {
+            out.writeString(p.name);
+            writeMappings(out, p.mappings);
+            out.writeDouble(p.quantizeDivision);
+            out.writeBool(p.mpe.enabled);
+            writeMpe(out, p.mpe);
+            writeController(out, p.controller);
+        }
+
+        out.writeCompressedInt(currentPreset + 1);
+        out.writeCompressedInt(presetButton + 1);
+    }
+}
+
+bool PluginState::readFrom(const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream in(data, (size_t)juce::jmax(0, sizeInBytes), false);
+
+    if (sizeInBytes < 6 || in.readInt() != magic || in.readByte() > version)
+    {
+        return false;
+    }
+
+    const auto flags = (int)in.readByte();
+
+    PluginState s;
+
+    if (!readMappings(in, s.mappings))
+    {
+        return false;
+    }
+
+    if ((flags & hasDevice) != 0)
+    {
+        s.device.path = in.readString();
+        s.device.product = in.readString();
+        s.device.serial = in.readString();
+        s.device.vendorId = (juce::uint16)in.readShort();
+        s.device.productId = (juce::uint16)in.readShort();
+    }
+
+    if ((flags & hasCalibrationData) != 0)
+    {
+        for (auto& v : s.calibration.stick)
+        {
+            v = (juce::uint16)in.readShort();
+        }
+
+        s.calibration.deadzone = (juce::uint16)in.readShort();
+        s.calibration.gyroNeutral.x = in.readShort();
+        s.calibration.gyroNeutral.y = in.readShort();
+        s.calibration.gyroNeutral.z = in.readShort();
+        s.hasCalibration = true;
+    }
+
+    if ((flags & hasQuantize) != 0)
+    {
+        s.quantizeDivision = juce::jlimit(0.0, 4.0, in.readDouble());
+    }
+
+    if ((flags & hasMpe) != 0)
+    {
+        s.mpe.enabled = true;
+        readMpe(in, s.mpe);
+    }
+
+    if ((flags & hasController) != 0)
+    {
+        readController(in, s.controller);
+    }
+
+    if ((flags & hasPresets) != 0)
+    {
+        const auto numPresets = in.readCompressedInt();
+
+        if (numPresets < 0 || numPresets > in.getNumBytesRemaining())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < numPresets; ++i)
+        {
+            Preset p;
+            p.name = in.readString();
+
+            if (!readMappings(in, p.mappings))
+            {
+                return false;
+            }
+
+            p.quantizeDivision = juce::jlimit(0.0, 4.0, in.readDouble());
+            p.mpe.enabled = in.readBool();
+            readMpe(in, p.mpe);
+            readController(in, p.controller);
+
+            s.presets.push_back(std::move(p));
+        }
+
+        s.currentPreset = juce::jlimit(-1, numPresets - 1, in.readCompressedInt() - 1);
+        s.presetButton = in.readCompressedInt() - 1;
+
+        if (!MappingSource::isButton(s.presetButton))
+        {
+            s.presetButton = -1;
+        }
+    }
+
+    *this = std::move(s);
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "MappingMatrix.h"
+#include "DeviceWatcher.h"
+#include "joycon.hpp"
+#include "MpeOutput.h"
+
+/*
+    A named set of everything that shapes the output: mappings, the grid,
+    MPE and the controller's filter and stick response. Applying one swaps
+    each part through its own lock-free handoff, so presets can change
+    mid-performance without the audio or poll threads waiting.
+*/
+struct Preset
+{
+    juce::String name;
+    std::vector<Mapping> mappings;
+    double quantizeDivision = 0;
+    MpeSettings mpe;
+    Joycon::Settings controller;
+};
+
+/*
+    Everything a session needs to come back as it was: the mapping matrix and
+    the controller it was using, including that controller's calibration, so a
+    restored session reattaches without re-reading the SPI flash.
+
+    Stored as a small versioned binary blob rather than XML; a typical session
+    is well under a hundred bytes plus 25 per mapping (37 with smoothing).
+*/
+struct PluginState
+{
+    std::vector<Mapping> mappings;
+
+    HidDeviceEntry device;              // empty when no controller was attached
+    Joycon::Calibration calibration;
+    bool hasCalibration = false;
+
+    double quantizeDivision = 0;        // quarter notes, 0 when off
+    MpeSettings mpe;
+    Joycon::Settings controller;
+
+    std::vector<Preset> presets;
+    int currentPreset = -1;             // -1 when the live settings aren't a stored preset
+    int presetButton = -1;              // MappingSource button that steps through the presets, -1 for none
+
+    void writeTo(juce::MemoryBlock& dest) const;
+
+    /* Returns false, leaving this untouched, if the data isn't a state we understand. */
+    bool readFrom(const void* data, int sizeInBytes);
+};
@@ -0,0 +1,187 @@
+#include "Quantizer.h"
+#include "Trace.h"
+
+//==============================================================================
+bool EventScheduler::push(juce::int64 time, const juce::uint8* data, int size)
+{
+    if (count == capacity)
+    {
+        return false;
+    }
+
+    auto& e = events[(size_t)count++];
+    e.time = time;
+    e.order = nextOrder++;
+    e.size = (juce::uint8)juce::jlimit(0, 3, size);
+    std::copy(data, data + e.size, e.data.begin());
+
+    std::push_heap(events.begin(), events.begin() + count, later);
+    return true;
+}
+
+void EventScheduler::popUntil(juce::int64 end, juce::int64 blockStart, juce::MidiBuffer& midi)
+{
+    while (count > 0 && events[0].time < end)
+    {
+        std::pop_heap(events.begin(), events.begin() + count, later);
+
+        const auto& e = events[(size_t)--count];
+        const auto offset = (int)juce::jlimit<juce::int64>(0, end - blockStart - 1, e.time - blockStart);
+        midi.addEvent(e.data.data(), e.size, offset);
+    }
+}
+
+void EventScheduler::flush(juce::MidiBuffer& midi)
+{
+    while (count > 0)
+    {
+        std::pop_heap(events.begin(), events.begin() + count, later);
+
+        const auto& e = events[(size_t)--count];
+        midi.addEvent(e.data.data(), e.size, 0);
+    }
+}
+
+//==============================================================================
+void Quantizer::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    scratch.ensureSize((size_t)juce::jmax(256, maximumBlockSize) * 3);
+}
+
+void Quantizer::schedule(juce::int64 time, const juce::MidiMessageMetadata& m, int offset)
+{
+    if (!scheduler.push(time, m.data, m.numBytes))
+    {
+        numDropped.fetch_add(1, std::memory_order_relaxed);
+        scratch.addEvent(m.data, m.numBytes, offset);
+    }
+}
+
+void Quantizer::recordNote(double errorMs, double delayMs)
+{
+    // single writer, so plain load / store is enough
+    numNotes.store(numNotes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sumError.store(sumError.load(std::memory_order_relaxed) + errorMs, std::memory_order_relaxed);
+    sumAbsError.store(sumAbsError.load(std::memory_order_relaxed) + std::abs(errorMs), std::memory_order_relaxed);
+    sumDelay.store(sumDelay.load(std::memory_order_relaxed) + delayMs, std::memory_order_relaxed);
+
+    if (std::abs(errorMs) > maxAbsError.load(std::memory_order_relaxed))
+    {
+        maxAbsError.store(std::abs(errorMs), std::memory_order_relaxed);
+    }
+}
+
+void Quantizer::process(juce::MidiBuffer& midi, int numSamples, juce::AudioPlayHead* playHead)
+{
+    JOYCON_TRACE_SCOPE("Quantizer::process");
+
+    if (resetPending.exchange(false))
+    {
+        numNotes = 0;
+        sumError = 0.0;
+        sumAbsError = 0.0;
+        maxAbsError = 0.0;
+        sumDelay = 0.0;
+        numDropped = 0;
+    }
+
+    const auto blockStart = sampleClock;
+    sampleClock += numSamples;
+
+    const auto grid = division.load(std::memory_order_relaxed);
+
+    juce::Optional<juce::AudioPlayHead::PositionInfo> position;
+    if (playHead != nullptr && grid > 0.0)
+    {
+        position = playHead->getPosition();
+    }
+
+    const auto bpm = position ? position->getBpm() : juce::Optional<double>();
+    const auto ppq = position ? position->getPpqPosition() : juce::Optional<double>();
+
+    if (!position || !position->getIsPlaying() || !bpm || !ppq || *bpm <= 0.0)
+    {
+        // nothing to sync to: release whatever is still waiting, before this block's events
+        if (scheduler.size() > 0)
+        {
+            scratch.clear();
+            scheduler.flush(scratch);
+
+            for (const auto m : midi)
+            {
+                scratch.addEvent(m.data, m.numBytes, m.samplePosition);
+            }
+
+            midi.swapWith(scratch);
+        }
+
+        for (auto& channel : noteDelay)
+        {
+            channel.fill(0);
+        }
+
+        return;
+    }
+
+    const auto samplesPerBeat = sampleRate * 60.0 / *bpm;
+    const auto msPerBeat = 60000.0 / *bpm;
+
+    scratch.clear();
+
+    for (const auto m : midi)
+    {
+        const auto status = m.numBytes == 3 ? (m.data[0] & 0xf0) : 0;
+        const auto channel = (size_t)(m.data[0] & 0x0f);
+        const auto note = m.numBytes == 3 ? (size_t)(m.data[1] & 0x7f) : 0;
+        const auto now = blockStart + m.samplePosition;
+
+        if (status == 0x90 && m.data[2] > 0)
+        {
+            const auto beat = *ppq + m.samplePosition / samplesPerBeat;
+            const auto steps = beat / grid;
+            const auto phase = steps - std::floor(steps);
+
+            const auto error = (steps - std::round(steps)) * grid * msPerBeat;
+            const auto delayBeats = phase <= lateWindow ? 0.0 : (std::ceil(steps) - steps) * grid;
+            const auto delay = (juce::int32)std::llround(delayBeats * samplesPerBeat);
+
+            noteDelay[channel][note] = delay;
+            recordNote(error, delayBeats * msPerBeat);
+            schedule(now + delay, m, m.samplePosition);
+        }
+        else if (status == 0x80 || status == 0x90)
+        {
+            schedule(now + noteDelay[channel][note], m, m.samplePosition);
+        }
+        else
+        {
+            scratch.addEvent(m.data, m.numBytes, m.samplePosition);
+        }
+    }
+
+    scheduler.popUntil(blockStart + numSamples, blockStart, scratch);
+    midi.swapWith(scratch);
+}
+
+Quantizer::Stats Quantizer::getStats() const
+{
+    Stats s;
+    s.notes = numNotes.load(std::memory_order_relaxed);
+    s.dropped = numDropped.load(std::memory_order_relaxed);
+
+    if (s.notes > 0)
+    {
+        s.meanErrorMs = sumError.load(std::memory_order_relaxed) / s.notes;
+        s.meanAbsErrorMs = sumAbsError.load(std::memory_order_relaxed) / s.notes;
+        s.maxAbsErrorMs = maxAbsError.load(std::memory_order_relaxed);
+        s.meanDelayMs = sumDelay.load(std::memory_order_relaxed) / s.notes;
+    }
+
+    return s;
+}
+
+void Quantizer::resetStats()
+{
+    resetPending = true;
+}
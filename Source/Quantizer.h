@@ -0,0 +1,111 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    Fixed capacity queue of short MIDI messages keyed by an absolute sample
+    time. A binary heap over preallocated storage, ties broken by insertion
+    order so a note off queued before a retrigger still comes first.
+*/
+class EventScheduler
+{
+public:
+    static constexpr int capacity = 256;
+
+    /* Returns false when full. */
+    bool push(juce::int64 time, const juce::uint8* data, int size);
+
+    /* Moves every event due before end into midi, at its offset from blockStart (clamped to the block). */
+    void popUntil(juce::int64 end, juce::int64 blockStart, juce::MidiBuffer& midi);
+
+    /* Moves everything into midi at offset 0, e.g. when the transport stops. */
+    void flush(juce::MidiBuffer& midi);
+
+    int size() const
+    {
+        return count;
+    }
+
+private:
+    struct Event
+    {
+        juce::int64 time = 0;
+        juce::uint32 order = 0;
+        std::array<juce::uint8, 3> data {};
+        juce::uint8 size = 0;
+    };
+
+    static bool later(const Event& a, const Event& b)
+    {
+        return a.time != b.time ? a.time > b.time : a.order > b.order;
+    }
+
+    std::array<Event, capacity> events;
+    int count = 0;
+    juce::uint32 nextOrder = 0;
+};
+
+/*
+    Moves controller note events onto the host's beat grid. Each note on is
+    delayed to the next grid line (or played at once if it is only slightly
+    past one); its note off keeps the same delay, so note lengths survive.
+    Everything else, and all notes while the transport is stopped or the
+    grid is off, passes straight through. Audio thread only, apart from
+    setDivision() and getStats().
+*/
+class Quantizer
+{
+public:
+    /* Late tolerance as a fraction of the division: a note this close after a line is not pushed a whole step. */
+    static constexpr double lateWindow = 0.1;
+
+    struct Stats
+    {
+        juce::uint32 notes = 0;         // note ons measured against the grid
+        double meanErrorMs = 0;         // signed distance to the nearest line, negative = early
+        double meanAbsErrorMs = 0;
+        double maxAbsErrorMs = 0;
+        double meanDelayMs = 0;         // added by quantizing
+        juce::uint32 dropped = 0;       // passed through unquantized because the scheduler was full
+    };
+
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    /* Grid in quarter notes, e.g. 0.25 for sixteenths; 0 turns quantizing off. */
+    void setDivision(double beats)
+    {
+        division.store(beats, std::memory_order_relaxed);
+    }
+
+    double getDivision() const
+    {
+        return division.load(std::memory_order_relaxed);
+    }
+
+    void process(juce::MidiBuffer& midi, int numSamples, juce::AudioPlayHead* playHead);
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    double sampleRate = 44100.0;
+    std::atomic<double> division { 0.0 };
+
+    EventScheduler scheduler;
+    juce::MidiBuffer scratch;
+    juce::int64 sampleClock = 0;
+
+    // delay applied to the last note on of each channel / note, reused by its note off
+    std::array<std::array<juce::int32, 128>, 16> noteDelay {};
+
+    std::atomic<juce::uint32> numNotes { 0 };
+    std::atomic<double> sumError { 0.0 };
+    std::atomic<double> sumAbsError { 0.0 };
+    std::atomic<double> maxAbsError { 0.0 };
+    std::atomic<double> sumDelay { 0.0 };
+    std::atomic<juce::uint32> numDropped { 0 };
+    std::atomic<bool> resetPending { false };
+
+    void schedule(juce::int64 time, const juce::MidiMessageMetadata& m, int offset);
+    void recordNote(double errorMs, double delayMs);
+};
@@ -0,0 +1,577 @@
+/*
+    joycon-regress: golden-output regression runs of the plugin's processBlock.
+
+    Renders one fixed controller performance (synthetic, or decoded from a
+    capture) through JoyconGoodnessAudioProcessor offline, at every block
+    size and sample rate asked for, and compares the MIDI of each run with a
+    golden file recorded earlier, within a timing tolerance. Every
+    processBlock is also timed against the real-time budget of its block;
+    with --budget an overrun fails the run, otherwise the times are only
+    reported, as wall-clock times on a shared machine are too noisy to gate
+    on. Exits non-zero on a mismatch, so changes to the pipeline can't
+    silently change what it plays. Built with JOYCON_COUNT_ALLOCATIONS, a
+    processBlock that allocates fails its run too.
+
+    The processor runs non-realtime, so its clock is the samples rendered
+    (see processBlock); telemetry and IMU samples are stamped on that clock
+    and handed over before the block they arrive in, as the controller
+    threads would.
+*/
+
+#include "JuceHeader.h"
+#include "PluginProcessor.h"
+#include "Capture.h"
+#include "StickShaper.h"
+#include "AllocationCounter.h"
+#include "ToolStats.h"
+
+#include <iostream>
+
+namespace
+{
+    const char* usage =
+        "usage: joycon-regress --golden=<dir> [options]\n"
+        "\n"
+        "  --golden=<dir>           golden files, one per performance, sample rate and block size\n"
+        "  --update                 record the golden files instead of comparing against them\n"
+        "  --replay=<a.jcap>        perform a capture (default: the synthetic performance)\n"
+        "  --seconds=<n>            length of the synthetic performance (default 20)\n"
+        "  --state=<file>           plugin state to load first: mappings, grid, MPE, presets\n"
+        "  --blocks=<n,...>         block sizes (default 16,32,64,128,256,512,1024,2048,4096)\n"
+        "  --rates=<hz,...>         sample rates (default 44100,48000,96000)\n"
+        "  --tolerance-ms=<ms>      how far an event may move from its golden time (default 1)\n"
+        "  --value-tolerance=<n>    how far a controller, pressure or pitch bend value may move (default 0)\n"
+        "  --budget=<fraction>      fail when the 99th percentile block takes more than this\n"
+        "                           fraction of its real-time budget, e.g. 0.5 (default: report only)\n";
+
+    constexpr double reportIntervalMs = 15.0;       // telemetry, one per 0x30 report
+    constexpr double imuIntervalMs = 5.0;           // three IMU samples per report
+
+    /* Controller input on the render clock, in arrival order. */
+    struct Performance
+    {
+        juce::String name;
+        std::vector<TelemetrySample> frames;        // deviceMs is the arrival time
+        std::vector<ImuSample> imu;
+        double lengthMs = 0;
+    };
+
+    juce::int64 msToTicks(double ms)
+    {
+        return juce::Time::secondsToHighResolutionTicks(ms * 0.001);
+    }
+
+    /*
+        A slow tilt on all three axes, the stick circling for two seconds in
+        every four, the first shoulder button held for 300 ms every two
+        seconds and a shake every eight, with a little seeded noise on top.
+    */
+    Performance simulate(double seconds)
+    {
+        Performance p;
+        p.name = "simulated";
+        p.lengthMs = seconds * 1000.0;
+
+        juce::Random noise(1);
+        const auto unitsPerDegree = 4.4f / 90.f;
+        TelemetrySample t;
+
+        for (int i = 0; (double)i * imuIntervalMs < p.lengthMs; ++i)
+        {
+            const auto ms = (double)(i + 1) * imuIntervalMs;
+            const auto s = ms * 0.001;
+            const auto tau = juce::MathConstants<double>::twoPi;
+
+            const auto pitch = (float)(2.2 + 2.0 * std::sin(tau * 0.2 * s));
+            const auto roll = (float)(3.5 * std::sin(tau * 0.13 * s + 1.0));
+            const auto yaw = (float)(3.0 * std::sin(tau * 0.05 * s));
+
+            ImuSample imu;
+            imu.timeMs = ms;
+            imu.acc = { 0.f, 0.f, 1.f };
+            imu.gyr = { (float)(2.0 * tau * 0.2 * std::cos(tau * 0.2 * s)) / unitsPerDegree,
+                        (float)(3.5 * tau * 0.13 * std::cos(tau * 0.13 * s + 1.0)) / unitsPerDegree,
+                        (float)(3.0 * tau * 0.05 * std::cos(tau * 0.05 * s)) / unitsPerDegree };
+
+            const auto inCycle = std::fmod(s, 8.0);
+            if (inCycle >= 6.0 && inCycle < 6.4)
+            {
+                imu.acc.x += (float)(2.5 * std::sin(tau * 12.0 * s));
+                imu.gyr.z += (float)(400.0 * std::sin(tau * 6.0 * s));
+            }
+
+            imu.acc.x += (noise.nextFloat() - 0.5f) * 0.02f;
+            imu.acc.y += (noise.nextFloat() - 0.5f) * 0.02f;
+            imu.acc.z += (noise.nextFloat() - 0.5f) * 0.02f;
+            imu.gyr.x += (noise.nextFloat() - 0.5f) * 2.f;
+            imu.gyr.y += (noise.nextFloat() - 0.5f) * 2.f;
+            imu.gyr.z += (noise.nextFloat() - 0.5f) * 2.f;
+
+            p.imu.push_back(imu);
+
+            if ((i + 1) % 3 != 0)
+            {
+                continue;
+            }
+
+            t.ticks = msToTicks(ms);
+            t.deviceMs = ms;
+            t.pitchRollYaw[0] = pitch;
+            t.pitchRollYaw[1] = roll;
+            t.pitchRollYaw[2] = yaw;
+            t.acc[0] = imu.acc.x;
+            t.acc[1] = imu.acc.y;
+            t.acc[2] = imu.acc.z;
+            t.gyr[0] = imu.gyr.x;
+            t.gyr[1] = imu.gyr.y;
+            t.gyr[2] = imu.gyr.z;
+
+            const auto circling = std::fmod(s, 4.0) < 2.0;
+            t.stick[0] = circling ? (float)(0.8 * std::cos(tau * 0.5 * s)) : 0.f;
+            t.stick[1] = circling ? (float)(0.8 * std::sin(tau * 0.5 * s)) : 0.f;
+            t.buttons = std::fmod(s, 2.0) < 0.3 ? 1u << Joycon::SHOULDER_1 : 0u;
+
+            p.frames.push_back(t);
+        }
+
+        return p;
+    }
+
+    /*
+        A capture decoded the way the controller pipeline sees it: calibrated
+        IMU samples for the gestures, the orientation filter through
+        ImuBatch::processScalar() (as OneEuroBank::benchmark does), and the
+        stick and buttons of each report, all from CaptureImuStream. Times
+        start at the first report.
+    */
+    Performance replay(const juce::File& file)
+    {
+        Performance p;
+        p.name = file.getFileNameWithoutExtension();
+
+        CaptureImuStream stream;
+        if (!stream.read(file) || stream.getNumReports() == 0)
+        {
+            return p;
+        }
+
+        const auto& header = stream.header;
+        const auto neutral = stream.getGyroNeutral();
+
+        StickShaper stick;
+        stick.configure(header.stickCalibration, header.deadzone, StickResponse());
+
+        ImuBatch batch;
+        const double firstMs = stream.reportMs.front() - reportIntervalMs;
+
+        for (int report = 0; report < stream.getNumReports(); ++report)
+        {
+            const auto* data = stream.reports[(size_t)report].data();
+            const auto ms = stream.reportMs[(size_t)report] - firstMs;
+            batch.clear();
+
+            for (int n = 0; n < CaptureImuStream::samplesPerReport; ++n)
+            {
+                auto imu = Joycon::DecodeIMUSample(data, (size_t)n, neutral, header.isLeft, ms);
+                imu.timeMs = juce::jmax(0.0, imu.timeMs);
+                p.imu.push_back(imu);
+
+                const auto i = (size_t)(report * CaptureImuStream::samplesPerReport + n);
+                batch.add(stream.acc[i], stream.gyr[i], neutral, header.isLeft, 0.05f, stream.dtSec[i], ms);
+            }
+
+            batch.processScalar();
+
+            const auto lane = batch.size() - 1;
+            const auto o = batch.getOrientation(lane);
+            const auto a = batch.getAccel(lane);
+            const auto g = batch.getGyro(lane);
+            const auto raw = Joycon::DecodeStick(data, header.isLeft);
+            const auto xy = stick.process(raw[0], raw[1]);
+
+            TelemetrySample t;
+            t.ticks = msToTicks(ms);
+            t.deviceMs = ms;
+            t.pitchRollYaw[0] = o.x;
+            t.pitchRollYaw[1] = o.y;
+            t.pitchRollYaw[2] = o.z;
+            t.acc[0] = a.x;
+            t.acc[1] = a.y;
+            t.acc[2] = a.z;
+            t.gyr[0] = g.x;
+            t.gyr[1] = g.y;
+            t.gyr[2] = g.z;
+            t.stick[0] = xy[0];
+            t.stick[1] = xy[1];
+            t.buttons = Joycon::DecodeButtons(data, header.isLeft);
+
+            p.frames.push_back(t);
+            p.lengthMs = ms;
+        }
+
+        return p;
+    }
+
+    /* 120 bpm 4/4 from sample 0, for the quantizer. */
+    class RenderPlayHead : public juce::AudioPlayHead
+    {
+    public:
+        static constexpr double bpm = 120.0;
+
+        explicit RenderPlayHead(double rate)
+            : sampleRate(rate)
+        {
+        }
+
+        void setSamplePosition(juce::int64 s)
+        {
+            samples = s;
+        }
+
+        juce::Optional<PositionInfo> getPosition() const override
+        {
+            PositionInfo info;
+            info.setIsPlaying(true);
+            info.setBpm(bpm);
+            info.setTimeInSamples(samples);
+            info.setPpqPosition((double)samples / sampleRate * bpm / 60.0);
+            return info;
+        }
+
+    private:
+        const double sampleRate;
+        juce::int64 samples = 0;
+    };
+
+    struct Event
+    {
+        double ms = 0;
+        std::vector<juce::uint8> bytes;
+    };
+
+    struct Render
+    {
+        std::vector<Event> events;
+        std::vector<double> load;                   // per block: processing time over the block's duration
+        juce::uint64 allocatingBlocks = 0;          // with JOYCON_COUNT_ALLOCATIONS
+    };
+
+    Render render(const Performance& performance, double sampleRate, int blockSize, const juce::MemoryBlock& state)
+    {
+        Render r;
+
+        JoyconGoodnessAudioProcessor processor;
+        if (state.getSize() > 0)
+        {
+            processor.setStateInformation(state.getData(), (int)state.getSize());
+        }
+
+        RenderPlayHead playHead(sampleRate);
+        processor.setPlayHead(&playHead);
+        processor.setNonRealtime(true);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        auto& telemetry = processor.getTelemetry();
+        telemetry.active = true;
+
+        juce::AudioBuffer<float> audio(2, blockSize);
+        juce::MidiBuffer midi;
+        midi.ensureSize(4096);
+
+        const auto numSamples = (juce::int64)std::ceil(performance.lengthMs * 0.001 * sampleRate);
+        const auto blockSeconds = (double)blockSize / sampleRate;
+        size_t nextFrame = 0, nextImu = 0;
+
+        r.load.reserve((size_t)(numSamples / blockSize + 1));
+        AllocationCounter::resetViolations();
+
+        for (juce::int64 position = 0; position < numSamples; position += blockSize)
+        {
+            // everything that arrived by the end of the block, as a live block would see it
+            const auto endMs = (double)(position + blockSize) * 1000.0 / sampleRate;
+
+            while (nextImu < performance.imu.size() && performance.imu[nextImu].timeMs <= endMs)
+            {
+                processor.getGestureEngine().push(performance.imu[nextImu++]);
+            }
+
+            while (nextFrame < performance.frames.size() && performance.frames[nextFrame].deviceMs <= endMs)
+            {
+                telemetry.history.push(performance.frames[nextFrame++]);
+            }
+
+            playHead.setSamplePosition(position);
+            audio.clear();
+            midi.clear();
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock(audio, midi);
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+            r.load.push_back(elapsed / blockSeconds);
+
+            for (const auto m : midi)
+            {
+                r.events.push_back({ (double)(position + m.samplePosition) * 1000.0 / sampleRate,
+                                     std::vector<juce::uint8>(m.data, m.data + m.numBytes) });
+            }
+        }
+
+        r.allocatingBlocks = AllocationCounter::getNumViolations();
+
+        processor.releaseResources();
+        processor.setPlayHead(nullptr);
+        return r;
+    }
+
+    //==============================================================================
+    /* One event per line: time in ms, then the message bytes in hex. */
+    bool writeGolden(const juce::File& file, const juce::String& title, const std::vector<Event>& events)
+    {
+        juce::String text;
+        text << "# " << title << "\n";
+
+        for (auto& e : events)
+        {
+            text << juce::String(e.ms, 3);
+            for (auto b : e.bytes)
+            {
+                text << " " << juce::String::toHexString((int)b).paddedLeft('0', 2);
+            }
+            text << "\n";
+        }
+
+        file.getParentDirectory().createDirectory();
+        return file.replaceWithText(text);
+    }
+
+    bool readGolden(const juce::File& file, std::vector<Event>& events)
+    {
+        if (!file.existsAsFile())
+        {
+            return false;
+        }
+
+        juce::StringArray lines;
+        lines.addLines(file.loadFileAsString());
+
+        for (auto& line : lines)
+        {
+            if (line.startsWithChar('#') || line.trim().isEmpty())
+            {
+                continue;
+            }
+
+            auto tokens = juce::StringArray::fromTokens(line, " ", {});
+
+            Event e;
+            e.ms = tokens[0].getDoubleValue();
+            for (int i = 1; i < tokens.size(); ++i)
+            {
+                e.bytes.push_back((juce::uint8)tokens[i].getHexValue32());
+            }
+
+            events.push_back(e);
+        }
+
+        return true;
+    }
+
+    /* How far apart the values of two otherwise identical messages are, or -1 if they differ in anything else. */
+    int valueDistance(const std::vector<juce::uint8>& a, const std::vector<juce::uint8>& b)
+    {
+        if (a.size() != b.size() || a.empty() || a[0] != b[0])
+        {
+            return -1;
+        }
+
+        const auto status = a[0] & 0xf0;
+
+        if (a.size() == 3 && status == 0xe0)
+        {
+            return std::abs((a[1] | (a[2] << 7)) - (b[1] | (b[2] << 7)));
+        }
+
+        // controllers and poly pressure keep their number; the last byte is the value
+        const auto valueByte = (status == 0xb0 || status == 0xa0 || status == 0xd0) ? (int)a.size() - 1 : (int)a.size();
+
+        for (int i = 1; i < valueByte; ++i)
+        {
+            if (a[(size_t)i] != b[(size_t)i])
+            {
+                return -1;
+            }
+        }
+
+        return valueByte < (int)a.size() ? std::abs(a[(size_t)valueByte] - b[(size_t)valueByte]) : 0;
+    }
+
+    juce::String toString(const Event& e)
+    {
+        juce::String s = juce::String(e.ms, 3) + " ms:";
+        for (auto b : e.bytes)
+        {
+            s << " " << juce::String::toHexString((int)b).paddedLeft('0', 2);
+        }
+        return s;
+    }
+
+    /* Empty if the rendered events match the golden ones, in order; otherwise what differs first. */
+    juce::String compare(const std::vector<Event>& golden, const std::vector<Event>& rendered, double toleranceMs, int valueTolerance)
+    {
+        const auto n = juce::jmin(golden.size(), rendered.size());
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto distance = valueDistance(golden[i].bytes, rendered[i].bytes);
+            const auto late = std::abs(rendered[i].ms - golden[i].ms);
+
+            if (distance < 0 || distance > valueTolerance || late > toleranceMs + 1.0e-6)
+            {
+                return "event " + juce::String((int)i) + " is " + toString(rendered[i]) + ", golden " + toString(golden[i]);
+            }
+        }
+
+        if (golden.size() != rendered.size())
+        {
+            return juce::String((int)rendered.size()) + " events, golden " + juce::String((int)golden.size());
+        }
+
+        return {};
+    }
+
+    std::vector<int> parseList(const juce::String& spec, std::vector<int> defaults)
+    {
+        if (spec.isEmpty())
+        {
+            return defaults;
+        }
+
+        std::vector<int> values;
+        for (auto& token : juce::StringArray::fromTokens(spec, ",", {}))
+        {
+            if (token.getIntValue() > 0)
+            {
+                values.push_back(token.getIntValue());
+            }
+        }
+
+        return values;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || !args.containsOption("--golden"))
+    {
+        std::cout << usage;
+        return args.containsOption("--help|-h") ? 0 : 2;
+    }
+
+    juce::ScopedJuceInitialiser_GUI scopedJuce;
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto goldenDir = cwd.getChildFile(args.getValueForOption("--golden"));
+    const auto update = args.containsOption("--update");
+
+    Performance performance;
+    if (args.containsOption("--replay"))
+    {
+        performance = replay(cwd.getChildFile(args.getValueForOption("--replay")));
+        if (performance.frames.empty())
+        {
+            std::cerr << "no 0x30 reports in " << args.getValueForOption("--replay") << std::endl;
+            return 2;
+        }
+    }
+    else
+    {
+        const auto seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 20.0;
+        performance = simulate(juce::jmax(1.0, seconds));
+    }
+
+    juce::MemoryBlock state;
+    if (args.containsOption("--state"))
+    {
+        const auto stateFile = cwd.getChildFile(args.getValueForOption("--state"));
+        if (!stateFile.loadFileAsData(state))
+        {
+            std::cerr << "can't read " << stateFile.getFullPathName() << std::endl;
+            return 2;
+        }
+
+        performance.name << "-" << stateFile.getFileNameWithoutExtension();
+    }
+
+    const auto blocks = parseList(args.getValueForOption("--blocks"), { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 });
+    const auto rates = parseList(args.getValueForOption("--rates"), { 44100, 48000, 96000 });
+    const auto toleranceMs = args.containsOption("--tolerance-ms") ? args.getValueForOption("--tolerance-ms").getDoubleValue() : 1.0;
+    const auto valueTolerance = args.getValueForOption("--value-tolerance").getIntValue();
+    const auto budget = args.containsOption("--budget") ? args.getValueForOption("--budget").getDoubleValue() : 0.0;
+
+    int failures = 0;
+
+    for (auto rate : rates)
+    {
+        for (auto block : blocks)
+        {
+            const auto title = performance.name + ", " + juce::String(rate) + " Hz, " + juce::String(block) + " samples per block";
+            const auto golden = goldenDir.getChildFile(performance.name + "-" + juce::String(rate) + "-" + juce::String(block) + ".txt");
+            const auto result = render(performance, (double)rate, block, state);
+
+            const auto p50 = percentile(result.load, 0.5);
+            const auto p99 = percentile(result.load, 0.99);
+            const auto max = percentile(result.load, 1.0);
+
+            juce::String verdict;
+
+            if (update)
+            {
+                verdict = writeGolden(golden, title, result.events) ? "recorded" : "can't write " + golden.getFullPathName();
+                failures += verdict == "recorded" ? 0 : 1;
+            }
+            else
+            {
+                std::vector<Event> expected;
+                if (!readGolden(golden, expected))
+                {
+                    verdict = "no golden file, record one with --update";
+                    ++failures;
+                }
+                else
+                {
+                    const auto difference = compare(expected, result.events, toleranceMs, valueTolerance);
+                    verdict = difference.isEmpty() ? "matches" : "DIFFERS: " + difference;
+                    failures += difference.isEmpty() ? 0 : 1;
+                }
+            }
+
+            if (budget > 0 && p99 > budget)
+            {
+                verdict << ", OVER BUDGET";
+                ++failures;
+            }
+
+            if (result.allocatingBlocks > 0)
+            {
+                verdict << ", ALLOCATED in " << (int)result.allocatingBlocks << " blocks (last in " << AllocationCounter::getLastViolation() << ")";
+                ++failures;
+            }
+
+            std::cout << title << ": " << (int)result.events.size() << " events, " << verdict
+                      << "; block cpu p50 " << juce::String(p50 * 100.0, 2) << "% p99 " << juce::String(p99 * 100.0, 2)
+                      << "% max " << juce::String(max * 100.0, 2) << "% of real time" << std::endl;
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cout << failures << " of " << (int)(rates.size() * blocks.size()) << " runs failed" << std::endl;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
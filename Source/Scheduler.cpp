@@ -0,0 +1,335 @@
+#include "Scheduler.h"
+
+namespace
+{
+    // further off than this the thread waits on the condition variable, closer it sleeps to the exact deadline
+    constexpr auto coarseMargin = std::chrono::milliseconds(2);
+
+    std::chrono::steady_clock::duration fromMs(double ms)
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(juce::jmax(0.0, ms)));
+    }
+}
+
+Scheduler::Scheduler() : juce::Thread("scheduler")
+{
+    wheel.fill(-1);
+
+    for (int i = 0; i < maxTasks; ++i)
+    {
+        tasks[(size_t)i].next = i + 1 < maxTasks ? i + 1 : -1;
+    }
+
+    freeList = 0;
+    cursorMs = toSlotMs(Clock::now());
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        signalThreadShouldExit();
+    }
+
+    wake.notify_all();
+    stopThread(1000);
+}
+
+Scheduler::TaskId Scheduler::schedule(double delayMs, std::function<void()> task, double periodMs)
+{
+    if (task == nullptr)
+    {
+        return 0;
+    }
+
+    TaskId id = 0;
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        if (freeList < 0)
+        {
+            return 0;
+        }
+
+        const auto index = freeList;
+        auto& t = tasks[(size_t)index];
+        freeList = t.next;
+
+        t.function = std::move(task);
+        t.due = Clock::now() + fromMs(delayMs);
+        t.period = periodMs > 0.0 ? fromMs(periodMs) : Clock::duration(0);
+        t.scheduled = true;
+
+        if (++t.generation >= (1u << 24))
+        {
+            t.generation = 1;
+        }
+
+        link(index);
+        ++numTasks;
+
+        id = t.generation * (TaskId)maxTasks + (TaskId)index;
+    }
+
+    wake.notify_one();
+
+    if (!isThreadRunning())
+    {
+        startThread(juce::Thread::Priority::highest);
+    }
+
+    return id;
+}
+
+void Scheduler::cancel(TaskId id)
+{
+    const auto index = (int)(id % (TaskId)maxTasks);
+    const auto generation = id / (TaskId)maxTasks;
+    std::function<void()> released;
+
+    {
+        std::unique_lock<std::mutex> l(lock);
+        auto& t = tasks[(size_t)index];
+
+        if (id == 0 || t.generation != generation || (!t.scheduled && !t.running))
+        {
+            return;
+        }
+
+        if (t.scheduled)
+        {
+            unlink(index);
+            t.scheduled = false;
+        }
+
+        if (t.running)
+        {
+            // a task later in the batch than the one cancelling it must not start; the scheduler thread
+            // releases it after its turn
+            t.cancelled = true;
+
+            if (juce::Thread::getCurrentThreadId() != getThreadId())
+            {
+                idle.wait(l, [&t] { return !t.running; });
+            }
+
+            return;
+        }
+
+        released = std::move(t.function);
+        t.function = nullptr;
+        t.next = freeList;
+        freeList = index;
+        --numTasks;
+    }
+}
+
+int Scheduler::getNumTasks() const
+{
+    std::lock_guard<std::mutex> l(lock);
+    return numTasks;
+}
+
+//==============================================================================
+juce::int64 Scheduler::toSlotMs(Clock::time_point t)
+{
+    return (juce::int64)std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+void Scheduler::link(int index)
+{
+    auto& head = wheel[(size_t)(toSlotMs(tasks[(size_t)index].due) % wheelSlots)];
+    tasks[(size_t)index].next = head;
+    head = index;
+}
+
+void Scheduler::unlink(int index)
+{
+    auto* i = &wheel[(size_t)(toSlotMs(tasks[(size_t)index].due) % wheelSlots)];
+
+    while (*i >= 0 && *i != index)
+    {
+        i = &tasks[(size_t)*i].next;
+    }
+
+    if (*i == index)
+    {
+        *i = tasks[(size_t)index].next;
+    }
+
+    tasks[(size_t)index].next = -1;
+}
+
+Scheduler::Clock::time_point Scheduler::nextDeadline(Clock::time_point now) const
+{
+    const auto nowMs = toSlotMs(now);
+
+    // the first slot holding a task that is overdue or due within a turn of the wheel
+    for (auto ms = juce::jmax(cursorMs, nowMs - wheelSlots + 1); ms <= nowMs + wheelSlots; ++ms)
+    {
+        auto earliest = Clock::time_point::max();
+
+        for (auto i = wheel[(size_t)(ms % wheelSlots)]; i >= 0; i = tasks[(size_t)i].next)
+        {
+            if (toSlotMs(tasks[(size_t)i].due) <= ms)
+            {
+                earliest = juce::jmin(earliest, tasks[(size_t)i].due);
+            }
+        }
+
+        if (earliest != Clock::time_point::max())
+        {
+            return earliest;
+        }
+    }
+
+    // nothing that close: the task pool is small enough to look through
+    auto earliest = Clock::time_point::max();
+
+    for (auto& t : tasks)
+    {
+        if (t.scheduled)
+        {
+            earliest = juce::jmin(earliest, t.due);
+        }
+    }
+
+    return juce::jmin(earliest, now + std::chrono::seconds(1));
+}
+
+int Scheduler::collectDue(Clock::time_point now, std::array<int, maxTasks>& due)
+{
+    const auto nowMs = toSlotMs(now);
+    int num = 0;
+
+    // the current slot is swept again next time, it may hold tasks due later this millisecond
+    for (auto ms = juce::jmax(cursorMs, nowMs - wheelSlots + 1); ms <= nowMs; ++ms)
+    {
+        auto i = wheel[(size_t)(ms % wheelSlots)];
+
+        while (i >= 0)
+        {
+            auto& t = tasks[(size_t)i];
+            const auto next = t.next;
+
+            if (t.due <= now)
+            {
+                unlink(i);
+                t.running = true;
+                t.scheduled = false;
+                due[(size_t)num++] = i;
+            }
+
+            i = next;
+        }
+    }
+
+    cursorMs = nowMs;
+    return num;
+}
+
+void Scheduler::run()
+{
+    std::array<int, maxTasks> due;
+    std::array<Clock::time_point, maxTasks> deadlines;
+
+    realtimeApplied = applyToCurrentThread(rtConfig).ok();
+
+    while (!threadShouldExit())
+    {
+        Clock::time_point deadline;
+
+        {
+            std::unique_lock<std::mutex> l(lock);
+
+            if (threadShouldExit())
+            {
+                break;
+            }
+
+            deadline = nextDeadline(Clock::now());
+
+            // woken early by schedule(), or close enough for the exact sleep; look again either way
+            if (deadline - Clock::now() > coarseMargin)
+            {
+                wake.wait_until(l, deadline - coarseMargin);
+                continue;
+            }
+        }
+
+        sleepUntil(deadline);
+
+        int num = 0;
+
+        {
+            std::lock_guard<std::mutex> l(lock);
+            const auto now = Clock::now();
+            num = collectDue(now, due);
+
+            for (int k = 0; k < num; ++k)
+            {
+                auto& t = tasks[(size_t)due[(size_t)k]];
+                deadlines[(size_t)k] = t.due;
+
+                // periodic tasks go back in before they run, so cancel() finds them; missed periods are skipped
+                if (t.period > Clock::duration(0))
+                {
+                    t.due += t.period;
+                    if (t.due <= now)
+                    {
+                        t.due += t.period * ((now - t.due) / t.period + 1);
+                    }
+
+                    link(due[(size_t)k]);
+                    t.scheduled = true;
+                }
+            }
+        }
+
+        for (int k = 0; k < num; ++k)
+        {
+            const auto index = due[(size_t)k];
+            auto& t = tasks[(size_t)index];
+            bool cancelled;
+
+            {
+                std::lock_guard<std::mutex> l(lock);
+                cancelled = t.cancelled;
+            }
+
+            if (!cancelled)
+            {
+                const auto lateMs = std::chrono::duration<double, std::milli>(Clock::now() - deadlines[(size_t)k]).count();
+                lateness.record(lateMs);
+                if (lateMs > maxLatenessMs.load(std::memory_order_relaxed))
+                {
+                    maxLatenessMs.store(lateMs, std::memory_order_relaxed);
+                }
+                numRuns.fetch_add(1, std::memory_order_relaxed);
+
+                // safe without the lock: a running task is neither freed nor reused
+                t.function();
+            }
+
+            std::function<void()> released;
+
+            {
+                std::lock_guard<std::mutex> l(lock);
+                t.running = false;
+                t.cancelled = false;
+
+                if (!t.scheduled)
+                {
+                    released = std::move(t.function);
+                    t.function = nullptr;
+                    t.next = freeList;
+                    freeList = index;
+                    --numTasks;
+                }
+            }
+
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Telemetry.h"
+#include "ThreadTuning.h"
+
+/*
+    One thread for all time-critical periodic and one-shot work (the poll
+    cycle, rumble timeouts, metric sampling) instead of juce::Timers, which
+    run on the message thread and stall whenever the GUI is busy.
+
+    Deadlines are on the monotonic clock (std::chrono::steady_clock) and kept
+    in a hashed timer wheel of 1 ms slots, so scheduling and cancelling are
+    O(1) and finding the next deadline looks at a few slots. The thread
+    sleeps on a condition variable until a deadline is within a couple of
+    milliseconds, then to the exact deadline. How late each task started is
+    recorded in getLateness().
+
+    Process wide: share one through juce::SharedResourcePointer<Scheduler>.
+*/
+class Scheduler : private juce::Thread
+{
+public:
+    using TaskId = juce::uint32;                // 0 is never a valid task
+
+    static constexpr int maxTasks = 256;
+    static constexpr int wheelSlots = 256;      // 1 ms each
+
+    Scheduler();
+    ~Scheduler() override;
+
+    /*
+        Any thread. Runs task on the scheduler thread after delayMs, then every
+        periodMs if that is > 0; a periodic task that falls behind skips the
+        runs it missed rather than bunching them up. Tasks must be short, they
+        delay everything due after them. Allocates; returns 0 if full.
+    */
+    TaskId schedule(double delayMs, std::function<void()> task, double periodMs = 0.0);
+
+    /*
+        Any thread. Once this returns the task will not run again; a run in
+        progress on the scheduler thread is waited for, unless the task is
+        cancelling itself.
+    */
+    void cancel(TaskId id);
+
+    /* Applied when the scheduler thread starts, i.e. on the first schedule(). */
+    void setRealtimeConfig(const RealtimeConfig& c)
+    {
+        rtConfig = c;
+    }
+
+    /* False once the thread has started without the permissions the config asked for. */
+    bool isRealtimeConfigApplied() const
+    {
+        return realtimeApplied.load(std::memory_order_relaxed);
+    }
+
+    /* Start time minus deadline of every run, in 0.1 ms bins. */
+    const LatencyHistogram& getLateness() const
+    {
+        return lateness;
+    }
+
+    double getMaxLatenessMs() const
+    {
+        return maxLatenessMs.load(std::memory_order_relaxed);
+    }
+
+    juce::uint64 getNumRuns() const
+    {
+        return numRuns.load(std::memory_order_relaxed);
+    }
+
+    int getNumTasks() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Task
+    {
+        std::function<void()> function;
+        Clock::time_point due;
+        Clock::duration period { 0 };
+        juce::uint32 generation = 0;
+        int next = -1;                          // in its wheel slot, or the free list
+        bool scheduled = false;
+        bool running = false;                   // collected for the current batch, from then until it has run
+        bool cancelled = false;                 // cancelled while running; skipped if it hasn't started yet
+    };
+
+    void run() override;
+
+    static juce::int64 toSlotMs(Clock::time_point t);
+    void link(int index);
+    void unlink(int index);
+    Clock::time_point nextDeadline(Clock::time_point now) const;
+    int collectDue(Clock::time_point now, std::array<int, maxTasks>& due);
+
+    mutable std::mutex lock;
+    std::condition_variable wake;               // the scheduler thread, for a new or earlier deadline
+    std::condition_variable idle;               // cancel(), for a run to finish
+
+    std::array<Task, maxTasks> tasks;
+    std::array<int, wheelSlots> wheel;
+    int freeList = -1;
+    int numTasks = 0;
+    juce::int64 cursorMs = 0;                   // first slot not yet swept
+
+    RealtimeConfig rtConfig;
+    std::atomic<bool> realtimeApplied { true };
+
+    LatencyHistogram lateness { 0.1 };
+    std::atomic<double> maxLatenessMs { 0.0 };
+    std::atomic<juce::uint64> numRuns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Scheduler)
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON && defined (__aarch64__)
+ #include <arm_neon.h>
+#endif
+
+#include <cmath>
+
+/*
+    Four wide float operations for the structure-of-arrays kernels (ImuBatch,
+    OneEuroBank). Kernels are templates over the ops, so the same code runs
+    on SSE, NEON, or one lane at a time for the tail and the reference path.
+*/
+struct ScalarOps
+{
+    using V = float;
+    using M = bool;
+    static constexpr int width = 1;
+
+    static V load(const float* p)           { return *p; }
+    static void store(float* p, V v)        { *p = v; }
+    static V set(float f)                   { return f; }
+    static V add(V a, V b)                  { return a + b; }
+    static V sub(V a, V b)                  { return a - b; }
+    static V mul(V a, V b)                  { return a * b; }
+    static V div(V a, V b)                  { return a / b; }
+    static V sqrt(V a)                      { return std::sqrt(a); }
+    static V min(V a, V b)                  { return a < b ? a : b; }
+    static V max(V a, V b)                  { return a > b ? a : b; }
+    static V abs(V a)                       { return std::abs(a); }
+    static V copySign(V mag, V s)           { return std::copysign(mag, s); }
+    static M greater(V a, V b)              { return a > b; }
+    static V select(M m, V a, V b)          { return m ? a : b; }
+};
+
+#if JUCE_USE_SSE_INTRINSICS
+struct SimdOps
+{
+    using V = __m128;
+    using M = __m128;
+    static constexpr int width = 4;
+
+    static V load(const float* p)           { return _mm_loadu_ps(p); }
+    static void store(float* p, V v)        { _mm_storeu_ps(p, v); }
+    static V set(float f)                   { return _mm_set1_ps(f); }
+    static V add(V a, V b)                  { return _mm_add_ps(a, b); }
+    static V sub(V a, V b)                  { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b)                  { return _mm_mul_ps(a, b); }
+    static V div(V a, V b)                  { return _mm_div_ps(a, b); }
+    static V sqrt(V a)                      { return _mm_sqrt_ps(a); }
+    static V min(V a, V b)                  { return _mm_min_ps(a, b); }
+    static V max(V a, V b)                  { return _mm_max_ps(a, b); }
+    static V abs(V a)                       { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static V copySign(V mag, V s)           { auto m = _mm_set1_ps(-0.0f); return _mm_or_ps(_mm_andnot_ps(m, mag), _mm_and_ps(m, s)); }
+    static M greater(V a, V b)              { return _mm_cmpgt_ps(a, b); }
+    static V select(M m, V a, V b)          { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#elif JUCE_USE_ARM_NEON && defined (__aarch64__)
+struct SimdOps
+{
+    using V = float32x4_t;
+    using M = uint32x4_t;
+    static constexpr int width = 4;
+
+    static V load(const float* p)           { return vld1q_f32(p); }
+    static void store(float* p, V v)        { vst1q_f32(p, v); }
+    static V set(float f)                   { return vdupq_n_f32(f); }
+    static V add(V a, V b)                  { return vaddq_f32(a, b); }
+    static V sub(V a, V b)                  { return vsubq_f32(a, b); }
+    static V mul(V a, V b)                  { return vmulq_f32(a, b); }
+    static V div(V a, V b)                  { return vdivq_f32(a, b); }
+    static V sqrt(V a)                      { return vsqrtq_f32(a); }
+    static V min(V a, V b)                  { return vminq_f32(a, b); }
+    static V max(V a, V b)                  { return vmaxq_f32(a, b); }
+    static V abs(V a)                       { return vabsq_f32(a); }
+    static V copySign(V mag, V s)           { return vbslq_f32(vdupq_n_u32(0x80000000u), s, mag); }
+    static M greater(V a, V b)              { return vcgtq_f32(a, b); }
+    static V select(M m, V a, V b)          { return vbslq_f32(m, a, b); }
+};
+#else
+using SimdOps = ScalarOps;
+#endif
@@ -0,0 +1,457 @@
+#include "SimulatedTransport.h"
+
+#if JUCE_LINUX
+ #include <poll.h>
+ #include <sys/timerfd.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int reportLength = 49;
+
+    juce::int64 msToTicks(double ms)
+    {
+        return (juce::int64)(ms * 0.001 * (double)juce::Time::getHighResolutionTicksPerSecond());
+    }
+
+    /* Waits until ticks or for at most timeoutMs (< 0 for no limit). Returns true if ticks was reached. */
+    bool waitUntil(juce::int64 ticks, int timeoutMs)
+    {
+        auto now = juce::Time::getHighResolutionTicks();
+
+        if (now >= ticks)
+        {
+            return true;
+        }
+
+        if (timeoutMs == 0)
+        {
+            return false;
+        }
+
+        auto waitMs = juce::Time::highResolutionTicksToSeconds(ticks - now) * 1000.0;
+        if (timeoutMs > 0)
+        {
+            waitMs = juce::jmin(waitMs, (double)timeoutMs);
+        }
+
+        juce::Thread::sleep(juce::jmax(1, (int)std::ceil(waitMs)));
+        return juce::Time::getHighResolutionTicks() >= ticks;
+    }
+
+    /* Two 12 bit values packed the way the SPI flash and the reports store them. */
+    void pack12(uint8_t* dest, int x, int y)
+    {
+        dest[0] = (uint8_t)(x & 0xff);
+        dest[1] = (uint8_t)(((x >> 8) & 0x0f) | ((y & 0x0f) << 4));
+        dest[2] = (uint8_t)((y >> 4) & 0xff);
+    }
+
+    void put16(uint8_t* dest, double v)
+    {
+        const auto i = (int16_t)juce::jlimit(-32768.0, 32767.0, std::round(v));
+        dest[0] = (uint8_t)(i & 0xff);
+        dest[1] = (uint8_t)((i >> 8) & 0xff);
+    }
+
+    /* Fills a 0x21 reply acknowledging subcommand sc. */
+    void acknowledge(std::array<uint8_t, 64>& reply, uint8_t timer, uint8_t sc)
+    {
+        reply.fill(0);
+        reply[0] = 0x21;
+        reply[1] = timer;
+        reply[2] = 0x8e;
+        reply[13] = 0x80;
+        reply[14] = sc;
+    }
+}
+
+//==============================================================================
+SimulatedTransport::SimulatedTransport(bool isLeft, int seed)
+    : left(isLeft), phase(seed * 1.7), noise(0x4a43 + seed), link(0x6c6b + seed)
+{
+    startTicks = juce::Time::getHighResolutionTicks();
+    nextReportTicks = startTicks;
+}
+
+SimulatedTransport::~SimulatedTransport()
+{
+   #if JUCE_LINUX
+    if (timerFd >= 0)
+    {
+        ::close(timerFd);
+    }
+   #endif
+}
+
+bool SimulatedTransport::enableDescriptor()
+{
+   #if JUCE_LINUX
+    if (timerFd < 0)
+    {
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        if (timerFd < 0)
+        {
+            return false;
+        }
+
+        const auto intervalNs = (long)(reportIntervalMs * 1.0e6);
+
+        itimerspec spec {};
+        spec.it_interval.tv_nsec = intervalNs;
+        spec.it_value.tv_nsec = intervalNs;
+        timerfd_settime(timerFd, 0, &spec, nullptr);
+    }
+
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+/* Descriptor mode: true if a report is due, waiting up to timeoutMs (< 0 for no limit) for one. */
+bool SimulatedTransport::takeTimerExpiry(int timeoutMs)
+{
+   #if JUCE_LINUX
+    if (due == 0)
+    {
+        juce::uint64 expirations = 0;
+
+        if (::read(timerFd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations) && timeoutMs != 0)
+        {
+            pollfd p { timerFd, POLLIN, 0 };
+
+            if (poll(&p, 1, timeoutMs) > 0)
+            {
+                (void)::read(timerFd, &expirations, sizeof(expirations));
+            }
+        }
+
+        // fell far behind (more than ~100 ms): don't burst to catch up
+        due = expirations > 6 ? 1 : expirations;
+    }
+
+    if (due == 0)
+    {
+        return false;
+    }
+
+    --due;
+    return true;
+   #else
+    (void)timeoutMs;
+    return false;
+   #endif
+}
+
+void SimulatedTransport::readSpi(int address, int length, uint8_t* dest) const
+{
+    std::fill(dest, dest + length, (uint8_t)0xff);
+
+    switch (address)
+    {
+        case 0x603d:    // factory stick calibration, left: max above, centre, min below
+        case 0x6046:    // right: centre, min below, max above
+        {
+            const int centreAt = address == 0x603d ? 3 : 0;
+
+            for (int i = 0; i < 9; i += 3)
+            {
+                if (i == centreAt)
+                {
+                    pack12(dest + i, 0x800, 0x800);
+                }
+                else
+                {
+                    pack12(dest + i, 0x5a0, 0x5a0);
+                }
+            }
+            break;
+        }
+
+        case 0x6086:    // stick parameters, deadzone in bytes 3-4
+        case 0x6098:
+            std::fill(dest, dest + length, (uint8_t)0);
+            dest[3] = 0xae;
+            break;
+
+        case 0x8034:    // user IMU calibration, gyro neutral first
+            std::fill(dest, dest + length, (uint8_t)0);
+            put16(dest + 0, gyroNeutral[0]);
+            put16(dest + 2, gyroNeutral[1]);
+            put16(dest + 4, gyroNeutral[2]);
+            break;
+
+        case 0x6029:
+            std::fill(dest, dest + length, (uint8_t)0);
+            break;
+
+        default:        // e.g. user stick calibration: erased flash
+            break;
+    }
+}
+
+int SimulatedTransport::write(const uint8_t* data, size_t len)
+{
+    if (len > 15 && data[0] == 0x01)
+    {
+        const auto sc = data[10];
+        acknowledge(reply, timer, sc);
+
+        if (sc == 0x10)
+        {
+            const auto address = data[11] | (data[12] << 8);
+            const auto length = juce::jlimit(0, 64 - 20, (int)data[15]);
+
+            reply[13] = 0x90;
+            reply[15] = data[11];
+            reply[16] = data[12];
+            reply[19] = (uint8_t)length;
+            readSpi(address, length, reply.data() + 20);
+        }
+
+        replyPending = true;
+    }
+
+    // rumble (0x10) is accepted and ignored
+    return (int)len;
+}
+
+void SimulatedTransport::fillReport(uint8_t* r)
+{
+    std::fill(r, r + reportLength, (uint8_t)0);
+
+    const auto t = (double)numReports * reportIntervalMs * 0.001;
+    const auto twoPi = juce::MathConstants<double>::twoPi;
+
+    timer = (uint8_t)(timer + 3);
+
+    r[0] = 0x30;
+    r[1] = timer;
+    r[2] = 0x8e;
+
+    // DPAD_DOWN held for 200 ms every 2 s
+    if (std::fmod(t + phase, 2.0) < 0.2)
+    {
+        r[3 + (left ? 2 : 0)] |= left ? 0x01 : 0x04;
+    }
+
+    const auto stickAngle = twoPi * 0.25 * t + phase;
+    pack12(r + (left ? 6 : 9), 0x800 + (int)(1100 * std::cos(stickAngle)), 0x800 + (int)(1100 * std::sin(stickAngle)));
+
+    for (int n = 0; n < 3; ++n)
+    {
+        const auto ts = t - (2 - n) * 0.005;
+
+        // slow tilt, degrees, and its rate of change
+        const auto roll = 40.0 * std::sin(twoPi * 0.2 * ts + phase);
+        const auto pitch = 25.0 * std::sin(twoPi * 0.13 * ts + phase);
+        const auto rollRate = 40.0 * twoPi * 0.2 * std::cos(twoPi * 0.2 * ts + phase);
+        const auto pitchRate = 25.0 * twoPi * 0.13 * std::cos(twoPi * 0.13 * ts + phase);
+
+        const auto a = juce::degreesToRadians(roll);
+        const auto b = juce::degreesToRadians(pitch);
+
+        double acc[3] = { std::sin(b), std::sin(a) * std::cos(b), std::cos(a) * std::cos(b) };
+        const double gyr[3] = { rollRate, pitchRate, 0.0 };
+
+        // 400 ms shake every 8 s
+        if (std::fmod(ts + phase, 8.0) < 0.4)
+        {
+            acc[0] += 2.0 * std::sin(twoPi * 5.0 * ts);
+        }
+
+        auto* sample = r + 13 + n * 12;
+
+        // about 5 mg and 0.5 deg/s of noise
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            put16(sample + axis * 2, acc[axis] / 0.000244 + (noise.nextDouble() - 0.5) * 40.0);
+            put16(sample + 6 + axis * 2, gyr[axis] / 0.070 + gyroNeutral[axis] + (noise.nextDouble() - 0.5) * 14.0);
+        }
+    }
+
+    ++numReports;
+}
+
+int SimulatedTransport::read(uint8_t* data, size_t len, int timeoutMs)
+{
+    if (replyPending)
+    {
+        std::copy(reply.begin(), reply.begin() + juce::jmin(len, reply.size()), data);
+        replyPending = false;
+        return (int)juce::jmin(len, reply.size());
+    }
+
+    std::array<uint8_t, 64> report {};
+
+    // the end of a stall: what was held back goes out back to back, oldest first
+    if (owed > 0 && stallLeft == 0)
+    {
+        --owed;
+        fillReport(report.data());
+
+        const auto n = juce::jmin(len, (size_t)reportLength);
+        std::copy(report.begin(), report.begin() + n, data);
+        return (int)n;
+    }
+
+    if (timerFd >= 0)
+    {
+        if (!takeTimerExpiry(timeoutMs))
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        if (!waitUntil(nextReportTicks, timeoutMs))
+        {
+            return 0;
+        }
+
+        const auto interval = msToTicks(reportIntervalMs);
+        nextReportTicks += interval;
+
+        // fell far behind (e.g. the reader was paused): don't burst to catch up
+        const auto now = juce::Time::getHighResolutionTicks();
+        if (now - nextReportTicks > msToTicks(100.0))
+        {
+            nextReportTicks = now + interval;
+        }
+    }
+
+    if (impairment.lossRate > 0.f && link.nextFloat() < impairment.lossRate)
+    {
+        // the controller sent it, so its timer still moves on
+        fillReport(report.data());
+        ++linkStats.lost;
+        return 0;
+    }
+
+    if (stallLeft == 0 && impairment.stallRate > 0.f && link.nextFloat() < impairment.stallRate)
+    {
+        stallLeft = 1 + link.nextInt(juce::jmax(1, impairment.maxStallReports));
+        ++linkStats.stalls;
+    }
+
+    if (stallLeft > 0)
+    {
+        --stallLeft;
+        ++owed;
+        ++linkStats.held;
+        return 0;
+    }
+
+    fillReport(report.data());
+
+    const auto n = juce::jmin(len, (size_t)reportLength);
+    std::copy(report.begin(), report.begin() + n, data);
+    return (int)n;
+}
+
+SimulatedTransport::LinkImpairment SimulatedTransport::LinkImpairment::fromString(const juce::String& s)
+{
+    LinkImpairment i;
+
+    for (auto& token : juce::StringArray::fromTokens(s, ",", {}))
+    {
+        const auto key = token.upToFirstOccurrenceOf("=", false, false).trim();
+        const auto value = token.fromFirstOccurrenceOf("=", false, false).trim();
+
+        if (key == "loss")
+        {
+            i.lossRate = juce::jlimit(0.f, 1.f, value.getFloatValue());
+        }
+        else if (key == "stall")
+        {
+            i.stallRate = juce::jlimit(0.f, 1.f, value.getFloatValue());
+        }
+        else if (key == "burst")
+        {
+            i.maxStallReports = juce::jmax(1, value.getIntValue());
+        }
+    }
+
+    return i;
+}
+
+//==============================================================================
+ReplayTransport::ReplayTransport(const juce::File& capture, bool playInRealTime, bool loopCapture)
+    : reader(capture), realTime(playInRealTime), loop(loopCapture)
+{
+    startTicks = juce::Time::getHighResolutionTicks();
+    haveNext = loadNext();
+    finished = !haveNext;
+}
+
+bool ReplayTransport::loadNext()
+{
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        double ms = 0;
+
+        if (reader.next(ms, next, nextLength))
+        {
+            if (firstMs < 0)
+            {
+                firstMs = ms;
+            }
+
+            nextMs = ms + loopOffsetMs;
+            lastMs = nextMs;
+            return true;
+        }
+
+        if (!loop || firstMs < 0)
+        {
+            return false;
+        }
+
+        // continue one report interval after the end
+        loopOffsetMs = lastMs + SimulatedTransport::reportIntervalMs - firstMs;
+        reader.rewind();
+    }
+
+    return false;
+}
+
+int ReplayTransport::write(const uint8_t* data, size_t len)
+{
+    if (len > 10 && data[0] == 0x01)
+    {
+        acknowledge(reply, 0, data[10]);
+        replyPending = true;
+    }
+
+    return (int)len;
+}
+
+int ReplayTransport::read(uint8_t* data, size_t len, int timeoutMs)
+{
+    if (replyPending)
+    {
+        std::copy(reply.begin(), reply.begin() + juce::jmin(len, reply.size()), data);
+        replyPending = false;
+        return (int)juce::jmin(len, reply.size());
+    }
+
+    if (!haveNext)
+    {
+        finished = true;
+        return 0;
+    }
+
+    if (realTime && !waitUntil(startTicks + msToTicks(nextMs - firstMs), timeoutMs))
+    {
+        return 0;
+    }
+
+    const auto n = juce::jmin((int)len, nextLength);
+    std::copy(next.begin(), next.begin() + n, data);
+
+    haveNext = loadNext();
+    return n;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "HidTransport.h"
+#include "Capture.h"
+
+/*
+    Stand-in controllers behind the HidTransport interface, so the whole
+    Joycon pipeline (poll thread, queue, decode, filters) runs without
+    hardware: for the console tool, soak tests and CI.
+*/
+
+/*
+    A synthetic Joy-Con. Answers subcommands like the real thing (including
+    SPI reads of a plausible factory calibration) and produces 0x30 reports
+    every 15 ms: a slow tilt on roll and pitch, the stick circling, a button
+    press every two seconds and a short shake every eight, with sensor noise
+    of roughly a real Joy-Con's size on top.
+*/
+class SimulatedTransport : public HidTransport
+{
+public:
+    explicit SimulatedTransport(bool isLeft, int seed = 0);
+    ~SimulatedTransport() override;
+
+    int write(const uint8_t* data, size_t len) override;
+    int read(uint8_t* data, size_t len, int timeoutMs) override;
+
+    /*
+        Paces the reports with a timer descriptor that is readable whenever one
+        is due, as a hidraw node is, so a HidrawHub can service the controller.
+        Before the reader starts. Linux only; returns false elsewhere.
+    */
+    bool enableDescriptor();
+
+    int getFd() const override
+    {
+        return timerFd;
+    }
+
+    static constexpr double reportIntervalMs = 15.0;
+
+    /*
+        A poor Bluetooth link: reports lost outright, and stalls where the
+        reports due are held back and then arrive back to back, as a busy
+        radio delivers them. Off by default.
+    */
+    struct LinkImpairment
+    {
+        float lossRate = 0.f;           // fraction of reports never delivered
+        float stallRate = 0.f;          // chance that a report starts a stall
+        int maxStallReports = 8;        // a stall holds back 1..this many reports
+
+        /* e.g. "loss=0.02,stall=0.05,burst=8"; missing keys keep their defaults. */
+        static LinkImpairment fromString(const juce::String& s);
+    };
+
+    /* Before the reader starts. */
+    void setImpairment(const LinkImpairment& i)
+    {
+        impairment = i;
+    }
+
+    struct LinkStats
+    {
+        std::atomic<juce::uint32> lost { 0 };
+        std::atomic<juce::uint32> stalls { 0 };
+        std::atomic<juce::uint32> held { 0 };   // reports delivered late, in a burst
+    };
+
+    const LinkStats& getLinkStats() const
+    {
+        return linkStats;
+    }
+
+    /* Gyro bias the simulated SPI flash reports, in raw units. */
+    static constexpr int16_t gyroNeutral[3] = { 5, -3, 2 };
+
+private:
+    void fillReport(uint8_t* r);
+    bool takeTimerExpiry(int timeoutMs);
+    void readSpi(int address, int length, uint8_t* dest) const;
+
+    const bool left;
+    const double phase;
+    juce::Random noise;
+
+    std::array<uint8_t, 64> reply {};
+    bool replyPending = false;
+
+    juce::int64 startTicks = 0;
+    juce::int64 nextReportTicks = 0;
+    juce::int64 numReports = 0;
+    uint8_t timer = 0;
+
+    int timerFd = -1;
+    juce::uint64 due = 0;               // timer expirations not yet delivered as reports
+
+    LinkImpairment impairment;
+    juce::Random link;
+    int stallLeft = 0;                  // reports still to hold back
+    int owed = 0;                       // held back, delivered as soon as the stall ends
+    LinkStats linkStats;
+
+    JUCE_DECLARE_NON_COPYABLE (SimulatedTransport)
+};
+
+/*
+    Plays back a capture (see Capture.h) at its recorded pace, or as fast as
+    the reader drains it. Subcommands are acknowledged but carry no data, so
+    give the Joycon the capture's calibration with SetCalibration() first.
+*/
+class ReplayTransport : public HidTransport
+{
+public:
+    ReplayTransport(const juce::File& capture, bool realTime, bool loop);
+
+    bool openedOk() const
+    {
+        return reader.openedOk();
+    }
+
+    const CaptureHeader& getHeader() const
+    {
+        return reader.getHeader();
+    }
+
+    /* True once the capture has been played through and looping is off. */
+    bool isFinished() const
+    {
+        return finished.load();
+    }
+
+    int write(const uint8_t* data, size_t len) override;
+    int read(uint8_t* data, size_t len, int timeoutMs) override;
+
+private:
+    bool loadNext();
+
+    CaptureReader reader;
+    const bool realTime;
+    const bool loop;
+
+    std::array<uint8_t, CaptureReader::maxReportLength> next {};
+    int nextLength = 0;
+    double nextMs = 0;
+    bool haveNext = false;
+
+    double firstMs = -1;
+    double loopOffsetMs = 0;
+    double lastMs = 0;
+    juce::int64 startTicks = 0;
+
+    std::array<uint8_t, 64> reply {};
+    bool replyPending = false;
+    std::atomic<bool> finished { false };
+
+    JUCE_DECLARE_NON_COPYABLE (ReplayTransport)
+};
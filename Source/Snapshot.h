@@ -0,0 +1,193 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    Configuration that realtime threads read while other threads replace it.
+    Each value is an immutable snapshot: publish() builds a new one and swaps
+    a pointer, so a reader sees either the old settings or the new ones,
+    never half of each, and never waits, locks or allocates.
+
+    Reclamation is deferred RCU style. Each Reader owns a slot it stamps with
+    the current epoch while it holds a snapshot; publishing retires the old
+    snapshot under the next epoch, and collectGarbage() (any non-realtime
+    thread, publish() runs it too) frees what no slot stamped before that
+    epoch can still be looking at.
+*/
+template <typename T>
+class SnapshotCell
+{
+public:
+    static constexpr int maxReaders = 16;
+
+    explicit SnapshotCell(T initial = T())
+        : owned(new Node { std::move(initial), 1 })
+    {
+        current.store(owned.get());
+    }
+
+    ~SnapshotCell()
+    {
+        jassert(claimed.load() == 0);   // readers must go first
+    }
+
+    /* Any non-realtime thread. Allocates. */
+    void publish(T value)
+    {
+        const juce::ScopedLock l(writeLock);
+
+        std::unique_ptr<const Node> next(new Node { std::move(value), owned->version + 1 });
+        current.store(next.get());
+
+        // a reader stamped with an earlier epoch may still hold the old one
+        retired.push_back({ epoch.fetch_add(1) + 1, std::move(owned) });
+        owned = std::move(next);
+
+        collectGarbageLocked();
+    }
+
+    /* Any non-realtime thread: a copy of the latest snapshot. */
+    T get() const
+    {
+        const juce::ScopedLock l(writeLock);
+        return owned->value;
+    }
+
+    /* Any non-realtime thread. Frees retired snapshots no reader can still see. */
+    void collectGarbage()
+    {
+        const juce::ScopedLock l(writeLock);
+        collectGarbageLocked();
+    }
+
+    int getNumRetired() const
+    {
+        const juce::ScopedLock l(writeLock);
+        return (int)retired.size();
+    }
+
+    /* One thread's access. Create it off the realtime thread; acquire() and release() are realtime safe. */
+    class Reader
+    {
+    public:
+        explicit Reader(SnapshotCell& c)
+            : cell(c)
+        {
+            auto mask = cell.claimed.load();
+
+            do
+            {
+                slot = 0;
+                while (slot < maxReaders && (mask & (1u << slot)) != 0)
+                {
+                    ++slot;
+                }
+
+                jassert(slot < maxReaders);     // raise maxReaders
+            }
+            while (!cell.claimed.compare_exchange_weak(mask, mask | (1u << slot)));
+        }
+
+        ~Reader()
+        {
+            release();
+            cell.claimed.fetch_and(~(1u << slot));
+        }
+
+        /* The latest snapshot, valid until release(). */
+        const T& acquire()
+        {
+            // stamp before loading, so a collector that misses the stamp has already swapped the pointer
+            cell.readers[(size_t)slot].store(cell.epoch.load());
+            const auto* node = cell.current.load();
+
+            version = node->version;
+            return node->value;
+        }
+
+        void release()
+        {
+            cell.readers[(size_t)slot].store(0, std::memory_order_release);
+        }
+
+        /* Of the snapshot last acquired; goes up by one per publish(). */
+        juce::uint64 getVersion() const
+        {
+            return version;
+        }
+
+    private:
+        SnapshotCell& cell;
+        int slot = 0;
+        juce::uint64 version = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (Reader)
+    };
+
+    /* acquire() for the lifetime of a scope. */
+    class ScopedRead
+    {
+    public:
+        explicit ScopedRead(Reader& r)
+            : reader(r), value(r.acquire())
+        {
+        }
+
+        ~ScopedRead()
+        {
+            reader.release();
+        }
+
+        const T& operator*() const
+        {
+            return value;
+        }
+
+        const T* operator->() const
+        {
+            return &value;
+        }
+
+    private:
+        Reader& reader;
+        const T& value;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedRead)
+    };
+
+private:
+    struct Node
+    {
+        T value;
+        juce::uint64 version;
+    };
+
+    void collectGarbageLocked()
+    {
+        // the oldest epoch any reader is stamped with; 0 means not reading
+        auto oldest = std::numeric_limits<juce::uint64>::max();
+        for (auto& r : readers)
+        {
+            const auto e = r.load();
+            if (e != 0)
+            {
+                oldest = juce::jmin(oldest, e);
+            }
+        }
+
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [oldest](const auto& r) { return r.first <= oldest; }),
+                      retired.end());
+    }
+
+    // the defaults are sequentially consistent: a reader's stamp and a writer's swap must be seen in one order
+    std::atomic<const Node*> current { nullptr };
+    std::atomic<juce::uint64> epoch { 1 };
+    std::array<std::atomic<juce::uint64>, maxReaders> readers {};
+    std::atomic<juce::uint32> claimed { 0 };
+
+    juce::CriticalSection writeLock;
+    std::unique_ptr<const Node> owned;
+    std::vector<std::pair<juce::uint64, std::unique_ptr<const Node>>> retired;
+
+    JUCE_DECLARE_NON_COPYABLE (SnapshotCell)
+};
@@ -0,0 +1,43 @@
+#include "StickShaper.h"
+
+StickShaper::StickShaper()
+{
+    // an uncalibrated stick: centred, full 12 bit range, no deadzone
+    configure({ 2048, 2048, 2048, 2048, 2048, 2048 }, 0, {});
+}
+
+void StickShaper::configure(const std::array<juce::uint16, 6>& cal, juce::uint16 deadzone, const StickResponse& response)
+{
+    for (size_t a = 0; a < 2; ++a)
+    {
+        const auto centre = (float)cal[2 + a];
+        const auto above = (float)juce::jmax<juce::uint16>(1, cal[a]);
+        const auto below = (float)juce::jmax<juce::uint16>(1, cal[4 + a]);
+
+        for (int v = 0; v < axisSize; ++v)
+        {
+            const auto diff = (float)v - centre;
+            axis[a][(size_t)v] = juce::jlimit(-1.f, 1.f, diff > 0 ? diff / above : diff / below);
+        }
+    }
+
+    // the deadzone is a raw distance, so relative to the average half range
+    const auto halfRange = ((float)cal[0] + cal[1] + cal[4] + cal[5]) * 0.25f;
+    const auto inner = juce::jlimit(0.f, 0.5f, halfRange > 0 ? deadzone * response.deadzoneScale / halfRange : 0.f);
+    const auto outer = juce::jlimit(inner + 0.05f, 1.f, response.outerRing);
+    const auto curve = juce::jmax(0.1f, response.curve);
+
+    for (int i = 0; i < radialSize; ++i)
+    {
+        const auto r = std::sqrt((float)i / radialScale);
+
+        if (r <= inner || r == 0.f)
+        {
+            radial[(size_t)i] = 0.f;
+            continue;
+        }
+
+        const auto t = juce::jlimit(0.f, 1.f, (r - inner) / (outer - inner));
+        radial[(size_t)i] = std::pow(t, curve) / r;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+struct StickResponse
+{
+    float deadzoneScale = 1.f;          // multiplies the controller's own deadzone
+    float outerRing = 0.95f;            // radius that already reads as full deflection
+    float curve = 1.f;                  // exponent on the radius past the deadzone, > 1 for finer control near centre
+};
+
+/*
+    Turns 12 bit stick readings into calibrated -1..1 axes. Everything that
+    depends on the controller's calibration is precomputed when it changes:
+    one table per axis folds the centre and the asymmetric above / below
+    centre ranges, and a radial gain table indexed by the squared radius
+    folds the deadzone, outer ring and response curve, so the deadzone is
+    circular rather than a cross. process() is two axis lookups and one
+    interpolated gain lookup, no divisions.
+*/
+class StickShaper
+{
+public:
+    static constexpr int axisSize = 4096;
+    static constexpr int radialSize = 4096;
+
+    StickShaper();
+
+    /* cal as read from SPI: max above centre x/y, centre x/y, min below centre x/y. deadzone in raw units. */
+    void configure(const std::array<juce::uint16, 6>& cal, juce::uint16 deadzone, const StickResponse& response);
+
+    std::array<float, 2> process(juce::uint16 x, juce::uint16 y) const
+    {
+        const auto cx = axis[0][x & (axisSize - 1)];
+        const auto cy = axis[1][y & (axisSize - 1)];
+
+        const auto pos = (cx * cx + cy * cy) * radialScale;
+        const auto i = juce::jmin((int)pos, radialSize - 2);
+        const auto gain = radial[(size_t)i] + (radial[(size_t)i + 1] - radial[(size_t)i]) * juce::jmin(1.f, pos - (float)i);
+
+        return { cx * gain, cy * gain };
+    }
+
+private:
+    // squared radius runs 0..2 since each axis is clamped to -1..1
+    static constexpr float radialScale = (float)(radialSize - 1) / 2.f;
+
+    std::array<std::array<float, axisSize>, 2> axis {};
+    std::array<float, radialSize> radial {};
+};
@@ -0,0 +1,459 @@
+/*
+    joycon-stress: how much the controller pipeline can take before the
+    audio thread suffers.
+
+    Runs a number of simulated controllers over a poor link (lost reports,
+    stalls that end in bursts) through the full poll / decode / batch IMU /
+    pair fusion pipeline. The first two are attached to the plugin's own
+    processor as a pair; the rest go through the same stages on the shared
+    scheduler as load. A fake audio callback on its own thread calls
+    processBlock at a small buffer size on an absolute schedule, and records
+    what the audio thread saw: deadline misses, processBlock time, and the
+    context switches it took inside processBlock, i.e. waits on a lock (or
+    anything else that blocks) and preemption. Exits non-zero on a deadline
+    miss, or, built with JOYCON_COUNT_ALLOCATIONS, on any allocation inside a
+    checked scope once the controllers are attached.
+*/
+
+#include "JuceHeader.h"
+#include "PluginProcessor.h"
+#include "SimulatedTransport.h"
+#include "CpuTime.h"
+#include "AllocationCounter.h"
+#include "ToolStats.h"
+
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    std::atomic<bool> stopRequested { false };
+
+    void handleSignal(int)
+    {
+        stopRequested = true;
+    }
+
+    const char* usage =
+        "usage: joycon-stress [options]\n"
+        "\n"
+        "  --controllers=<n>        simulated controllers, two of them on the processor (default 8)\n"
+        "  --link=<spec>            link impairment, e.g. loss=0.02,stall=0.05,burst=8 (the default), or none\n"
+        "  --block=<n>              processBlock size in samples (default 64)\n"
+        "  --rate=<hz>              sample rate (default 48000)\n"
+        "  --seconds=<n>            run time (default 30, or until Ctrl-C)\n"
+        "  --mpe                    MPE output on, so every block also rewrites notes and expression\n"
+        "  --rt=<spec>              scheduling for the audio thread and the load controllers, e.g. fifo:80,cpu=2\n"
+        "                           (the processor's own threads follow JOYCON_RT, as in the plugin)\n";
+
+    constexpr double pollIntervalMs = 5.0;
+
+    //==============================================================================
+    /*
+        Stands in for the host's audio callback: processBlock once per block
+        period, on deadlines that don't drift with wake-up latency. A block
+        misses its deadline when it finishes after the next one was due.
+    */
+    class AudioCallback : private juce::Thread
+    {
+    public:
+        AudioCallback(juce::AudioProcessor& p, double rate, int block, const RealtimeConfig& config, double maxSeconds)
+            : juce::Thread("audio callback"), processor(p), sampleRate(rate), blockSize(block), rt(config)
+        {
+            // preallocated, the callback only writes into them
+            const auto maxBlocks = (size_t)(maxSeconds * rate / block) + 16;
+            processUs.resize(maxBlocks);
+            wakeLateUs.resize(maxBlocks);
+        }
+
+        ~AudioCallback() override
+        {
+            stopThread(2000);
+        }
+
+        void start()
+        {
+            startThread(juce::Thread::Priority::highest);
+        }
+
+        void stop()
+        {
+            stopThread(2000);
+        }
+
+        double getPeriodMs() const
+        {
+            return 1000.0 * blockSize / sampleRate;
+        }
+
+        bool isRealtimeConfigApplied() const
+        {
+            return realtimeApplied;
+        }
+
+        std::atomic<juce::uint64> blocks { 0 }, deadlineMisses { 0 }, skippedPeriods { 0 }, midiEvents { 0 };
+        std::atomic<juce::uint64> blockedBlocks { 0 }, voluntarySwitches { 0 }, preemptedBlocks { 0 }, involuntarySwitches { 0 };
+        std::atomic<float> maxProcessUs { 0.f };
+
+        /* Once stopped: per block processBlock time, and how late the callback woke. */
+        std::vector<float> getProcessUs() const
+        {
+            return { processUs.begin(), processUs.begin() + (std::ptrdiff_t)juce::jmin((size_t)blocks.load(), processUs.size()) };
+        }
+
+        std::vector<float> getWakeLateUs() const
+        {
+            return { wakeLateUs.begin(), wakeLateUs.begin() + (std::ptrdiff_t)juce::jmin((size_t)blocks.load(), wakeLateUs.size()) };
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void run() override
+        {
+            realtimeApplied = applyToCurrentThread(rt).ok();
+
+            juce::AudioBuffer<float> audio(2, blockSize);
+            juce::MidiBuffer midi;
+            midi.ensureSize(4096);
+
+            const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double)blockSize / sampleRate));
+            auto due = Clock::now() + period;
+
+            while (!threadShouldExit())
+            {
+                std::this_thread::sleep_until(due);
+
+                const auto woke = Clock::now();
+                audio.clear();
+                midi.clear();
+
+                const auto switchesBefore = ThreadContextSwitches::now();
+                const auto start = Clock::now();
+
+                processor.processBlock(audio, midi);
+
+                const auto end = Clock::now();
+                const auto switchesAfter = ThreadContextSwitches::now();
+
+                const auto n = (size_t)blocks.load(std::memory_order_relaxed);
+                const auto us = (float)std::chrono::duration<double, std::micro>(end - start).count();
+
+                if (n < processUs.size())
+                {
+                    processUs[n] = us;
+                    wakeLateUs[n] = (float)std::chrono::duration<double, std::micro>(woke - due).count();
+                }
+
+                if (us > maxProcessUs.load(std::memory_order_relaxed))
+                {
+                    maxProcessUs.store(us, std::memory_order_relaxed);
+                }
+
+                const auto voluntary = switchesAfter.voluntary - switchesBefore.voluntary;
+                const auto involuntary = switchesAfter.involuntary - switchesBefore.involuntary;
+
+                if (voluntary > 0)
+                {
+                    blockedBlocks.fetch_add(1, std::memory_order_relaxed);
+                    voluntarySwitches.fetch_add((juce::uint64)voluntary, std::memory_order_relaxed);
+                }
+
+                if (involuntary > 0)
+                {
+                    preemptedBlocks.fetch_add(1, std::memory_order_relaxed);
+                    involuntarySwitches.fetch_add((juce::uint64)involuntary, std::memory_order_relaxed);
+                }
+
+                // the host would have needed this block by the time the next one was due
+                if (end > due + period)
+                {
+                    deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                midiEvents.fetch_add((juce::uint64)midi.getNumEvents(), std::memory_order_relaxed);
+                blocks.fetch_add(1, std::memory_order_relaxed);
+
+                // a callback that fell more than a period behind resyncs, as a device would drop a buffer
+                due += period;
+                if (Clock::now() > due + period)
+                {
+                    skippedPeriods.fetch_add(1, std::memory_order_relaxed);
+                    due = Clock::now() + period;
+                }
+            }
+        }
+
+        juce::AudioProcessor& processor;
+        const double sampleRate;
+        const int blockSize;
+        const RealtimeConfig rt;
+        bool realtimeApplied = true;
+
+        std::vector<float> processUs, wakeLateUs;
+
+        JUCE_DECLARE_NON_COPYABLE (AudioCallback)
+    };
+
+    /* A controller outside the processor: the same stages, run by the rig's own poll task. */
+    struct LoadController
+    {
+        Telemetry telemetry;
+        GestureEngine gestures;
+        std::unique_ptr<Joycon> joycon;
+        std::unique_ptr<JoyconPair> pair;           // on the first of each pair
+    };
+
+    /* What the summary reads from each controller, wherever it runs. */
+    struct Probe
+    {
+        juce::String name;
+        Joycon* joycon = nullptr;
+        Telemetry* telemetry = nullptr;
+        const SimulatedTransport* transport = nullptr;
+    };
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    juce::ScopedJuceInitialiser_GUI scopedJuce;
+
+    const auto numControllers = juce::jmax(2, args.containsOption("--controllers") ? args.getValueForOption("--controllers").getIntValue() : 8);
+    const auto blockSize = juce::jmax(1, args.containsOption("--block") ? args.getValueForOption("--block").getIntValue() : 64);
+    const auto sampleRate = args.containsOption("--rate") ? args.getValueForOption("--rate").getDoubleValue() : 48000.0;
+    const auto seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 30.0;
+    const auto rt = RealtimeConfig::fromString(args.getValueForOption("--rt"));
+
+    const auto linkSpec = args.containsOption("--link") ? args.getValueForOption("--link") : juce::String("loss=0.02,stall=0.05,burst=8");
+    const auto link = linkSpec == "none" ? SimulatedTransport::LinkImpairment() : SimulatedTransport::LinkImpairment::fromString(linkSpec);
+
+    hid_init();
+
+    std::vector<Probe> probes;
+
+    auto makeTransport = [&](int index)
+    {
+        auto t = std::make_unique<SimulatedTransport>(index % 2 == 0, index);
+        t->setImpairment(link);
+        return t;
+    };
+
+    auto makeEntry = [](int index)
+    {
+        HidDeviceEntry e;
+        e.path = "simulated:" + juce::String(index);
+        e.product = "Simulated Joy-Con " + juce::String(index % 2 == 0 ? "(L)" : "(R)");
+        e.serial = "simulated-" + juce::String(index);
+        e.vendorId = (juce::uint16)Joycon::vendor_id;
+        e.productId = (juce::uint16)(index % 2 == 0 ? Joycon::product_id_left : Joycon::product_id_right);
+        return e;
+    };
+
+    // the first pair on the plugin's processor, fused by its JoyconPair
+    auto processor = std::make_unique<JoyconGoodnessAudioProcessor>();
+
+    if (args.containsOption("--mpe"))
+    {
+        auto mpe = processor->getMpeSettings();
+        mpe.enabled = true;
+        processor->setMpeSettings(mpe);
+    }
+
+    processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+    processor->prepareToPlay(sampleRate, blockSize);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        auto transport = makeTransport(i);
+        const auto* t = transport.get();
+
+        const auto attached = i == 0 ? processor->setHidDevice(std::move(transport), makeEntry(i))
+                                     : processor->setPartnerDevice(std::move(transport), makeEntry(i));
+
+        if (!attached)
+        {
+            std::cerr << "can't attach simulated controller " << i << " to the processor" << std::endl;
+            return 1;
+        }
+
+        probes.push_back({ "processor " + juce::String(i), i == 0 ? processor->getJoycon() : processor->getPartner(),
+                           i == 0 ? &processor->getTelemetry() : &processor->getPartnerTelemetry(), t });
+    }
+
+    // the rest as load, in pairs, polled together like the processor polls its own
+    std::vector<std::unique_ptr<LoadController>> load;
+
+    for (int i = 2; i < numControllers; ++i)
+    {
+        auto c = std::make_unique<LoadController>();
+        auto transport = makeTransport(i);
+        const auto* t = transport.get();
+
+        c->joycon = std::make_unique<Joycon>(std::move(transport), true, true, 0.05f, i % 2 == 0, makeEntry(i).path);
+        c->joycon->SetTelemetry(&c->telemetry);
+        c->joycon->SetGestureEngine(&c->gestures);
+        c->joycon->SetRealtimeConfig(rt);
+
+        if (!c->joycon->Attach())
+        {
+            std::cerr << "can't attach simulated controller " << i << std::endl;
+            return 1;
+        }
+
+        c->joycon->Begin();
+        probes.push_back({ "load " + juce::String(i), c->joycon.get(), &c->telemetry, t });
+        load.push_back(std::move(c));
+    }
+
+    for (size_t i = 0; i + 1 < load.size(); i += 2)
+    {
+        load[i]->pair = std::make_unique<JoyconPair>();
+        load[i]->pair->setSources(&load[i]->telemetry, &load[i + 1]->telemetry);
+    }
+
+    juce::SharedResourcePointer<Scheduler> scheduler;
+    ImuBatch batch;
+
+    const auto loadTask = scheduler->schedule(pollIntervalMs, [&]
+    {
+        batch.clear();
+        for (auto& c : load)
+        {
+            c->joycon->Update(&batch);
+        }
+
+        batch.process();
+
+        for (auto& c : load)
+        {
+            c->joycon->ApplyImuBatch(batch);
+
+            SourceFrame frame;
+            if (c->pair != nullptr)
+            {
+                c->pair->read(frame);
+            }
+        }
+    }, pollIntervalMs);
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    AudioCallback callback(*processor, sampleRate, blockSize, rt, seconds);
+
+    std::cout << numControllers << " controllers (2 paired on the processor), link " << (linkSpec == "none" ? juce::String("clean") : linkSpec)
+              << ", " << blockSize << " samples at " << juce::String(sampleRate, 0) << " Hz ("
+              << juce::String(callback.getPeriodMs(), 2) << " ms per block)" << std::endl;
+
+    const auto started = juce::Time::getMillisecondCounterHiRes();
+    auto lastProgress = started;
+
+    // attaching allocates; from here on every checked scope is in steady state
+    AllocationCounter::resetViolations();
+
+    callback.start();
+
+    while (!stopRequested && juce::Time::getMillisecondCounterHiRes() - started < seconds * 1000.0)
+    {
+        juce::Thread::sleep(50);
+
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        if (now - lastProgress >= 5000.0)
+        {
+            std::cerr << juce::String((now - started) * 0.001, 0) << "s: " << (juce::int64)callback.blocks.load() << " blocks, "
+                      << (juce::int64)callback.deadlineMisses.load() << " deadline misses, processBlock max "
+                      << juce::String(callback.maxProcessUs.load(), 1) << " us" << std::endl;
+            lastProgress = now;
+        }
+    }
+
+    callback.stop();
+    const auto elapsed = (juce::Time::getMillisecondCounterHiRes() - started) * 0.001;
+
+    scheduler->cancel(loadTask);
+
+    //==============================================================================
+    const auto periodUs = callback.getPeriodMs() * 1000.0;
+    const auto processUs = callback.getProcessUs();
+    const auto wakeLateUs = callback.getWakeLateUs();
+    const auto blocks = (juce::int64)callback.blocks.load();
+
+    std::cout << "audio: " << blocks << " blocks in " << juce::String(elapsed, 1) << "s, "
+              << (juce::int64)callback.deadlineMisses.load() << " deadline misses, "
+              << (juce::int64)callback.skippedPeriods.load() << " skipped periods, "
+              << (juce::int64)callback.midiEvents.load() << " MIDI events"
+              << (callback.isRealtimeConfigApplied() ? "" : " (realtime config NOT applied)") << "\n";
+
+    std::cout << "  processBlock: p50 " << juce::String(percentile(processUs, 0.5), 1)
+              << " us, p99 " << juce::String(percentile(processUs, 0.99), 1)
+              << " us, max " << juce::String(callback.maxProcessUs.load(), 1)
+              << " us (" << juce::String(100.0 * callback.maxProcessUs.load() / periodUs, 1) << "% of the block)\n";
+
+    std::cout << "  wake-up lateness: p99 " << juce::String(percentile(wakeLateUs, 0.99), 1)
+              << " us, max " << juce::String(percentile(wakeLateUs, 1.0), 1) << " us\n";
+
+    std::cout << "  inside processBlock: blocked " << (juce::int64)callback.voluntarySwitches.load() << " times in "
+              << (juce::int64)callback.blockedBlocks.load() << " blocks (a lock or other wait), preempted "
+              << (juce::int64)callback.involuntarySwitches.load() << " times in " << (juce::int64)callback.preemptedBlocks.load() << " blocks\n";
+
+    double totalPollCpu = 0.0;
+    juce::uint64 totalOverflows = 0, totalDrops = 0, totalLost = 0, totalHeld = 0;
+
+    for (auto& p : probes)
+    {
+        const auto pollCpu = p.joycon->GetPollCpuSeconds();
+        const auto& linkStats = p.transport->getLinkStats();
+
+        totalPollCpu += pollCpu;
+        totalOverflows += p.joycon->GetQueueOverflows();
+        totalDrops += p.joycon->GetConnectionStats().drops.load();
+        totalLost += linkStats.lost.load();
+        totalHeld += linkStats.held.load();
+
+        std::cout << "  " << p.name << ": " << juce::String((double)histogramCount(p.telemetry->packetInterval) / elapsed, 1) << " reports/s"
+                  << ", lost " << (int)linkStats.lost.load() << ", stalls " << (int)linkStats.stalls.load()
+                  << " holding " << (int)linkStats.held.load()
+                  << ", queue lag p99 " << juce::String(histogramPercentileMs(p.telemetry->dequeueLag, 0.99), 0) << " ms"
+                  << ", queue overflows " << (int)p.joycon->GetQueueOverflows()
+                  << ", drops " << (int)p.joycon->GetConnectionStats().drops.load()
+                  << ", poll cpu " << juce::String(100.0 * pollCpu / elapsed, 2) << "%\n";
+    }
+
+    std::cout << "controllers: poll threads " << juce::String(100.0 * totalPollCpu / elapsed, 1) << "% of a core in total, "
+              << (juce::int64)totalOverflows << " queue overflows, " << (juce::int64)totalDrops << " drops, "
+              << (juce::int64)totalLost << " reports lost and " << (juce::int64)totalHeld << " held by the link\n";
+
+    std::cout << "scheduler: lateness p50 " << juce::String(histogramPercentileMs(scheduler->getLateness(), 0.5), 1)
+              << " p99 " << juce::String(histogramPercentileMs(scheduler->getLateness(), 0.99), 1)
+              << " ms, max " << juce::String(scheduler->getMaxLatenessMs(), 1) << " ms" << std::endl;
+
+    const auto allocationViolations = AllocationCounter::getNumViolations();
+
+    if (AllocationCounter::isEnabled())
+    {
+        std::cout << "allocations: " << (juce::int64)allocationViolations << " checked scopes allocated"
+                  << (allocationViolations > 0 ? juce::String(" (last in ") + AllocationCounter::getLastViolation() + ")" : juce::String()) << std::endl;
+    }
+
+    for (auto& c : load)
+    {
+        c->joycon->Detach();
+    }
+
+    load.clear();
+    processor.reset();
+
+    hid_exit();
+    return callback.deadlineMisses.load() > 0 || allocationViolations > 0 ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/* One processed controller report as seen by the telemetry view. */
+struct TelemetrySample
+{
+    juce::int64 ticks = 0;          // juce::Time::getHighResolutionTicks() when processed
+    double deviceMs = 0;            // the newest report's own timer on the host clock, see DeviceClock
+    float pitchRollYaw[3] = {};     // orientation filter output, about +-4.4 at 90 degrees
+    float acc[3] = {};              // g
+    float gyr[3] = {};              // degrees per second
+    float stick[2] = {};            // -1..1
+    juce::uint32 buttons = 0;       // bit n set when Joycon::Button n is held
+};
+
+/*
+    The read side of the single-writer rings below, seqlock style: copies num
+    slots from index first on, then rereads the writer's count. Returns how
+    many of the oldest copies the writer may have overwritten meanwhile, the
+    record it is writing now included; the caller drops those.
+*/
+template <typename T, size_t capacity, typename Index>
+Index copyFromRing(const std::array<T, capacity>& ring, const std::atomic<Index>& written, Index first, Index num, T* dest)
+{
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    for (Index i = 0; i < num; ++i)
+    {
+        dest[i] = ring[(size_t)((first + i) & (Index)(capacity - 1))];
+    }
+
+    // keeps the copies above from being reordered after the check below
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // slot first + k is safe until the writer reaches record first + k + capacity
+    const Index ahead = written.load(std::memory_order_relaxed) + 1 - first;
+    return ahead > (Index)capacity ? juce::jmin(num, (Index)(ahead - (Index)capacity)) : (Index)0;
+}
+
+/*
+    Fixed size single-writer history ring. The writer never blocks and never
+    waits for readers; a reader copies the most recent samples and drops any
+    that were overwritten while it was copying.
+*/
+class TelemetryHistory
+{
+public:
+    static constexpr juce::uint32 capacity = 1024;
+
+    void push(const TelemetrySample& s)
+    {
+        auto w = written.load(std::memory_order_relaxed);
+        samples[w & (capacity - 1)] = s;
+        written.store(w + 1, std::memory_order_release);
+    }
+
+    /* Copies up to maxSamples of the newest samples, oldest first. Returns the number copied. */
+    int readLatest(TelemetrySample* dest, int maxSamples) const
+    {
+        const auto end = written.load(std::memory_order_acquire);
+        const auto num = (juce::uint32)juce::jmin<juce::int64>(juce::jmax(0, maxSamples), juce::jmin<juce::uint32>(end, capacity / 2));
+
+        // anything the writer lapped while we were copying is stale
+        const auto stale = copyFromRing(samples, written, end - num, num, dest);
+        if (stale > 0)
+        {
+            std::copy(dest + stale, dest + num, dest);
+        }
+
+        return (int)(num - stale);
+    }
+
+    juce::uint32 getNumWritten() const
+    {
+        return written.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::array<TelemetrySample, capacity> samples;
+    std::atomic<juce::uint32> written { 0 };
+};
+
+/* One IMU sample as the poll cycle processed it: three per 0x30 report. */
+struct ImuRecord
+{
+    double timeMs = 0;                  // report arrival, minus 5 ms per older sample in the report
+    juce::int16 rawAcc[3] = {};         // as reported
+    juce::int16 rawGyr[3] = {};
+    float acc[3] = {};                  // g, mirrored for the left Joy-Con
+    float gyr[3] = {};                  // degrees per second, bias removed and mirrored
+    float pitchRollYaw[3] = {};         // orientation filter output after this sample
+};
+
+/*
+    Single-writer, multi-reader broadcast ring of every IMU sample, so any
+    number of consumers get the full 200 Hz stream rather than polling the
+    latest orientation. The writer never waits: each Reader keeps its own
+    cursor, and one that falls more than a ring behind skips ahead and
+    counts what it missed instead of stalling the poll thread.
+*/
+class ImuBroadcast
+{
+public:
+    static constexpr juce::uint32 capacity = 1024;     // about 5 s at 200 Hz
+
+    /* Poll cycle thread. */
+    void push(const ImuRecord& r)
+    {
+        auto w = written.load(std::memory_order_relaxed);
+        records[(size_t)(w & (capacity - 1))] = r;
+        written.store(w + 1, std::memory_order_release);
+    }
+
+    juce::uint64 getNumWritten() const
+    {
+        return written.load(std::memory_order_acquire);
+    }
+
+    /* One consumer's view of the ring. Not thread safe itself; use one per reading thread. */
+    class Reader
+    {
+    public:
+        /* Starts at the newest record, or at the oldest still in the ring. */
+        explicit Reader(const ImuBroadcast& ring, bool fromNewest = true)
+            : source(ring)
+        {
+            const auto w = source.getNumWritten();
+            cursor = fromNewest ? w : firstValidAfter(w);
+        }
+
+        /* Copies up to maxRecords unread records, oldest first. Returns the number copied. */
+        int read(ImuRecord* dest, int maxRecords)
+        {
+            const auto end = source.getNumWritten();
+            skipOverwritten(end);
+
+            const auto num = juce::jmin<juce::uint64>((juce::uint64)juce::jmax(0, maxRecords), end - cursor);
+
+            // drop anything the writer started overwriting while we copied
+            const auto stale = copyFromRing(source.records, source.written, cursor, num, dest);
+            if (stale > 0)
+            {
+                std::copy(dest + stale, dest + num, dest);
+                overruns += stale;
+            }
+
+            cursor += num;
+            return (int)(num - stale);
+        }
+
+        /* Unread records, including any already overwritten. */
+        juce::uint64 getNumAvailable() const
+        {
+            return source.getNumWritten() - cursor;
+        }
+
+        /* Records lost because this reader fell more than a ring behind. */
+        juce::uint64 getNumOverruns() const
+        {
+            return overruns;
+        }
+
+    private:
+        static juce::uint64 firstValidAfter(juce::uint64 written)
+        {
+            // the slot of record written - capacity may be mid-write
+            return written >= capacity ? written - capacity + 1 : 0;
+        }
+
+        void skipOverwritten(juce::uint64 end)
+        {
+            const auto firstValid = firstValidAfter(end);
+            if (cursor < firstValid)
+            {
+                overruns += firstValid - cursor;
+                cursor = firstValid;
+            }
+        }
+
+        const ImuBroadcast& source;
+        juce::uint64 cursor = 0;
+        juce::uint64 overruns = 0;
+    };
+
+private:
+    std::array<ImuRecord, capacity> records;
+    std::atomic<juce::uint64> written { 0 };
+};
+
+/* Lock-free latency histogram, one bin per millisecond unless given finer bins, last bin collects overflow. */
+class LatencyHistogram
+{
+public:
+    static constexpr int numBins = 32;
+
+    explicit LatencyHistogram(double binWidthMs = 1.0)
+        : binMs(binWidthMs)
+    {
+    }
+
+    void record(double ms)
+    {
+        auto bin = juce::jlimit(0, numBins - 1, (int)(ms / binMs));
+        bins[(size_t)bin].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    double getBinWidthMs() const
+    {
+        return binMs;
+    }
+
+    void getCounts(juce::uint32* dest) const
+    {
+        for (size_t i = 0; i < (size_t)numBins; ++i)
+        {
+            dest[i] = bins[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void reset()
+    {
+        for (auto& b : bins)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    const double binMs;
+    std::array<std::atomic<juce::uint32>, numBins> bins {};
+};
+
+/*
+    Telemetry for one controller slot. Owned by the processor rather than the
+    Joycon, so the view can keep reading it while a controller is swapped.
+*/
+struct Telemetry
+{
+    TelemetryHistory history;
+    ImuBroadcast imu;                   // every IMU sample, for consumers that need the full rate
+    LatencyHistogram dequeueLag;        // report arrival -> processed
+    LatencyHistogram packetInterval;    // between consecutive reports, expect ~15ms
+    std::atomic<bool> active { false };
+};
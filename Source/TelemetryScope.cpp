@@ -0,0 +1,194 @@
+#include "TelemetryScope.h"
+
+namespace
+{
+    const juce::Colour traceColours[] = { juce::Colour(0xffff5555), juce::Colour(0xff55ff77), juce::Colour(0xff5599ff) };
+}
+
+//==============================================================================
+TelemetryScope::TelemetryScope()
+{
+    setOpaque(true);
+    path.preallocateSpace(historyLength * 3 + 8);
+
+    openGLContext.setRenderer(this);
+    openGLContext.setComponentPaintingEnabled(false);
+    openGLContext.setContinuousRepainting(true);
+    openGLContext.attachTo(*this);
+}
+
+TelemetryScope::~TelemetryScope()
+{
+    openGLContext.detach();
+}
+
+void TelemetryScope::setSources(const std::vector<Telemetry*>& newSources)
+{
+    juce::ScopedLock l(sourceLock);
+    sources = newSources;
+}
+
+//==============================================================================
+void TelemetryScope::renderOpenGL()
+{
+    const auto scale = (float)openGLContext.getRenderingScale();
+    const auto width = juce::roundToInt(scale * (float)getWidth());
+    const auto height = juce::roundToInt(scale * (float)getHeight());
+
+    juce::OpenGLHelpers::clear(juce::Colour(0xff101418));
+
+    std::unique_ptr<juce::LowLevelGraphicsContext> glRenderer(juce::createOpenGLGraphicsContext(openGLContext, width, height));
+
+    if (glRenderer == nullptr)
+    {
+        return;
+    }
+
+    juce::Graphics g(*glRenderer);
+    g.addTransform(juce::AffineTransform::scale(scale));
+
+    juce::ScopedLock l(sourceLock);
+
+    int numActive = 0;
+    for (auto* t : sources)
+    {
+        numActive += t->active ? 1 : 0;
+    }
+
+    if (numActive == 0)
+    {
+        g.setColour(juce::Colours::grey);
+        g.drawText("No controller attached", getLocalBounds(), juce::Justification::centred);
+        return;
+    }
+
+    auto area = getLocalBounds().toFloat();
+    const auto laneHeight = area.getHeight() / (float)numActive;
+
+    for (auto* t : sources)
+    {
+        if (t->active)
+        {
+            drawLane(g, *t, area.removeFromTop(laneHeight).reduced(2.f));
+        }
+    }
+}
+
+void TelemetryScope::drawLane(juce::Graphics& g, Telemetry& t, juce::Rectangle<float> area)
+{
+    g.setColour(juce::Colour(0xff303840));
+    g.drawRect(area);
+
+    const auto numSamples = t.history.readLatest(scratch.data(), historyLength);
+
+    auto histograms = area.removeFromRight(area.getWidth() * 0.2f);
+    drawHistogram(g, histograms.removeFromTop(histograms.getHeight() * 0.5f).reduced(4.f), t.dequeueLag, juce::Colours::orange);
+    drawHistogram(g, histograms.reduced(4.f), t.packetInterval, juce::Colours::skyblue);
+
+    if (numSamples < 2)
+    {
+        return;
+    }
+
+    const auto rowHeight = area.getHeight() / 5.f;
+
+    drawTraces(g, area.removeFromTop(rowHeight), numSamples, 3, 4.4f, true,
+               [](const TelemetrySample& s, int i) { return s.pitchRollYaw[i]; });
+    drawTraces(g, area.removeFromTop(rowHeight), numSamples, 3, 4.f, true,
+               [](const TelemetrySample& s, int i) { return s.acc[i]; });
+    drawTraces(g, area.removeFromTop(rowHeight), numSamples, 3, 1000.f, true,
+               [](const TelemetrySample& s, int i) { return s.gyr[i]; });
+    drawTraces(g, area.removeFromTop(rowHeight), numSamples, 2, 1.f, true,
+               [](const TelemetrySample& s, int i) { return s.stick[i]; });
+    drawButtons(g, area, numSamples);
+}
+
+template <typename Getter>
+void TelemetryScope::drawTraces(juce::Graphics& g, juce::Rectangle<float> area, int numSamples,
+                                int numTraces, float range, bool bipolar, Getter getValue)
+{
+    area.reduce(0.f, 2.f);
+
+    const auto dx = area.getWidth() / (float)(historyLength - 1);
+    const auto x0 = area.getRight() - dx * (float)(numSamples - 1);
+
+    auto toY = [&](float v)
+    {
+        auto norm = bipolar ? (v / range) * 0.5f + 0.5f : v / range;
+        return area.getBottom() - juce::jlimit(0.f, 1.f, norm) * area.getHeight();
+    };
+
+    if (bipolar)
+    {
+        g.setColour(juce::Colour(0xff303840));
+        g.drawHorizontalLine(juce::roundToInt(area.getCentreY()), area.getX(), area.getRight());
+    }
+
+    for (int trace = 0; trace < numTraces; ++trace)
+    {
+        path.clear();
+        path.startNewSubPath(x0, toY(getValue(scratch[0], trace)));
+
+        for (int i = 1; i < numSamples; ++i)
+        {
+            path.lineTo(x0 + dx * (float)i, toY(getValue(scratch[(size_t)i], trace)));
+        }
+
+        g.setColour(traceColours[trace]);
+        g.strokePath(path, juce::PathStrokeType(1.2f));
+    }
+}
+
+void TelemetryScope::drawButtons(juce::Graphics& g, juce::Rectangle<float> area, int numSamples)
+{
+    constexpr int numButtons = 13;
+
+    const auto dx = area.getWidth() / (float)(historyLength - 1);
+    const auto x0 = area.getRight() - dx * (float)(numSamples - 1);
+    const auto rowHeight = area.getHeight() / (float)numButtons;
+
+    g.setColour(juce::Colours::gold);
+
+    for (int b = 0; b < numButtons; ++b)
+    {
+        const auto y = area.getY() + rowHeight * (float)b;
+        int runStart = -1;
+
+        // one rectangle per run of held samples
+        for (int i = 0; i <= numSamples; ++i)
+        {
+            bool held = i < numSamples && (scratch[(size_t)i].buttons & (1u << b)) != 0;
+
+            if (held && runStart < 0)
+            {
+                runStart = i;
+            }
+            else if (!held && runStart >= 0)
+            {
+                g.fillRect(x0 + dx * (float)runStart, y, dx * (float)(i - runStart), rowHeight * 0.8f);
+                runStart = -1;
+            }
+        }
+    }
+}
+
+void TelemetryScope::drawHistogram(juce::Graphics& g, juce::Rectangle<float> area, const LatencyHistogram& h, juce::Colour c)
+{
+    h.getCounts(bins.data());
+
+    juce::uint32 peak = 1;
+    for (auto b : bins)
+    {
+        peak = juce::jmax(peak, b);
+    }
+
+    const auto barWidth = area.getWidth() / (float)LatencyHistogram::numBins;
+
+    g.setColour(c);
+
+    for (size_t i = 0; i < bins.size(); ++i)
+    {
+        auto barHeight = area.getHeight() * (float)bins[i] / (float)peak;
+        g.fillRect(area.getX() + barWidth * (float)i, area.getBottom() - barHeight, barWidth * 0.8f, barHeight);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Telemetry.h"
+
+//==============================================================================
+/**
+    Scrolling scope of controller telemetry, rendered on the OpenGL thread at
+    display refresh. It only reads the lock-free Telemetry rings, so neither the
+    message thread nor the audio thread does any work per frame, and each extra
+    controller adds one lane to the GL frame rather than another UI timer.
+*/
+class TelemetryScope  : public juce::Component, private juce::OpenGLRenderer
+{
+public:
+    TelemetryScope();
+    ~TelemetryScope() override;
+
+    /* Sources are only read on the GL thread; the pointers must stay valid until removed. */
+    void setSources(const std::vector<Telemetry*>& newSources);
+
+private:
+    void newOpenGLContextCreated() override {}
+    void renderOpenGL() override;
+    void openGLContextClosing() override {}
+
+    void drawLane(juce::Graphics& g, Telemetry& t, juce::Rectangle<float> area);
+    template <typename Getter>
+    void drawTraces(juce::Graphics& g, juce::Rectangle<float> area, int numSamples,
+                    int numTraces, float range, bool bipolar, Getter getValue);
+    void drawButtons(juce::Graphics& g, juce::Rectangle<float> area, int numSamples);
+    void drawHistogram(juce::Graphics& g, juce::Rectangle<float> area, const LatencyHistogram& h, juce::Colour c);
+
+    static constexpr int historyLength = 400;   // samples on screen, ~6s at 60Hz
+
+    juce::OpenGLContext openGLContext;
+
+    juce::CriticalSection sourceLock;           // taken by the GL thread and setSources() only
+    std::vector<Telemetry*> sources;
+
+    std::array<TelemetrySample, historyLength> scratch;
+    std::array<juce::uint32, LatencyHistogram::numBins> bins;
+    juce::Path path;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TelemetryScope)
+};
@@ -0,0 +1,212 @@
+#include "ThreadTuning.h"
+
+#if ! JUCE_WINDOWS
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <cerrno>
+ #include <time.h>
+#endif
+
+#include <thread>
+
+RealtimeConfig RealtimeConfig::fromString(const juce::String& s)
+{
+    RealtimeConfig c;
+    juce::StringArray tokens;
+    tokens.addTokens(s, ",", {});
+
+    for (auto t : tokens)
+    {
+        t = t.trim().toLowerCase();
+
+        if (t.startsWith("fifo") || t.startsWith("rr"))
+        {
+            c.policy = t.startsWith("fifo") ? Policy::fifo : Policy::roundRobin;
+            c.priority = t.containsChar(':') ? t.fromFirstOccurrenceOf(":", false, false).getIntValue() : 50;
+        }
+        else if (t.startsWith("cpu="))
+        {
+            c.cpu = t.fromFirstOccurrenceOf("=", false, false).getIntValue();
+        }
+        else if (t == "mlock")
+        {
+            c.lockMemory = true;
+        }
+    }
+
+    return c;
+}
+
+juce::String RealtimeConfig::toString() const
+{
+    juce::String s = policy == Policy::fifo ? "fifo:" + juce::String(priority)
+                   : policy == Policy::roundRobin ? "rr:" + juce::String(priority)
+                   : "normal";
+
+    if (cpu >= 0)
+    {
+        s += ",cpu=" + juce::String(cpu);
+    }
+
+    if (lockMemory)
+    {
+        s += ",mlock";
+    }
+
+    return s;
+}
+
+ThreadTuningResult applyToCurrentThread(const RealtimeConfig& config)
+{
+    ThreadTuningResult r;
+
+   #if ! JUCE_WINDOWS
+    if (config.policy != RealtimeConfig::Policy::normal)
+    {
+        const int policy = config.policy == RealtimeConfig::Policy::fifo ? SCHED_FIFO : SCHED_RR;
+
+        sched_param param {};
+        param.sched_priority = juce::jlimit(sched_get_priority_min(policy), sched_get_priority_max(policy), config.priority);
+
+        r.scheduling = pthread_setschedparam(pthread_self(), policy, &param) == 0;
+    }
+
+    if (config.cpu >= 0)
+    {
+       #if JUCE_LINUX
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        r.affinity = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+       #else
+        r.affinity = false;     // macOS only offers affinity tags, not pinning
+       #endif
+    }
+
+    if (config.lockMemory)
+    {
+        r.memoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    }
+   #else
+    r.scheduling = config.policy == RealtimeConfig::Policy::normal;
+    r.affinity = config.cpu < 0;
+    r.memoryLocked = ! config.lockMemory;
+   #endif
+
+    return r;
+}
+
+void sleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+   #if JUCE_LINUX
+    // steady_clock is CLOCK_MONOTONIC here
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    timespec ts { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+    int err;
+    while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {}
+
+    // any other error would fail again at once; sleep portably instead of spinning on it
+    if (err != 0)
+    {
+        std::this_thread::sleep_until(deadline);
+    }
+   #else
+    std::this_thread::sleep_until(deadline);
+   #endif
+}
+
+WakeupJitter WakeupJitter::measure(const RealtimeConfig& config, int periodUs, int iterations)
+{
+    WakeupJitter result;
+    std::vector<double> lateness((size_t)juce::jmax(1, iterations));
+
+    std::thread t([&]
+    {
+        result.tuning = applyToCurrentThread(config);
+
+        const auto period = std::chrono::microseconds(periodUs);
+        auto deadline = std::chrono::steady_clock::now() + period;
+
+        for (auto& l : lateness)
+        {
+            sleepUntil(deadline);
+            l = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - deadline).count();
+            deadline += period;
+        }
+    });
+
+    t.join();
+
+    std::sort(lateness.begin(), lateness.end());
+
+    result.samples = (int)lateness.size();
+    result.minUs = lateness.front();
+    result.medianUs = lateness[lateness.size() / 2];
+    result.p99Us = lateness[juce::jmin(lateness.size() - 1, lateness.size() * 99 / 100)];
+    result.maxUs = lateness.back();
+
+    return result;
+}
+
+juce::String WakeupJitter::compare(const RealtimeConfig& base, int periodUs, int iterations)
+{
+    const int priority = base.priority > 0 ? base.priority : 80;
+    const int cpu = base.cpu >= 0 ? base.cpu : juce::SystemStats::getNumCpus() - 1;
+
+    auto cell = [](double us)
+    {
+        return juce::String(us, 1).paddedLeft(' ', 9);
+    };
+
+    juce::String table;
+    table << "wake-up lateness in us, " << iterations << " wake-ups every " << periodUs << " us each\n"
+          << juce::String("unpinned").paddedLeft(' ', 37) << juce::String("pinned to cpu " + juce::String(cpu)).paddedLeft(' ', 27) << "\n"
+          << juce::String().paddedRight(' ', 10);
+
+    for (int pinned = 0; pinned < 2; ++pinned)
+    {
+        table << "   median      p99      max";
+    }
+
+    table << "\n";
+
+    for (auto policy : { RealtimeConfig::Policy::normal, RealtimeConfig::Policy::roundRobin, RealtimeConfig::Policy::fifo })
+    {
+        RealtimeConfig config = base;
+        config.policy = policy;
+        config.priority = priority;
+
+        juce::String notes;
+        table << config.toString().upToFirstOccurrenceOf(",", false, false).paddedRight(' ', 10);
+
+        for (int pinned = 0; pinned < 2; ++pinned)
+        {
+            config.cpu = pinned != 0 ? cpu : -1;
+            const auto r = measure(config, periodUs, iterations);
+
+            table << cell(r.medianUs) << cell(r.p99Us) << cell(r.maxUs);
+
+            if (!r.tuning.ok())
+            {
+                notes << (pinned != 0 ? " pinned" : " unpinned");
+            }
+        }
+
+        if (notes.isNotEmpty())
+        {
+            table << "   (not permitted, fell back:" << notes << ")";
+        }
+
+        table << "\n";
+    }
+
+    return table;
+}
+
+juce::String WakeupJitter::toString() const
+{
+    return "min " + juce::String(minUs, 1) + "us, median " + juce::String(medianUs, 1)
+         + "us, p99 " + juce::String(p99Us, 1) + "us, max " + juce::String(maxUs, 1) + "us"
+         + (tuning.ok() ? "" : " (tuning not permitted, fell back)");
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <chrono>
+
+/*
+    Scheduling for the controller threads. juce::Thread::Priority::highest is
+    still SCHED_OTHER on Linux, so real-time policies, CPU pinning and memory
+    locking are applied here from inside the thread itself. Every step falls
+    back silently (and reports what failed) when the process lacks permission,
+    e.g. no CAP_SYS_NICE / rtprio limit.
+*/
+struct RealtimeConfig
+{
+    enum class Policy
+    {
+        normal,
+        fifo,
+        roundRobin
+    };
+
+    Policy policy = Policy::normal;
+    int priority = 0;           // 1..99 for fifo / roundRobin
+    int cpu = -1;               // pin to this core, -1 leaves affinity alone
+    bool lockMemory = false;    // mlockall(MCL_CURRENT | MCL_FUTURE), process wide
+
+    /* Parses e.g. "fifo:80,cpu=2,mlock" or "rr:40". Unknown tokens are ignored. */
+    static RealtimeConfig fromString(const juce::String& s);
+
+    juce::String toString() const;
+};
+
+struct ThreadTuningResult
+{
+    bool scheduling = true;
+    bool affinity = true;
+    bool memoryLocked = true;
+
+    bool ok() const { return scheduling && affinity && memoryLocked; }
+};
+
+/* Applies config to the calling thread. */
+ThreadTuningResult applyToCurrentThread(const RealtimeConfig& config);
+
+/* Sleeps to an absolute deadline, so periodic waits don't drift with wake-up latency (clock_nanosleep on Linux). */
+void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+/*
+    Wake-up latency benchmark: a thread with the given config sleeps to an
+    absolute deadline every periodUs and records how late it woke.
+*/
+struct WakeupJitter
+{
+    double minUs = 0, medianUs = 0, p99Us = 0, maxUs = 0;
+    int samples = 0;
+    ThreadTuningResult tuning;
+
+    static WakeupJitter measure(const RealtimeConfig& config, int periodUs, int iterations);
+
+    /*
+        measure() for normal, round robin and fifo scheduling, each unpinned and
+        pinned, as one table. base gives the priority (default 80), the core to
+        pin to (default the last) and mlock.
+    */
+    static juce::String compare(const RealtimeConfig& base, int periodUs, int iterations);
+
+    juce::String toString() const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "JuceHeader.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/* Summary statistics shared by the command line tools (console, regress, stress). */
+
+/* The p-th (0..1) percentile of values by nearest rank, 0 when empty. */
+template <typename T>
+double percentile(std::vector<T> values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    return (double)values[(size_t)juce::jmin((double)values.size() - 1.0, p * (double)values.size())];
+}
+
+/* A snapshot of a LatencyHistogram's bins. */
+using LatencyCounts = std::array<juce::uint32, LatencyHistogram::numBins>;
+
+inline LatencyCounts getCounts(const LatencyHistogram& h)
+{
+    LatencyCounts counts;
+    h.getCounts(counts.data());
+    return counts;
+}
+
+/* Samples recorded between two snapshots, or in total when before is left empty. */
+inline juce::uint64 histogramCount(const LatencyCounts& now, const LatencyCounts& before = {})
+{
+    juce::uint64 total = 0;
+    for (size_t i = 0; i < now.size(); ++i)
+    {
+        total += now[i] - before[i];
+    }
+    return total;
+}
+
+/* The bin the p-th percentile of the samples recorded between two snapshots falls in, 0 when there are none. */
+inline int histogramPercentile(const LatencyCounts& now, const LatencyCounts& before, double p)
+{
+    const auto total = histogramCount(now, before);
+
+    juce::uint64 seen = 0;
+    for (size_t i = 0; i < now.size(); ++i)
+    {
+        seen += now[i] - before[i];
+        if (total > 0 && (double)seen >= p * (double)total)
+        {
+            return (int)i;
+        }
+    }
+
+    return 0;
+}
+
+inline juce::uint64 histogramCount(const LatencyHistogram& h)
+{
+    return histogramCount(getCounts(h));
+}
+
+/* The p-th percentile of everything h recorded in ms, as the upper edge of its bin; 0 when empty. */
+inline double histogramPercentileMs(const LatencyHistogram& h, double p)
+{
+    const auto counts = getCounts(h);
+    return histogramCount(counts) > 0 ? (double)(histogramPercentile(counts, {}, p) + 1) * h.getBinWidthMs() : 0.0;
+}
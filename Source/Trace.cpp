@@ -0,0 +1,258 @@
+#include "Trace.h"
+
+std::atomic<bool> Trace::enabled { false };
+
+namespace
+{
+    class ThreadBuffer
+    {
+    public:
+        static constexpr juce::uint32 capacity = 1 << 15;
+
+        ThreadBuffer(juce::uint32 id) : tid(id)
+        {
+            name[0] = '\0';
+        }
+
+        /* Called only from the owning thread. */
+        bool push(const Trace::Event& e)
+        {
+            auto w = writeIndex.load(std::memory_order_relaxed);
+
+            if (w - readIndex.load(std::memory_order_acquire) >= capacity)
+            {
+                return false;
+            }
+
+            events[w & (capacity - 1)] = e;
+            writeIndex.store(w + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* Called only from the thread draining the trace. */
+        template <typename Fn> void drain(Fn&& fn)
+        {
+            auto r = readIndex.load(std::memory_order_relaxed);
+            auto w = writeIndex.load(std::memory_order_acquire);
+
+            for (; r != w; ++r)
+            {
+                fn(events[r & (capacity - 1)]);
+            }
+
+            readIndex.store(r, std::memory_order_release);
+        }
+
+        const juce::uint32 tid;
+        char name[32];
+        std::atomic<bool> claimed { false };    // set by the first owner once name is filled in
+        std::atomic<bool> owned { false };      // held by a live thread, released when it exits
+
+    private:
+        std::array<Trace::Event, capacity> events;
+        std::atomic<juce::uint32> writeIndex { 0 };
+        std::atomic<juce::uint32> readIndex { 0 };
+    };
+
+    /*
+        Every ring is allocated up front by the first setEnabled(true), off the
+        realtime threads; a thread's first event then claims a free one with a
+        compare_exchange, so the audio thread never allocates or locks to trace.
+        A ring goes back to the pool when its thread exits, so reconnects that
+        restart the poll thread don't use them up.
+    */
+    struct Registry
+    {
+        static constexpr juce::uint32 maxThreads = 16;     // live threads past this have their events dropped
+
+        std::mutex lock;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::atomic<bool> allocated { false };
+        std::atomic<juce::int64> origin { 0 };
+        std::atomic<juce::uint64> dropped { 0 };
+
+        static Registry& get()
+        {
+            static Registry r;
+            return r;
+        }
+
+        void allocate()
+        {
+            std::lock_guard<std::mutex> l(lock);
+
+            if (!allocated.load())
+            {
+                for (juce::uint32 i = 0; i < maxThreads; ++i)
+                {
+                    buffers.push_back(std::make_unique<ThreadBuffer>(i + 1));
+                }
+
+                allocated.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    /* Returns the thread's ring to the pool when the thread exits; undrained events stay for writeJson. */
+    struct RingClaim
+    {
+        ~RingClaim()
+        {
+            if (buffer != nullptr)
+            {
+                buffer->owned.store(false, std::memory_order_release);
+            }
+        }
+
+        ThreadBuffer* buffer = nullptr;
+    };
+
+    thread_local RingClaim threadRing;
+    thread_local bool threadUnclaimable = false;
+    thread_local char threadName[32] = {};
+
+    /* Null before tracing was first enabled, or if every ring was held by a live thread when this one first traced. */
+    ThreadBuffer* getThreadBuffer()
+    {
+        if (threadRing.buffer != nullptr || threadUnclaimable)
+        {
+            return threadRing.buffer;
+        }
+
+        auto& reg = Registry::get();
+        if (!reg.allocated.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        ThreadBuffer* b = nullptr;
+
+        for (auto& candidate : reg.buffers)
+        {
+            bool expected = false;
+            if (candidate->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                b = candidate.get();
+                break;
+            }
+        }
+
+        if (b == nullptr)
+        {
+            threadUnclaimable = true;
+            return nullptr;
+        }
+
+        // a reused ring keeps its tid, so the trace shows it under the newest owner's name
+        b->name[0] = '\0';
+
+        if (threadName[0] != '\0')
+        {
+            std::memcpy(b->name, threadName, sizeof(b->name));
+        }
+        else if (auto* t = juce::Thread::getCurrentThread())
+        {
+            t->getThreadName().copyToUTF8(b->name, sizeof(b->name));
+        }
+
+        b->claimed.store(true, std::memory_order_release);
+        threadRing.buffer = b;
+        return b;
+    }
+}
+
+void Trace::setEnabled(bool shouldBeEnabled)
+{
+    if (shouldBeEnabled)
+    {
+        Registry::get().allocate();
+
+        juce::int64 expected = 0;
+        Registry::get().origin.compare_exchange_strong(expected, juce::Time::getHighResolutionTicks());
+    }
+
+    enabled.store(shouldBeEnabled, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char* name)
+{
+    // kept for a ring claimed later; one already claimed is renamed in place
+    std::strncpy(threadName, name, sizeof(threadName) - 1);
+
+    if (threadRing.buffer != nullptr)
+    {
+        std::memcpy(threadRing.buffer->name, threadName, sizeof(threadName));
+    }
+}
+
+void Trace::record(const char* name, juce::int64 beginTicks, juce::int64 endTicks)
+{
+    auto* b = getThreadBuffer();
+
+    if (b == nullptr || !b->push({ name, beginTicks, endTicks }))
+    {
+        Registry::get().dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+juce::uint64 Trace::getNumDropped()
+{
+    return Registry::get().dropped.load(std::memory_order_relaxed);
+}
+
+bool Trace::writeJson(const juce::File& file)
+{
+    juce::FileOutputStream out(file);
+
+    if (!out.openedOk())
+    {
+        return false;
+    }
+
+    out.setPosition(0);
+    out.truncate();
+
+    auto& reg = Registry::get();
+    const auto origin = reg.origin.load();
+    const auto ticksPerUs = (double)juce::Time::getHighResolutionTicksPerSecond() / 1.0e6;
+    bool first = true;
+
+    auto separator = [&]
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::lock_guard<std::mutex> l(reg.lock);
+
+    for (auto& b : reg.buffers)
+    {
+        if (!b->claimed.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        separator();
+        out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << (int)b->tid
+            << ",\"name\":\"thread_name\",\"args\":{\"name\":"
+            << juce::JSON::toString(b->name[0] != '\0' ? juce::String(b->name) : "thread " + juce::String(b->tid))
+            << "}}";
+
+        b->drain([&](const Event& e)
+        {
+            separator();
+            out << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << (int)b->tid
+                << ",\"name\":" << juce::JSON::toString(juce::String(e.name))
+                << ",\"ts\":" << juce::String((double)(e.begin - origin) / ticksPerUs, 3)
+                << ",\"dur\":" << juce::String((double)(e.end - e.begin) / ticksPerUs, 3)
+                << "}";
+        });
+    }
+
+    out << "\n]}\n";
+    out.flush();
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/* Compile-time switch; when 0 the trace macros expand to nothing. */
+#ifndef JOYCON_TRACING
+ #define JOYCON_TRACING 1
+#endif
+
+/*
+    Opt-in timeline tracing of the controller pipeline.
+
+    Each thread that records an event gets its own single-producer ring of
+    complete ("ph":"X") events, so recording never takes a lock or allocates:
+    the rings are allocated by the first setEnabled(true), which must be
+    called off the realtime threads. They are drained by writeJson(), which
+    produces a Chrome trace / Perfetto compatible JSON file. Recording is off
+    until setEnabled(true) is called; while off a trace scope costs one
+    relaxed atomic load.
+*/
+class Trace
+{
+public:
+    struct Event
+    {
+        const char* name;   // must be a string literal, it is stored by pointer
+        juce::int64 begin;
+        juce::int64 end;
+    };
+
+    static void setEnabled(bool shouldBeEnabled);
+
+    static bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /* Name shown for the calling thread's track, e.g. "audio". Realtime safe. */
+    static void setThreadName(const char* name);
+
+    static void record(const char* name, juce::int64 beginTicks, juce::int64 endTicks);
+
+    /* Drains every thread's ring into a JSON trace file. Call from a non-realtime thread. */
+    static bool writeJson(const juce::File& file);
+
+    /* Events lost because a thread's ring was full, or every ring was taken. */
+    static juce::uint64 getNumDropped();
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* n) : name(n), begin(isEnabled() ? juce::Time::getHighResolutionTicks() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (begin != 0 && isEnabled())
+            {
+                record(name, begin, juce::Time::getHighResolutionTicks());
+            }
+        }
+
+    private:
+        const char* name;
+        juce::int64 begin;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+#if JOYCON_TRACING
+ #define JOYCON_TRACE_CONCAT_(a, b) a ## b
+ #define JOYCON_TRACE_CONCAT(a, b) JOYCON_TRACE_CONCAT_(a, b)
+ #define JOYCON_TRACE_SCOPE(name) Trace::Scope JOYCON_TRACE_CONCAT(traceScope_, __LINE__) (name)
+#else
+ #define JOYCON_TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,643 @@
+/*
+    joycon-tune: picks the orientation filter's alpha and the One-Euro
+    smoothing from recorded captures instead of by ear.
+
+    Each capture (JOYCON_CAPTURE, see Capture.h) is decoded once. Every
+    candidate alpha then replays the raw IMU samples through ImuBatch, the
+    plugin's batch form of Joycon::ProcessIMU, and every One-Euro setting
+    smooths the resulting pitch and roll.
+
+    The filter's output scale follows alpha (the default mappings' 0..4.4
+    suit the default 0.05), so each alpha's output is first brought back to
+    degrees with a straight line fitted against the accelerometer's tilt on
+    still samples, and the smoothing sees it as a mapping spanning the same
+    tilt would: 88 degrees to one unit, as the defaults do. A configuration
+    is scored, in degrees, on three things to minimise:
+
+      jitter    sample to sample change while the controller is still
+      drift     how far the output settles from the tilt gravity says the
+                controller is at, over each still stretch
+      tracking  error against that tilt while moving, which both the
+                smoothing's lag and the gyro share of the filter add to
+
+    No single setting wins all three, so the result is the Pareto front: the
+    settings no other setting beats on every score at once.
+
+    The search runs on a work-stealing pool. One job per alpha builds that
+    alpha's orientation stream and fans the smoothing candidates out as
+    smaller jobs, which idle workers steal.
+*/
+
+#include "JuceHeader.h"
+#include "Capture.h"
+#include "ImuBatch.h"
+#include "OneEuroFilter.h"
+#include "WorkStealingPool.h"
+
+#include <iostream>
+
+namespace
+{
+    const char* usage =
+        "usage: joycon-tune --replay=<a.jcap>[,<b.jcap>...] [options]\n"
+        "\n"
+        "  --replay=<captures>      comma separated; the scores are over all of them\n"
+        "  --search=grid|random     search the ranges on a grid (the default) or at random\n"
+        "  --steps=<n>              grid points per parameter (default 8)\n"
+        "  --samples=<n>            random configurations (default 1000)\n"
+        "  --seed=<n>               random search seed (default 1)\n"
+        "  --alpha=<lo>..<hi>       orientation filter accelerometer weight (default 0.01..1, log spaced)\n"
+        "  --min-cutoff=<lo>..<hi>  One-Euro cutoff at rest in Hz (default 0.05..10, log spaced; the grid adds off)\n"
+        "  --beta=<lo>..<hi>        One-Euro speed coefficient (default 0..20)\n"
+        "  --derivative-cutoff=<hz> One-Euro speed smoothing (default 1)\n"
+        "  --threads=<n>            workers (default: one per core)\n"
+        "  --csv=<file>             every configuration and its scores, with the Pareto front marked\n";
+
+    constexpr float stillBelow = JitterLagScore::stillBelow;       // deg/s, as the scoring classes samples
+    constexpr float movingAbove = JitterLagScore::movingAbove;
+    constexpr int maxLagSamples = JitterLagScore::maxLagSamples;
+    constexpr int minStillRun = 100;                // samples, half a second, before a still stretch counts for drift
+    constexpr int candidatesPerJob = 8;
+    constexpr float degreesPerUnit = 88.f;          // the default mappings' span at the default alpha (4.4 / 0.05)
+
+    struct Range
+    {
+        float low = 0.f, high = 0.f;
+    };
+
+    Range parseRange(const juce::String& s, Range fallback)
+    {
+        if (s.isEmpty())
+        {
+            return fallback;
+        }
+
+        if (!s.contains(".."))
+        {
+            return { s.getFloatValue(), s.getFloatValue() };
+        }
+
+        return { s.upToFirstOccurrenceOf("..", false, false).getFloatValue(), s.fromFirstOccurrenceOf("..", false, false).getFloatValue() };
+    }
+
+    std::vector<float> gridAxis(Range r, int steps, bool logSpaced)
+    {
+        if (steps <= 1 || r.low == r.high)
+        {
+            return { r.low };
+        }
+
+        std::vector<float> values;
+        logSpaced = logSpaced && r.low > 0.f && r.high > 0.f;
+
+        for (int i = 0; i < steps; ++i)
+        {
+            const auto t = (float)i / (float)(steps - 1);
+            values.push_back(logSpaced ? r.low * std::pow(r.high / r.low, t) : r.low + (r.high - r.low) * t);
+        }
+
+        return values;
+    }
+
+    float randomIn(juce::Random& random, Range r, bool logSpaced)
+    {
+        const auto t = random.nextFloat();
+
+        if (logSpaced && r.low > 0.f && r.high > 0.f)
+        {
+            return r.low * std::pow(r.high / r.low, t);
+        }
+
+        return r.low + (r.high - r.low) * t;
+    }
+
+    //==============================================================================
+    /* A capture's raw IMU samples, and what doesn't depend on the settings being tuned. */
+    struct Recording
+    {
+        juce::String name;
+        bool isLeft = false;
+        juce::Vector3D<int16_t> neutral;
+
+        std::vector<juce::Vector3D<int16_t>> acc, gyr;
+        std::vector<float> dtSec;           // gyro integration step, from the report timer as ProcessIMU has it
+        std::vector<double> seconds;
+
+        std::vector<float> rate;            // deg/s
+        std::vector<float> tiltPitch, tiltRoll;     // the accelerometer's tilt (alpha 1), in units
+        std::vector<std::pair<int, int>> stillRuns; // [begin, end) of at least minStillRun still samples
+
+        int stillPairs = 0;
+        int movingSamples = 0;
+        double sampleMs = 5.0;
+
+        int size() const
+        {
+            return (int)seconds.size();
+        }
+    };
+
+    /* Orientation in degrees, as the filter outputs it, for one alpha through ImuBatch::process(), the path the plugin polls with. */
+    void orientation(const Recording& r, float alpha, ImuBatch& batch, std::vector<float>& pitch, std::vector<float>& roll)
+    {
+        const auto n = r.size();
+        pitch.resize((size_t)n);
+        roll.resize((size_t)n);
+
+        for (int start = 0; start < n; start += ImuBatch::maxLanes)
+        {
+            const auto end = juce::jmin(n, start + ImuBatch::maxLanes);
+            batch.clear();
+
+            for (int i = start; i < end; ++i)
+            {
+                batch.add(r.acc[(size_t)i], r.gyr[(size_t)i], r.neutral, r.isLeft, alpha, r.dtSec[(size_t)i]);
+            }
+
+            batch.process();
+
+            for (int lane = 0; lane < batch.size(); ++lane)
+            {
+                const auto o = batch.getOrientation(lane);
+                pitch[(size_t)(start + lane)] = o.x;
+                roll[(size_t)(start + lane)] = o.y;
+            }
+        }
+    }
+
+    /*
+        Least squares output = gain * tilt + offset over the still samples,
+        then the output in tilt units. The gain is the mapping range that
+        spans what one unit of tilt does at the default alpha.
+    */
+    float calibrate(const Recording& r, float alpha, std::vector<float>& output, const std::vector<float>& tilt)
+    {
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+        for (int i = 0; i < r.size(); ++i)
+        {
+            if (r.rate[(size_t)i] < stillBelow)
+            {
+                const double x = tilt[(size_t)i], y = output[(size_t)i];
+                n += 1;
+                sx += x;
+                sy += y;
+                sxx += x * x;
+                sxy += x * y;
+            }
+        }
+
+        const auto denominator = n * sxx - sx * sx;
+        auto gain = denominator > 0 ? (n * sxy - sx * sy) / denominator : 0.0;
+
+        // a capture that never holds still at different tilts can't be fitted; take the filter at its word
+        if (std::abs(gain) < 1.0e-6)
+        {
+            gain = alpha * degreesPerUnit;
+        }
+
+        const auto offset = n > 0 ? (sy - gain * sx) / n : 0.0;
+
+        for (auto& v : output)
+        {
+            v = (float)((v - offset) / gain);
+        }
+
+        return (float)gain;
+    }
+
+    std::unique_ptr<Recording> load(const juce::File& file)
+    {
+        CaptureImuStream stream;
+        if (!stream.read(file))
+        {
+            return nullptr;
+        }
+
+        auto r = std::make_unique<Recording>();
+
+        r->name = file.getFileName();
+        r->isLeft = stream.header.isLeft;
+        r->neutral = stream.getGyroNeutral();
+        r->acc = std::move(stream.acc);
+        r->gyr = std::move(stream.gyr);
+        r->dtSec = std::move(stream.dtSec);
+
+        for (auto ms : stream.timeMs)
+        {
+            r->seconds.push_back(ms * 0.001);
+        }
+
+        const auto n = r->size();
+        if (n < maxLagSamples * 2)
+        {
+            return nullptr;
+        }
+
+        r->sampleMs = 1000.0 * (r->seconds.back() - r->seconds.front()) / (double)(n - 1);
+
+        // alpha 1 leaves the accelerometer angle alone: the reference everything is measured against
+        ImuBatch batch;
+        orientation(*r, 1.f, batch, r->tiltPitch, r->tiltRoll);
+
+        for (int i = 0; i < n; ++i)
+        {
+            r->tiltPitch[(size_t)i] /= degreesPerUnit;
+            r->tiltRoll[(size_t)i] /= degreesPerUnit;
+        }
+
+        r->rate.resize((size_t)n);
+        for (int start = 0; start < n; start += ImuBatch::maxLanes)
+        {
+            const auto end = juce::jmin(n, start + ImuBatch::maxLanes);
+            batch.clear();
+
+            for (int i = start; i < end; ++i)
+            {
+                batch.add(r->acc[(size_t)i], r->gyr[(size_t)i], r->neutral, r->isLeft, 1.f, r->dtSec[(size_t)i]);
+            }
+
+            batch.process();
+
+            for (int lane = 0; lane < batch.size(); ++lane)
+            {
+                r->rate[(size_t)(start + lane)] = batch.getGyro(lane).length();
+            }
+        }
+
+        int runStart = -1;
+
+        for (int i = 0; i <= n; ++i)
+        {
+            const auto still = i < n && r->rate[(size_t)i] < stillBelow;
+
+            if (i > 0 && still && r->rate[(size_t)i - 1] < stillBelow)
+            {
+                ++r->stillPairs;
+            }
+
+            if (i >= maxLagSamples && i < n && r->rate[(size_t)i] > movingAbove)
+            {
+                ++r->movingSamples;
+            }
+
+            if (still && runStart < 0)
+            {
+                runStart = i;
+            }
+            else if (!still && runStart >= 0)
+            {
+                if (i - runStart >= minStillRun)
+                {
+                    r->stillRuns.push_back({ runStart, i });
+                }
+
+                runStart = -1;
+            }
+        }
+
+        return r;
+    }
+
+    //==============================================================================
+    struct Candidate
+    {
+        float alpha = 0.05f;
+        OneEuroParameters smoothing;
+    };
+
+    /* Sums over every capture, in units; the scores are taken from them once all are in. */
+    struct Score
+    {
+        double jitterSquares = 0;
+        int stillPairs = 0;
+        double driftSquares = 0;
+        int driftSamples = 0;
+        double trackingSquares = 0;
+        double lagMsSum = 0;                // weighted by moving samples
+        int movingSamples = 0;
+        double range = 0;                   // mean gain over the captures
+
+        double getJitter() const
+        {
+            return stillPairs > 0 ? degreesPerUnit * std::sqrt(jitterSquares / (2.0 * stillPairs)) : 0.0;
+        }
+
+        double getDrift() const
+        {
+            return driftSamples > 0 ? degreesPerUnit * std::sqrt(driftSquares / (2.0 * driftSamples)) : 0.0;
+        }
+
+        double getTracking() const
+        {
+            return movingSamples > 0 ? degreesPerUnit * std::sqrt(trackingSquares / (2.0 * movingSamples)) : 0.0;
+        }
+
+        double getLagMs() const
+        {
+            return movingSamples > 0 ? lagMsSum / movingSamples : 0.0;
+        }
+    };
+
+    struct Result
+    {
+        Candidate candidate;
+        double jitter = 0, drift = 0, tracking = 0, lagMs = 0, range = 0;
+        bool pareto = false;
+
+        bool dominates(const Result& other) const
+        {
+            return jitter <= other.jitter && drift <= other.drift && tracking <= other.tracking
+                && (jitter < other.jitter || drift < other.drift || tracking < other.tracking);
+        }
+    };
+
+    /* An alpha's pitch and roll in units, one per capture, shared by the jobs scoring its smoothing. */
+    struct Streams
+    {
+        std::vector<std::vector<float>> pitch, roll;
+        double range = 0;
+    };
+
+    void score(const Recording& r, const std::vector<float>& pitch, const std::vector<float>& roll,
+               const OneEuroParameters& smoothing, std::vector<float>& outPitch, std::vector<float>& outRoll, Score& s)
+    {
+        const auto n = r.size();
+        outPitch.resize((size_t)n);
+        outRoll.resize((size_t)n);
+
+        OneEuroBank bank;
+        bank.configure({ smoothing, smoothing });
+
+        for (int i = 0; i < n; ++i)
+        {
+            float v[2] = { pitch[(size_t)i], roll[(size_t)i] };
+            bank.process(v, i > 0 ? (float)(r.seconds[(size_t)i] - r.seconds[(size_t)i - 1]) : 0.f);
+            outPitch[(size_t)i] = v[0];
+            outRoll[(size_t)i] = v[1];
+        }
+
+        // where each still stretch settles, against gravity's tilt; the means average the sensor noise out of both
+        for (auto [begin, end] : r.stillRuns)
+        {
+            double p = 0, q = 0;
+
+            for (int i = begin; i < end; ++i)
+            {
+                p += outPitch[(size_t)i] - r.tiltPitch[(size_t)i];
+                q += outRoll[(size_t)i] - r.tiltRoll[(size_t)i];
+            }
+
+            const auto length = end - begin;
+            s.driftSquares += (juce::square(p / length) + juce::square(q / length)) * length;
+            s.driftSamples += length;
+        }
+
+        // jitter while still, and the error against the tilt while moving: at no delay the tracking score, the least the lag
+        JitterLagScore js;
+        js.add(outPitch.data(), outRoll.data(), r.tiltPitch.data(), r.tiltRoll.data(), r.rate.data(), n);
+
+        s.jitterSquares += js.jitterSquares;
+        s.stillPairs += js.stillPairs;
+        s.trackingSquares += js.errorSquares[0];
+        s.lagMsSum += js.getLagSamples() * r.sampleMs * js.movingSamples;
+        s.movingSamples += js.movingSamples;
+    }
+
+    void markParetoFront(std::vector<Result>& results)
+    {
+        for (auto& r : results)
+        {
+            r.pareto = std::none_of(results.begin(), results.end(), [&r](const Result& other) { return other.dominates(r); });
+        }
+    }
+
+    const char* tableHeader = " alpha  range  min cutoff Hz    beta   jitter deg   drift deg   tracking deg   lag ms";
+
+    juce::String toRow(const Result& r)
+    {
+        const auto& s = r.candidate.smoothing;
+
+        return juce::String(r.candidate.alpha, 3).paddedLeft(' ', 6)
+             + juce::String(r.range, 2).paddedLeft(' ', 7)
+             + (s.isEnabled() ? juce::String(s.minCutoff, 2) : juce::String("off")).paddedLeft(' ', 15)
+             + (s.isEnabled() ? juce::String(s.beta, 2) : juce::String("-")).paddedLeft(' ', 8)
+             + juce::String(r.jitter, 4).paddedLeft(' ', 13)
+             + juce::String(r.drift, 3).paddedLeft(' ', 12)
+             + juce::String(r.tracking, 2).paddedLeft(' ', 15)
+             + juce::String(r.lagMs, 1).paddedLeft(' ', 9);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    juce::ScopedJuceInitialiser_GUI scopedJuce;
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    std::vector<juce::File> files;
+
+    for (auto& path : juce::StringArray::fromTokens(args.getValueForOption("--replay"), ",", ""))
+    {
+        files.push_back(cwd.getChildFile(path.trim()));
+    }
+
+    if (files.empty())
+    {
+        std::cerr << usage;
+        return 1;
+    }
+
+    const auto alphaRange = parseRange(args.getValueForOption("--alpha"), { 0.01f, 1.f });
+    const auto cutoffRange = parseRange(args.getValueForOption("--min-cutoff"), { 0.05f, 10.f });
+    const auto betaRange = parseRange(args.getValueForOption("--beta"), { 0.f, 20.f });
+    const auto derivativeCutoff = args.containsOption("--derivative-cutoff") ? args.getValueForOption("--derivative-cutoff").getFloatValue() : 1.f;
+
+    // the plugin's defaults first, for comparison
+    std::vector<Candidate> candidates { Candidate() };
+
+    if (args.getValueForOption("--search") == "random")
+    {
+        const auto samples = args.containsOption("--samples") ? args.getValueForOption("--samples").getIntValue() : 1000;
+        juce::Random random(args.containsOption("--seed") ? args.getValueForOption("--seed").getIntValue() : 1);
+
+        for (int i = 0; i < samples; ++i)
+        {
+            Candidate c;
+            c.alpha = randomIn(random, alphaRange, true);
+            c.smoothing = { randomIn(random, cutoffRange, true), randomIn(random, betaRange, false), derivativeCutoff };
+            candidates.push_back(c);
+        }
+    }
+    else
+    {
+        const auto steps = args.containsOption("--steps") ? args.getValueForOption("--steps").getIntValue() : 8;
+
+        for (auto alpha : gridAxis(alphaRange, steps, true))
+        {
+            candidates.push_back({ alpha, OneEuroParameters() });
+
+            for (auto cutoff : gridAxis(cutoffRange, steps, true))
+            {
+                for (auto beta : gridAxis(betaRange, steps, false))
+                {
+                    candidates.push_back({ alpha, { cutoff, beta, derivativeCutoff } });
+                }
+            }
+        }
+    }
+
+    WorkStealingPool pool(args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue()
+                                                           : juce::SystemStats::getNumCpus());
+    const auto started = juce::Time::getMillisecondCounterHiRes();
+
+    // decode every capture once
+    std::vector<std::unique_ptr<Recording>> recordings(files.size());
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        pool.submit([&, i] { recordings[i] = load(files[i]); });
+    }
+
+    pool.wait();
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (recordings[i] == nullptr)
+        {
+            std::cerr << "no usable IMU data in " << files[i].getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    const auto loadedMs = juce::Time::getMillisecondCounterHiRes() - started;
+
+    // one job per alpha, fanning its smoothing candidates out in small jobs
+    std::map<float, std::vector<int>> byAlpha;
+    for (int i = 0; i < (int)candidates.size(); ++i)
+    {
+        byAlpha[candidates[(size_t)i].alpha].push_back(i);
+    }
+
+    std::vector<Score> scores(candidates.size());
+
+    for (auto& group : byAlpha)
+    {
+        const auto alpha = group.first;
+        const auto* members = &group.second;
+
+        pool.submit([&, alpha, members]
+        {
+            // freed with the last of this alpha's jobs
+            auto streams = std::make_shared<Streams>();
+            streams->pitch.resize(recordings.size());
+            streams->roll.resize(recordings.size());
+
+            ImuBatch batch;
+            for (size_t r = 0; r < recordings.size(); ++r)
+            {
+                const auto& recording = *recordings[r];
+                orientation(recording, alpha, batch, streams->pitch[r], streams->roll[r]);
+
+                streams->range += calibrate(recording, alpha, streams->pitch[r], recording.tiltPitch) / (double)recordings.size();
+                calibrate(recording, alpha, streams->roll[r], recording.tiltRoll);
+            }
+
+            for (size_t start = 0; start < members->size(); start += candidatesPerJob)
+            {
+                pool.submit([&, streams, members, start]
+                {
+                    std::vector<float> outPitch, outRoll;
+                    const auto end = juce::jmin(members->size(), start + (size_t)candidatesPerJob);
+
+                    for (auto m = start; m < end; ++m)
+                    {
+                        const auto index = (size_t)(*members)[m];
+                        scores[index].range = streams->range;
+
+                        for (size_t r = 0; r < recordings.size(); ++r)
+                        {
+                            score(*recordings[r], streams->pitch[r], streams->roll[r], candidates[index].smoothing, outPitch, outRoll, scores[index]);
+                        }
+                    }
+                });
+            }
+        });
+    }
+
+    pool.wait();
+    const auto elapsedMs = juce::Time::getMillisecondCounterHiRes() - started;
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        results.push_back({ candidates[i], scores[i].getJitter(), scores[i].getDrift(), scores[i].getTracking(), scores[i].getLagMs(), scores[i].range });
+    }
+
+    markParetoFront(results);
+
+    //==============================================================================
+    double seconds = 0;
+    int stillPairs = 0, moving = 0;
+
+    for (auto& r : recordings)
+    {
+        seconds += r->seconds.back() - r->seconds.front();
+        stillPairs += r->stillPairs;
+        moving += r->movingSamples;
+    }
+
+    const auto stats = pool.getStats();
+
+    std::cout << (int)files.size() << " capture(s), " << juce::String(seconds / 60.0, 1) << " min, " << stillPairs << " still and "
+              << moving << " moving samples\n";
+    std::cout << candidates.size() << " configurations over " << byAlpha.size() << " alphas in " << juce::String(elapsedMs * 0.001, 2)
+              << "s (decoding " << juce::String(loadedMs * 0.001, 2) << "s) on " << pool.getNumThreads() << " threads: "
+              << (juce::int64)stats.jobs << " jobs, " << (juce::int64)stats.stolen << " stolen, "
+              << juce::String(stats.cpuSeconds / juce::jmax(1.0e-3, elapsedMs * 0.001), 1) << "x one core\n";
+    std::cout << "range: the pitch mapping range that spans, at that alpha, the tilt 0..4.4 spans at the default 0.05\n\n";
+
+    std::vector<Result> front;
+    std::copy_if(results.begin(), results.end(), std::back_inserter(front), [](const Result& r) { return r.pareto; });
+    std::sort(front.begin(), front.end(), [](const Result& a, const Result& b) { return a.jitter < b.jitter; });
+
+    std::cout << "Pareto front, " << front.size() << " of " << results.size() << ", lowest jitter first:\n";
+    std::cout << tableHeader << "\n";
+
+    for (auto& r : front)
+    {
+        std::cout << toRow(r) << "\n";
+    }
+
+    std::cout << "\nplugin default (" << (results.front().pareto ? "on" : "off") << " the front):\n" << toRow(results.front()) << std::endl;
+
+    if (args.containsOption("--csv"))
+    {
+        juce::String csv = "alpha,range,min_cutoff,beta,derivative_cutoff,jitter_deg,drift_deg,tracking_deg,lag_ms,pareto\n";
+
+        for (auto& r : results)
+        {
+            const auto& s = r.candidate.smoothing;
+            csv << r.candidate.alpha << "," << r.range << "," << s.minCutoff << "," << s.beta << "," << s.derivativeCutoff << ","
+                << r.jitter << "," << r.drift << "," << r.tracking << "," << r.lagMs << "," << (r.pareto ? 1 : 0) << "\n";
+        }
+
+        const auto file = cwd.getChildFile(args.getValueForOption("--csv"));
+
+        if (!file.replaceWithText(csv))
+        {
+            std::cerr << "can't write " << file.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
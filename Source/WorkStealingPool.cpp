@@ -0,0 +1,160 @@
+#include "WorkStealingPool.h"
+#include "CpuTime.h"
+
+class WorkStealingPool::Worker : public juce::Thread
+{
+public:
+    Worker(WorkStealingPool& p, int i)
+        : juce::Thread("worker " + juce::String(i)), pool(p), index(i)
+    {
+    }
+
+    void run() override
+    {
+        current = this;
+        std::function<void()> job;
+
+        while (!threadShouldExit())
+        {
+            if (pool.takeJob(index, job))
+            {
+                const auto start = getThreadCpuSeconds();
+                job();
+                job = nullptr;
+
+                pool.cpuMicroseconds.fetch_add((juce::int64)((getThreadCpuSeconds() - start) * 1.0e6), std::memory_order_relaxed);
+                pool.jobs.fetch_add(1, std::memory_order_relaxed);
+
+                if (pool.pending.fetch_sub(1) == 1)
+                {
+                    // taken so wait() can't check pending and sleep between the decrement and the notify
+                    std::lock_guard<std::mutex> l(pool.doneLock);
+                    pool.done.notify_all();
+                }
+
+                continue;
+            }
+
+            std::unique_lock<std::mutex> l(pool.sleepLock);
+            pool.wake.wait(l, [this] { return pool.queued.load() > 0 || threadShouldExit(); });
+        }
+
+        current = nullptr;
+    }
+
+    static thread_local Worker* current;
+
+    WorkStealingPool& pool;
+    const int index;
+
+    std::mutex dequeLock;
+    std::deque<std::function<void()>> deque;    // the owner takes the back, thieves the front
+};
+
+thread_local WorkStealingPool::Worker* WorkStealingPool::Worker::current = nullptr;
+
+WorkStealingPool::WorkStealingPool(int numThreads)
+{
+    for (int i = 0; i < juce::jmax(1, numThreads); ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+    }
+
+    for (auto& w : workers)
+    {
+        w->startThread();
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> l(sleepLock);
+        for (auto& w : workers)
+        {
+            w->signalThreadShouldExit();
+        }
+    }
+
+    wake.notify_all();
+
+    for (auto& w : workers)
+    {
+        w->stopThread(5000);
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> job)
+{
+    auto* own = Worker::current;
+    auto& worker = own != nullptr && &own->pool == this ? *own
+                                                        : *workers[(size_t)(nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size())];
+
+    pending.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> l(worker.dequeLock);
+        worker.deque.push_back(std::move(job));
+    }
+
+    {
+        // a worker checks queued under sleepLock before it sleeps, so this can't slip in between
+        std::lock_guard<std::mutex> l(sleepLock);
+        queued.fetch_add(1);
+    }
+
+    wake.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    jassert(Worker::current == nullptr || &Worker::current->pool != this);     // would wait for itself
+
+    std::unique_lock<std::mutex> l(doneLock);
+    done.wait(l, [this] { return pending.load() == 0; });
+}
+
+bool WorkStealingPool::takeJob(int index, std::function<void()>& job)
+{
+    {
+        auto& own = *workers[(size_t)index];
+        std::lock_guard<std::mutex> l(own.dequeLock);
+
+        if (!own.deque.empty())
+        {
+            job = std::move(own.deque.back());
+            own.deque.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // the others in turn, starting from the next one so thieves don't all pile onto worker 0
+    const auto n = (int)workers.size();
+
+    for (int i = 1; i < n; ++i)
+    {
+        auto& victim = *workers[(size_t)((index + i) % n)];
+        std::lock_guard<std::mutex> l(victim.dequeLock);
+
+        if (!victim.deque.empty())
+        {
+            job = std::move(victim.deque.front());
+            victim.deque.pop_front();
+            queued.fetch_sub(1);
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+WorkStealingPool::Stats WorkStealingPool::getStats() const
+{
+    Stats s;
+    s.jobs = jobs.load(std::memory_order_relaxed);
+    s.stolen = stolen.load(std::memory_order_relaxed);
+    s.cpuSeconds = (double)cpuMicroseconds.load(std::memory_order_relaxed) * 1.0e-6;
+    return s;
+}
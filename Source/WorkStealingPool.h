@@ -0,0 +1,64 @@
+#pragma once
+
+#include "JuceHeader.h"
+
+/*
+    A fixed set of worker threads for offline batch work (parameter searches
+    over captures), one per core by default.
+
+    Each worker has its own deque. A job submitted from a worker goes on that
+    worker's deque, which it runs newest first while the data it just touched
+    is still in cache; a worker whose deque is empty steals the oldest job
+    from another, so a job that fans out into smaller ones spreads across the
+    pool without a shared queue everyone contends on. Idle workers sleep on a
+    condition variable until there is something to run.
+
+    Not for the audio or poll threads: submitting allocates and locks.
+*/
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int numThreads = juce::SystemStats::getNumCpus());
+    ~WorkStealingPool();
+
+    int getNumThreads() const
+    {
+        return (int)workers.size();
+    }
+
+    /* Any thread, including a job of this pool. */
+    void submit(std::function<void()> job);
+
+    /* Blocks until every job submitted so far, and every job those submitted, has finished. Not from a job. */
+    void wait();
+
+    struct Stats
+    {
+        juce::uint64 jobs = 0;              // run to completion
+        juce::uint64 stolen = 0;            // of those, run by a worker other than the one they were queued on
+        double cpuSeconds = 0;              // the jobs' thread CPU time, for the speedup over one core
+    };
+
+    Stats getStats() const;
+
+private:
+    class Worker;
+
+    bool takeJob(int worker, std::function<void()>& job);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<juce::uint32> nextWorker { 0 };     // round robin for jobs from outside the pool
+
+    std::mutex sleepLock;
+    std::condition_variable wake;                   // idle workers, for a new job or shutdown
+    std::atomic<int> queued { 0 };                  // in any deque
+
+    std::mutex doneLock;
+    std::condition_variable done;                   // wait(), for pending to reach 0
+    std::atomic<juce::int64> pending { 0 };         // submitted and not yet finished
+
+    std::atomic<juce::uint64> jobs { 0 }, stolen { 0 };
+    std::atomic<juce::int64> cpuMicroseconds { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkStealingPool)
+};
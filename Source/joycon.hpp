@@ -1,31 +1,79 @@
+#pragma once
+
 #include "JuceHeader.h"
+#include "Geometry.h"
 #include "hidapi.h"
-
-class Joycon
+#include "Trace.h"
+#include "Telemetry.h"
+#include "HidTransport.h"
+#include "HidrawHub.h"
+#include "CpuTime.h"
+#include "ThreadTuning.h"
+#include "AllocationCounter.h"
+#include "ImuBatch.h"
+#include "GestureEngine.h"
+#include "Capture.h"
+#include "StickShaper.h"
+#include "DeviceClock.h"
+#include "Scheduler.h"
+#include "Snapshot.h"
+
+class Joycon : private HidrawHub::Client
 {
 public:
     Joycon() :
-    isLeft(false), hid_dev(nullptr), imu_enabled(true), do_localize(true),
-    alpha(0.05f), rumble_obj(160, 320, 0), pollThread(*this)
+    isLeft(false), imu_enabled(true), do_localize(true),
+    config(InitialConfig(0.05f)), rumble_obj(160, 320, 0), pollThread(*this)
     {
     }
 
-	Joycon(hid_device* dev, bool imu, bool localize, float _alpha, bool left) :
-    isLeft(left), hid_dev(dev), imu_enabled(imu), do_localize (localize),
-    alpha(_alpha), rumble_obj(160, 320, 0), pollThread(*this)
+	Joycon(std::unique_ptr<HidTransport> t, bool imu, bool localize, float _alpha, bool left, juce::String path = {}) :
+    isLeft(left), transport(std::move(t)), imu_enabled(imu), do_localize (localize),
+    config(InitialConfig(_alpha)), rumble_obj(160, 320, 0), device_path(path), pollThread(*this)
     {
     }
 
-    ~Joycon()
+    ~Joycon() override
     {
         Detach();
     }
 
     void Begin()
     {
+        const std::lock_guard<std::mutex> l(service_lock);
+
+        if (hub != nullptr && hub->add(*this))
+        {
+            return;
+        }
+
         pollThread.startThread(juce::Thread::Priority::highest);
     }
 
+    /* Lets a shared epoll hub service this controller instead of its own poll thread. Call before Begin(). */
+    void SetHub(HidrawHub* h)
+    {
+        hub = h;
+    }
+
+    /* Scheduling applied by the poll thread when it starts. Call before Begin(). */
+    void SetRealtimeConfig(const RealtimeConfig& c)
+    {
+        rt_config = c;
+    }
+
+    /* CPU time of this controller's own poll thread; 0 while it is serviced by a hub. */
+    double GetPollCpuSeconds() const
+    {
+        return poll_cpu_seconds.load(std::memory_order_relaxed);
+    }
+
+    /* Reports lost because Update() did not drain the queue in time. */
+    juce::uint32 GetQueueOverflows() const
+    {
+        return queue_overflows.load(std::memory_order_relaxed);
+    }
+
     void SetRumble(float low_freq, float high_freq, float amp, uint time = 0)
     {
         if (state <= state_::ATTACHED)
@@ -46,7 +94,14 @@ public:
         /* set input report mode, simple push on button press */
         // Subcommand(0x3, {0x3f}, false);
 
-        dumpCalibrationData();
+        if (calibration_restored)
+        {
+            DebugPrint("Using saved calibration data.", DebugType::COMMS);
+        }
+        else
+        {
+            dumpCalibrationData();
+        }
 
         /* pairing info */
         // Subcommand(0x1, {0x01}, 1);
@@ -69,14 +124,123 @@ public:
         pitchRollYaw.y = 0;
         pitchRollYaw.z = 0;
 
+        leds = leds_;
+
         DebugPrint("Done with init", DebugType::COMMS);
 
         return true;
     }
 
+    /*
+        Fast path after a dropout: the calibration read by Attach() is kept, so
+        only the report mode / sensor configuration that the controller forgets
+        on disconnect is sent again.
+    */
+    bool Resume()
+    {
+        state = state_::ATTACHED;
+
+        Subcommand(0x30, {leds}, false);
+        Subcommand(0x40, {(imu_enabled ? (uint8_t)0x1 : (uint8_t)0x0)}, false);
+        Subcommand(0x3, {0x30}, false);
+        Subcommand(0x48, {0x1}, false);
+
+        DebugPrint("Resumed after dropout", DebugType::COMMS);
+
+        return true;
+    }
+
+    /*
+        Hint that the controller is back, e.g. from the device watcher. The path
+        may differ from before (hidraw nodes are renumbered on reconnect); the
+        poll thread picks it up and retries immediately instead of waiting out
+        its backoff.
+    */
+    void ReconnectNow(const juce::String& path)
+    {
+        {
+            juce::ScopedLock l(path_lock);
+            if (path.isNotEmpty())
+            {
+                device_path = path;
+            }
+        }
+
+        pollThread.notify();
+    }
+
+    bool IsReconnecting() const
+    {
+        return state == state_::DROPPED || state == state_::RECONNECTING;
+    }
+
+    /* Calibration read from the controller's SPI flash by Attach(). */
+    struct Calibration
+    {
+        std::array<uint16_t, 6> stick {};
+        uint16_t deadzone = 0;
+        juce::Vector3D<int16_t> gyroNeutral;
+    };
+
+    Calibration GetCalibration() const
+    {
+        return { stick_cal, deadzone, gyr_neutral };
+    }
+
+    /* Call before Attach() to skip reading calibration from the controller, e.g. when restoring a session. */
+    void SetCalibration(const Calibration& c)
+    {
+        stick_cal = c.stick;
+        deadzone = c.deadzone;
+        gyr_neutral = c.gyroNeutral;
+        calibration_restored = true;
+        PublishConfig(GetSettings());
+    }
+
+    /* Orientation filter and stick response, swapped as one snapshot under the running poll cycle. */
+    struct Settings
+    {
+        float alpha = 0.05f;                // accelerometer weight in the orientation filter
+        StickResponse stick;
+    };
+
+    /* Any non-realtime thread. Rebuilds the stick tables here; Update() picks the result up on its next call. */
+    void SetSettings(const Settings& s)
+    {
+        PublishConfig(s);
+    }
+
+    Settings GetSettings() const
+    {
+        return config.get().settings;
+    }
+
+    void SetStickResponse(const StickResponse& r)
+    {
+        auto s = GetSettings();
+        s.stick = r;
+        PublishConfig(s);
+    }
+
+    struct ConnectionStats
+    {
+        std::atomic<juce::uint32> drops { 0 };
+        std::atomic<juce::uint32> reconnects { 0 };
+        std::atomic<juce::uint32> failedAttempts { 0 };
+        std::atomic<juce::int64> lastRecoveryMs { 0 };    // dropout detected -> first report after resume
+        std::atomic<juce::int64> maxRecoveryMs { 0 };
+    };
+
+    const ConnectionStats& GetConnectionStats() const
+    {
+        return connection_stats;
+    }
+
     void SetFilterCoeff(float a)
     {
-        alpha = a;
+        auto s = GetSettings();
+        s.alpha = a;
+        PublishConfig(s);
     }
 
     void Detach()
@@ -85,31 +249,45 @@ public:
         PrintArray(max, DebugType::IMU);
         PrintArray(sum, DebugType::IMU);
 
-        if (state > state_::NO_JOYCONS)
+        // a hand-off between the hub and the poll thread in progress finishes here; later ones see stop_polling
         {
-            Subcommand(0x30, std::vector<uint8_t> { 0x0 });
-            Subcommand(0x40, std::vector<uint8_t> { 0x0 });
-            Subcommand(0x48, std::vector<uint8_t> { 0x0 });
-            Subcommand(0x3, std::vector<uint8_t> { 0x3f });
+            const std::lock_guard<std::mutex> l(service_lock);
         }
 
+        // stop the poll thread first, it could otherwise hand us back to the hub after we left it
         if(pollThread.isThreadRunning())
         {
             DebugPrint("End poll thread.", DebugType::THREADING);
+            pollThread.signalThreadShouldExit();
+            pollThread.notify();
             pollThread.stopThread(1000);
         }
 
-        if (state > state_::DROPPED)
+        if (hub != nullptr)
         {
-            hid_close(hid_dev);
+            hub->remove(*this);
         }
 
+        if (state > state_::NO_JOYCONS)
+        {
+            Subcommand(0x30, { 0x0 });
+            Subcommand(0x40, { 0x0 });
+            Subcommand(0x48, { 0x0 });
+            Subcommand(0x3, { 0x3f });
+        }
+
+        transport.reset();
+
         state = state_::NOT_ATTACHED;
     }
 
-    void Update()
+    /*
+        With a batch, IMU samples are queued into it instead of going through
+        ProcessIMU(); run batch.process() and then ApplyImuBatch() to finish.
+    */
+    void Update(ImuBatch* batch = nullptr)
     {
-        if (stop_polling || (state <= state_::NO_JOYCONS))
+        if (stop_polling || (state == state_::NOT_ATTACHED))
         {
             if(pollThread.isThreadRunning())
             {
@@ -120,32 +298,43 @@ public:
 
         if (state > state_::NO_JOYCONS)
         {
-            juce::CriticalSection critical;
-            juce::ScopedLock scoped_lock(critical);
+            ScopedAllocationCheck steady_state("Joycon::Update");
 
-            Report rep;
+            const SnapshotCell<Config>::ScopedRead current_config(config_reader);
+            active_config = &*current_config;
 
             bool update = false;
 
-            while (!reports.empty())
+            while (auto* slot = reports.Front())
             {
                 update = true;
 
-                rep = reports.front();
+                const uint8_t* r = slot->r.data();
+                const double t_ms = (double)slot->t.toMilliseconds();
+
+                device_ms = device_clock.align(r[1], slot->arrival_ms);
+
+                if (capture != nullptr)
+                {
+                    capture->write(t_ms, r, (int)report_len);
+                }
 
                 if (imu_enabled)
                 {
                     if (do_localize)
                     {
-                        ProcessIMU(rep.r);
+                        if (batch == nullptr || !CollectIMU(r, *batch, t_ms))
+                        {
+                            ProcessIMU(r, t_ms);
+                        }
                     }
                     else
                     {
-                        ExtractIMUValues(rep.r, 0);
+                        ExtractIMUValues(r, 0);
                     }
                 }
 
-                if (ts_de == rep.r[1])
+                if (ts_de == r[1] && IsDebugEnabled(DebugType::THREADING))
                 {
                     std::stringstream ss;
                     ss << "Duplicate timestamp dequeued. TS: ";
@@ -153,33 +342,187 @@ public:
                     DebugPrint(ss.str(), DebugType::THREADING);
                 }
 
-                std::stringstream ss;
-                ts_de = rep.r[1];
-                ss << "Dequeue. Queue length: " << reports.size();
-                ss << ". Packet ID: " << std::hex << std::setfill('0') << std::setw(2) << +rep.r[0];
-                ss << ". Timestamp: " << std::hex << std::setfill('0') << std::setw(2) << +rep.r[1];
-                ss << ". Lag to dequeue: " <<  (juce::Time::getCurrentTime() - rep.GetTime()).inMilliseconds();
-                ss << ". Lag between packets (expect 15ms): ";
-                ss << (juce::Time::getCurrentTime() - ts_prev).inMilliseconds();
-                DebugPrint(ss.str(), DebugType::THREADING);
-                ts_prev = rep.GetTime();
+                if (telemetry != nullptr)
+                {
+                    telemetry->dequeueLag.record((double)(juce::Time::getCurrentTime() - slot->t).inMilliseconds());
+                    telemetry->packetInterval.record((double)(slot->t - ts_prev).inMilliseconds());
+                }
+
+                ts_de = r[1];
+
+                if (IsDebugEnabled(DebugType::THREADING))
+                {
+                    std::stringstream ss;
+                    ss << "Dequeue. Queue length: " << reports.Size();
+                    ss << ". Packet ID: " << std::hex << std::setfill('0') << std::setw(2) << +r[0];
+                    ss << ". Timestamp: " << std::hex << std::setfill('0') << std::setw(2) << +r[1];
+                    ss << ". Lag to dequeue: " <<  (juce::Time::getCurrentTime() - slot->t).inMilliseconds();
+                    ss << ". Lag between packets (expect 15ms): ";
+                    ss << (juce::Time::getCurrentTime() - ts_prev).inMilliseconds();
+                    DebugPrint(ss.str(), DebugType::THREADING);
+                }
+
+                ts_prev = slot->t;
+                last_report = slot->r;
 
-                reports.pop();
+                reports.Pop();
             }
 
             if (update)
-                ProcessButtonsAndStick(rep.r);
+            {
+                ProcessButtonsAndStick(last_report.data());
+
+                if (batch == nullptr)
+                {
+                    PublishTelemetry();
+                }
+                else
+                {
+                    publish_pending = true;
+                }
+            }
+        }
+    }
+
+    /* Reads back the lanes this controller queued during Update(batch). */
+    void ApplyImuBatch(const ImuBatch& batch)
+    {
+        for (int lane = batch_first; lane >= 0 && lane <= batch_last; ++lane)
+        {
+            auto delta = batch.getGyroDelta(lane);
+            sum[0] += delta.x;
+            sum[1] += delta.y;
+            sum[2] += delta.z;
+
+            // max holds the values before mirroring, as in ExtractIMUValues
+            auto acc = batch.getAccel(lane);
+            if (batch.isMirrored(lane))
+            {
+                acc.y = -acc.y;
+                acc.z = -acc.z;
+            }
+
+            if (std::abs(acc.x) > std::abs(max[0])) max[0] = acc.x;
+            if (std::abs(acc.y) > std::abs(max[1])) max[1] = acc.y;
+            if (std::abs(acc.z) > std::abs(max[2])) max[2] = acc.z;
+
+            if (gestures != nullptr)
+            {
+                gestures->push({ batch.getTime(lane), batch.getAccel(lane), batch.getGyro(lane) });
+            }
+
+            PublishImuSample(batch.getTime(lane), batch.getRawAccel(lane), batch.getRawGyro(lane),
+                             batch.getAccel(lane), batch.getGyro(lane), batch.getOrientation(lane));
+        }
+
+        // a full batch falls back to ProcessIMU(), whose result is newer
+        if (batch_first >= 0 && !batch_overflowed)
+        {
+            acc_g = batch.getAccel(batch_last);
+            gyr_g = batch.getGyro(batch_last);
+            pitchRollYaw = batch.getOrientation(batch_last);
+        }
+
+        batch_first = -1;
+        batch_last = -1;
+        batch_overflowed = false;
+
+        if (publish_pending)
+        {
+            publish_pending = false;
+            PublishTelemetry();
+        }
+    }
+
+    /* Slot that Update() publishes processed state into; must outlive this Joycon or be reset to nullptr. */
+    void SetTelemetry(Telemetry* t)
+    {
+        telemetry = t;
+    }
+
+    /* Receives every calibrated IMU sample from Update(); must outlive this Joycon or be reset to nullptr. */
+    void SetGestureEngine(GestureEngine* g)
+    {
+        gestures = g;
+    }
+
+    /* Records every report Update() dequeues; same lifetime rules as SetGestureEngine(). */
+    void SetCapture(CaptureWriter* c)
+    {
+        capture = c;
+    }
+
+    /*
+        Calibrated sample n (0..2) of a 0x30 report, mirrored for the left
+        Joy-Con. The report carries 5 ms apart samples, the last one newest.
+    */
+    static ImuSample DecodeIMUSample(const uint8_t* report_buf, size_t n, const juce::Vector3D<int16_t>& gyro_neutral,
+                                     bool left, double report_ms)
+    {
+        juce::Vector3D<int16_t> acc, gyr;
+        DecodeRawIMU(report_buf, n, acc, gyr);
+
+        ImuSample s;
+        s.timeMs = report_ms - (double)(2 - n) * 5.0;
+        s.acc = { acc.x * 0.000244f, acc.y * 0.000244f, acc.z * 0.000244f };
+        s.gyr = { (gyr.x - gyro_neutral.x) * 0.070f, (gyr.y - gyro_neutral.y) * 0.070f, (gyr.z - gyro_neutral.z) * 0.070f };
+
+        if (left)
+        {
+            s.acc.y = -s.acc.y;
+            s.acc.z = -s.acc.z;
+            s.gyr.y = -s.gyr.y;
+            s.gyr.z = -s.gyr.z;
         }
+
+        return s;
+    }
+
+    static void DecodeRawIMU(const uint8_t* report_buf, size_t n, juce::Vector3D<int16_t>& acc, juce::Vector3D<int16_t>& gyr)
+    {
+        gyr.x = (int16_t)((int16_t)report_buf[19 + n * 12] + ((report_buf[20 + n * 12] << 8) & 0xff00));
+        gyr.y = (int16_t)((int16_t)report_buf[21 + n * 12] + ((report_buf[22 + n * 12] << 8) & 0xff00));
+        gyr.z = (int16_t)((int16_t)report_buf[23 + n * 12] + ((report_buf[24 + n * 12] << 8) & 0xff00));
+        acc.x = (int16_t)((int16_t)report_buf[13 + n * 12] + ((report_buf[14 + n * 12] << 8) & 0xff00));
+        acc.y = (int16_t)((int16_t)report_buf[15 + n * 12] + ((report_buf[16 + n * 12] << 8) & 0xff00));
+        acc.z = (int16_t)((int16_t)report_buf[17 + n * 12] + ((report_buf[18 + n * 12] << 8) & 0xff00));
+    }
+
+    /* Raw 12 bit stick x and y of an input report, before calibration. */
+    static std::array<uint16_t, 2> DecodeStick(const uint8_t* report_buf, bool left)
+    {
+        const auto* raw = report_buf + 6 + (left ? 0 : 3);
+        return { (uint16_t)(raw[0] + ((raw[1] & 0xf) << 8)), (uint16_t)((raw[1] >> 4) + (raw[2] << 4)) };
     }
 
-    juce::Vector3D<float> getPitchRollYaw()
+    /* Held buttons of an input report, bit n for Button n (as TelemetrySample::buttons). */
+    static juce::uint32 DecodeButtons(const uint8_t* report_buf, bool left)
     {
-        auto tmp = pitchRollYaw / 4.4f;
-        tmp.x = juce::jlimit<float>(0, 1, tmp.x);
-        tmp.y = juce::jlimit<float>(0, 1, (tmp.y / 2) + 0.5f);
-        tmp.z = juce::jlimit<float>(0, 1, (tmp.z / 2) + 0.5f);
+        const auto side = report_buf[3 + (left ? 2 : 0)];
+        juce::uint32 held = 0;
+
+        auto set = [&held](Button b, bool down) { held |= (down ? 1u : 0u) << (int)b; };
+
+        set(Button::DPAD_DOWN, (side & (left ? 0x01 : 0x04)) != 0);
+        set(Button::DPAD_RIGHT, (side & (left ? 0x04 : 0x08)) != 0);
+        set(Button::DPAD_UP, (side & 0x02) != 0);
+        set(Button::DPAD_LEFT, (side & (left ? 0x08 : 0x01)) != 0);
+        set(Button::HOME, (report_buf[4] & 0x10) != 0);
+        set(Button::MINUS, (report_buf[4] & 0x01) != 0);
+        set(Button::PLUS, (report_buf[4] & 0x02) != 0);
+        set(Button::STICK, (report_buf[4] & (left ? 0x08 : 0x04)) != 0);
+        set(Button::SHOULDER_1, (side & 0x40) != 0);
+        set(Button::SHOULDER_2, (side & 0x80) != 0);
+        set(Button::SR, (side & 0x10) != 0);
+        set(Button::SL, (side & 0x20) != 0);
+
+        return held;
+    }
 
-        return tmp;
+    /* Complementary filter output, unscaled. Ranges and curves are up to the mapping. */
+    juce::Vector3D<float> GetOrientation()
+    {
+        return pitchRollYaw;
     }
 
 
@@ -193,10 +536,25 @@ public:
         RUMBLE,
     };
 
+    /* Bit n enables DebugType n. Only ALL is printed by default, the per-report types are far too chatty. */
+    void SetDebugMask(juce::uint32 mask)
+    {
+        debug_mask = mask;
+    }
+
+    /*
+        Connection state machine, owned by the poll thread once Begin() is called:
+
+        ATTACHED -> IMU_DATA_OK         first report arrives
+        IMU_DATA_OK -> DROPPED          read error or ~5s without reports, device handle closed
+        DROPPED -> RECONNECTING         reopen attempts with exponential backoff
+        RECONNECTING -> ATTACHED        reopened, Resume() reapplies the report mode
+    */
     enum state_
     {
         NOT_ATTACHED,
         DROPPED,
+        RECONNECTING,
         NO_JOYCONS,
         ATTACHED,
         INPUT_MODE_0x30,
@@ -225,7 +583,7 @@ public:
 	static uint const product_id_right = 0x2007;
 
     bool isLeft;
-    state_ state;
+    std::atomic<state_> state { state_::NOT_ATTACHED };
 
 private:
     std::array<std::atomic<bool>, 13> buttons_down;
@@ -233,18 +591,21 @@ private:
     std::array<std::atomic<bool>, 13> buttons;
     std::array<std::atomic<bool>, 13> down_;
 
-    hid_device* hid_dev;
+    std::unique_ptr<HidTransport> transport;
+    HidrawHub* hub = nullptr;
 
-    std::vector<float> stick = { 0, 0 };
+    std::array<float, 2> stick {};
 
-    std::vector<uint8_t> default_buf = { 0x0, 0x1, 0x40, 0x40, 0x0, 0x1, 0x40, 0x40 };
+    const std::array<uint8_t, 8> default_buf = {{ 0x0, 0x1, 0x40, 0x40, 0x0, 0x1, 0x40, 0x40 }};
 
-    std::vector<uint8_t> stick_raw = { 0, 0, 0 };
-    std::vector<uint16_t> stick_cal = { 0, 0, 0, 0, 0, 0 };
-    uint16_t deadzone;
-    std::vector<uint16_t> stick_precal = { 0, 0 };
+    std::array<uint8_t, 3> stick_raw {};
+    std::array<uint16_t, 6> stick_cal {};
+    uint16_t deadzone = 0;
+    bool calibration_restored = false;
+    std::array<uint16_t, 2> stick_precal {};
 
-    bool stop_polling = false;
+    std::atomic<bool> stop_polling { false };
+    std::mutex service_lock;        // hand-offs between the hub and the poll thread, against Detach()
     int timestamp;
     bool imu_enabled = false;
 
@@ -258,33 +619,103 @@ private:
     juce::Vector3D<float> pitchRollYaw;
 
     bool do_localize;
-    float alpha;
+
+    // Settings plus the stick tables built from them; replaced whole, never written in place
+    struct Config
+    {
+        Settings settings;
+        StickShaper stick_shaper;
+    };
+
+    SnapshotCell<Config> config;
+    SnapshotCell<Config>::Reader config_reader { config };
+    const Config* active_config = nullptr;          // held for the length of Update()
+
+    static Config InitialConfig(float alpha)
+    {
+        Config c;
+        c.settings.alpha = alpha;
+        return c;
+    }
+
+    void PublishConfig(const Settings& s)
+    {
+        Config c;
+        c.settings = s;
+        c.stick_shaper.configure(stick_cal, deadzone, s.stick);
+        config.publish(std::move(c));
+    }
 
     uint report_len = 49;
-    class Report
+    static constexpr size_t max_report_len = 64;
+    using ReportBuffer = std::array<uint8_t, max_report_len>;
+
+    ReportBuffer last_report {};
+
+    // report timer on the host clock, so a pair of controllers share one timeline
+    DeviceClock device_clock;
+    double device_ms = 0;
+
+    // lanes queued in the current ImuBatch, see Update(batch)
+    int batch_first = -1;
+    int batch_last = -1;
+    bool batch_overflowed = false;
+    bool publish_pending = false;
+    ReportBuffer subcommand_response {};
+
+    /*
+        Preallocated report slots between the thread reading the device (poll
+        thread or hub) and Update(). Single producer, single consumer, the
+        device is read straight into the next free slot.
+    */
+    class ReportQueue
     {
     public:
-        std::vector<uint8_t> r;
-        juce::Time t;
+        struct Slot
+        {
+            ReportBuffer r {};
+            juce::Time t;
+            double arrival_ms = 0;      // juce::Time::getMillisecondCounterHiRes(), for the DeviceClock
+        };
 
-        Report()
+        static constexpr juce::uint32 capacity = 64;
+
+        /* Producer: next free slot, or nullptr if the consumer has fallen behind. */
+        Slot* BeginWrite()
         {
-            Report({0x00}, {});
+            auto w = write_index.load(std::memory_order_relaxed);
+            return (w - read_index.load(std::memory_order_acquire)) < capacity ? &slots[w & (capacity - 1)] : nullptr;
         }
 
-        Report(std::vector<uint8_t> report, juce::Time time)
+        void CommitWrite()
         {
-            r = report;
-            t = time;
+            write_index.fetch_add(1, std::memory_order_release);
         }
 
-        juce::Time GetTime()
+        /* Consumer: oldest unread slot, or nullptr if empty. */
+        Slot* Front()
         {
-            return t;
+            auto r = read_index.load(std::memory_order_relaxed);
+            return r != write_index.load(std::memory_order_acquire) ? &slots[r & (capacity - 1)] : nullptr;
         }
+
+        void Pop()
+        {
+            read_index.fetch_add(1, std::memory_order_release);
+        }
+
+        juce::uint32 Size() const
+        {
+            return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::array<Slot, capacity> slots;
+        std::atomic<juce::uint32> write_index { 0 };
+        std::atomic<juce::uint32> read_index { 0 };
     };
 
-    class Rumble : private juce::Timer
+    class Rumble
     {
     public:
         Rumble(float low_freq, float high_freq, float amplitude, uint time_ms = 0)
@@ -292,25 +723,37 @@ private:
             setVals(low_freq, high_freq, amplitude, time_ms);
         }
 
+        ~Rumble()
+        {
+            scheduler->cancel(timeout);
+        }
+
+        /* With time_ms the rumble stops after that long; the timeout runs on the scheduler thread, not the message thread. */
         void setVals(float low_freq, float high_freq, float amplitude, uint time_ms = 0)
         {
-            h_f = high_freq;
-            amp = amplitude;
-            l_f = low_freq;
+            scheduler->cancel(timeout);
+            timeout = 0;
+
+            h_f.store(high_freq, std::memory_order_relaxed);
+            l_f.store(low_freq, std::memory_order_relaxed);
+            amp.store(amplitude, std::memory_order_release);
             timed_rumble = false;
 
             if (time_ms)
             {
                 timed_rumble = true;
-                startTimer((int)time_ms);
+                timeout = scheduler->schedule((double)time_ms, [this] { timeoutExpired(); });
             }
         }
 
-        std::vector<uint8_t> GetData()
+        /* Poll or hub thread; setVals() and the timeout may change the values meanwhile. */
+        std::array<uint8_t, 8> GetData()
         {
-            std::vector<uint8_t> rumble_data(8);
+            std::array<uint8_t, 8> rumble_data {};
+
+            const float amplitude = amp.load(std::memory_order_acquire);
 
-            if (amp == 0.0f)
+            if (amplitude == 0.0f)
             {
                 rumble_data[0] = 0x0;
                 rumble_data[1] = 0x1;
@@ -319,24 +762,24 @@ private:
             }
             else
             {
-                l_f = clamp(l_f, 40.875885f, 626.286133f);
-                amp = clamp(amp, 0.0f, 1.0f);
-                h_f = clamp(h_f, 81.75177f, 1252.572266f);
+                const float low = clamp(l_f.load(std::memory_order_relaxed), 40.875885f, 626.286133f);
+                const float level = clamp(amplitude, 0.0f, 1.0f);
+                const float high = clamp(h_f.load(std::memory_order_relaxed), 81.75177f, 1252.572266f);
 
-                uint16_t hf = (uint16_t)((std::roundf(32.f * std::log2f(h_f * 0.1f)) - 0x60) * 4);
-                uint8_t lf = (uint8_t)(std::roundf(32.f * std::log2f(l_f * 0.1f)) - 0x40);
+                uint16_t hf = (uint16_t)((std::roundf(32.f * std::log2f(high * 0.1f)) - 0x60) * 4);
+                uint8_t lf = (uint8_t)(std::roundf(32.f * std::log2f(low * 0.1f)) - 0x40);
 
                 uint8_t hf_amp;
-                if (amp == 0) {
+                if (level == 0) {
                     hf_amp = 0; }
                 else
-                if (amp < 0.117) {
-                    hf_amp = (uint8_t)(((std::log2f(amp * 1000.f) * 32) - 0x60) / (5 - std::powf(amp, 2)) - 1); }
+                if (level < 0.117) {
+                    hf_amp = (uint8_t)(((std::log2f(level * 1000.f) * 32) - 0x60) / (5 - level * level) - 1); }
                 else
-                if (amp < 0.23) {
-                    hf_amp = (uint8_t)(((std::log2f(amp * 1000.f) * 32) - 0x60) - 0x5c); }
+                if (level < 0.23) {
+                    hf_amp = (uint8_t)(((std::log2f(level * 1000.f) * 32) - 0x60) - 0x5c); }
                 else {
-                    hf_amp = (uint8_t)((((std::log2f(amp * 1000) * 32) - 0x60) * 2) - 0xf6); }
+                    hf_amp = (uint8_t)((((std::log2f(level * 1000) * 32) - 0x60) * 2) - 0xf6); }
 
                 uint16_t lf_amp = (uint16_t)(std::roundf(hf_amp) * .5);
                 uint8_t parity = (uint8_t)(lf_amp % 2);
@@ -376,10 +819,13 @@ private:
         }
 
     private:
-        float h_f, amp, l_f;
+        std::atomic<float> h_f, amp, l_f;    // written by setVals() and the timeout, read by GetData()
 
         std::atomic<bool> timed_rumble;
 
+        juce::SharedResourcePointer<Scheduler> scheduler;
+        Scheduler::TaskId timeout = 0;
+
         float clamp(float x, float _min, float _max)
         {
             if (x < _min) return _min;
@@ -387,20 +833,98 @@ private:
             return x;
         }
 
-        void timerCallback()
+        void timeoutExpired()
         {
+            amp.store(0.0f, std::memory_order_release);
             timed_rumble = false;
         }
     };
 
-    std::queue<Report> reports;
+    ReportQueue reports;
+    ReportBuffer overflow_buf {};
+    std::atomic<juce::uint32> queue_overflows { 0 };
+    std::atomic<double> poll_cpu_seconds { 0.0 };
     Rumble rumble_obj;
 
+    Telemetry* telemetry = nullptr;
+    GestureEngine* gestures = nullptr;
+    CaptureWriter* capture = nullptr;
+
+    /* One processed IMU sample into the telemetry's broadcast ring. */
+    void PublishImuSample(double time_ms, const juce::Vector3D<int16_t>& raw_acc, const juce::Vector3D<int16_t>& raw_gyr,
+                          const juce::Vector3D<float>& acc, const juce::Vector3D<float>& gyr, const juce::Vector3D<float>& orientation)
+    {
+        if (telemetry == nullptr)
+        {
+            return;
+        }
+
+        ImuRecord r;
+        r.timeMs = time_ms;
+        r.rawAcc[0] = raw_acc.x;
+        r.rawAcc[1] = raw_acc.y;
+        r.rawAcc[2] = raw_acc.z;
+        r.rawGyr[0] = raw_gyr.x;
+        r.rawGyr[1] = raw_gyr.y;
+        r.rawGyr[2] = raw_gyr.z;
+        r.acc[0] = acc.x;
+        r.acc[1] = acc.y;
+        r.acc[2] = acc.z;
+        r.gyr[0] = gyr.x;
+        r.gyr[1] = gyr.y;
+        r.gyr[2] = gyr.z;
+        r.pitchRollYaw[0] = orientation.x;
+        r.pitchRollYaw[1] = orientation.y;
+        r.pitchRollYaw[2] = orientation.z;
+
+        telemetry->imu.push(r);
+    }
+
+    void PublishTelemetry()
+    {
+        if (telemetry == nullptr)
+        {
+            return;
+        }
+
+        TelemetrySample t;
+        auto pry = GetOrientation();
+
+        t.ticks = juce::Time::getHighResolutionTicks();
+        t.deviceMs = device_ms;
+        t.pitchRollYaw[0] = pry.x;
+        t.pitchRollYaw[1] = pry.y;
+        t.pitchRollYaw[2] = pry.z;
+        t.acc[0] = acc_g.x;
+        t.acc[1] = acc_g.y;
+        t.acc[2] = acc_g.z;
+        t.gyr[0] = gyr_g.x;
+        t.gyr[1] = gyr_g.y;
+        t.gyr[2] = gyr_g.z;
+        t.stick[0] = stick[0];
+        t.stick[1] = stick[1];
+
+        for (size_t i = 0; i < buttons.size(); ++i)
+        {
+            t.buttons |= (buttons[i] ? 1u : 0u) << i;
+        }
+
+        telemetry->history.push(t);
+    }
+
     uint8_t global_count = 0;
 
-    void DebugPrint(String s, DebugType d)
+    juce::uint32 debug_mask = 1u << DebugType::ALL;
+
+    bool IsDebugEnabled(DebugType d) const
     {
-        if (d != DebugType::NONE)
+        return d != DebugType::NONE && (debug_mask & (1u << d)) != 0;
+    }
+
+    /* Callers on the report path check IsDebugEnabled() before building a message. */
+    template <typename Str> void DebugPrint(const Str& s, DebugType d)
+    {
+        if (IsDebugEnabled(d))
         {
             std::cout << s << std::endl;
         }
@@ -421,7 +945,7 @@ private:
         return buttons_up[b];
     }
 
-    std::vector<float> GetStick()
+    std::array<float, 2> GetStick()
     {
         return stick;
     }
@@ -440,37 +964,113 @@ private:
     uint8_t ts_de;
     juce::Time ts_prev;
 
+    /* Returns bytes read: > 0 for a report, 0 if none was waiting, < 0 if the device failed. */
     int ReceiveRaw()
     {
-        if (hid_dev == nullptr) return -2;
+        JOYCON_TRACE_SCOPE("ReceiveRaw");
 
-        hid_set_nonblocking(hid_dev, 1);
+        if (transport == nullptr) return -2;
 
-        std::vector<uint8_t> raw_buf(report_len);
+        auto* slot = reports.BeginWrite();
+        auto* raw = (slot != nullptr) ? slot->r.data() : overflow_buf.data();
 
         int bytes = 0;
-        if ((bytes = hid_read(hid_dev, raw_buf.data(), report_len)) > 0)
+        if ((bytes = transport->read(raw, report_len, 0)) > 0)
         {
-            juce::CriticalSection critical;
-            juce::GenericScopedLock<juce::CriticalSection> scoped_lock(critical);
-
-            reports.push(Report(raw_buf, juce::Time::getCurrentTime()));
+            if (slot != nullptr)
+            {
+                slot->t = juce::Time::getCurrentTime();
+                slot->arrival_ms = juce::Time::getMillisecondCounterHiRes();
+                reports.CommitWrite();
+            }
+            else
+            {
+                ++queue_overflows;
+            }
 
-            std::stringstream ss;
-            if (ts_en == raw_buf[1])
+            if (IsDebugEnabled(DebugType::THREADING))
             {
-                ss << "Duplicate timestamp enqueued. TS: " << std::hex << std::setfill('0') << std::setw(2) << +ts_en;
+                std::stringstream ss;
+                if (ts_en == raw[1])
+                {
+                    ss << "Duplicate timestamp enqueued. TS: " << std::hex << std::setfill('0') << std::setw(2) << +ts_en;
+                    DebugPrint(ss.str(), DebugType::THREADING);
+                }
+                ss << "Enqueue. Bytes read: " << bytes << ". Timestamp: 0x";
+                ss << std::hex << std::setfill('0') << std::setw(2) << +raw[1];
                 DebugPrint(ss.str(), DebugType::THREADING);
+                PrintArray(std::vector<uint8_t>(raw, raw + bytes), DebugType::THREADING, std::ios_base::hex);
             }
-            ss << "Enqueue. Bytes read: " << bytes << ". Timestamp: 0x";
-            ss << std::hex << std::setfill('0') << std::setw(2) << +raw_buf[1];
-            DebugPrint(ss.str(), DebugType::THREADING);
-            PrintArray(raw_buf, DebugType::THREADING, std::ios_base::hex);
 
-            ts_en = raw_buf[1];
+            ts_en = raw[1];
+        }
+
+        return bytes;
+    }
+
+    uint8_t leds = 0x0;
+
+    RealtimeConfig rt_config;
+
+    juce::CriticalSection path_lock;
+    juce::String device_path;
+
+    ConnectionStats connection_stats;
+    juce::int64 drop_ticks = 0;
+
+    static constexpr int initial_backoff_ms = 50;
+    static constexpr int max_backoff_ms = 2000;
+
+    void Drop()
+    {
+        DebugPrint("Connection lost. Is the Joy-Con connected?", DebugType::ALL);
+
+        transport.reset();
+
+        drop_ticks = juce::Time::getHighResolutionTicks();
+        ++connection_stats.drops;
+        state = state_::DROPPED;
+    }
+
+    bool TryReopen()
+    {
+        juce::String path;
+        {
+            juce::ScopedLock l(path_lock);
+            path = device_path;
+        }
+
+        if (path.isEmpty())
+        {
+            return false;
+        }
+
+        state = state_::RECONNECTING;
+
+        transport = HidTransport::open(path);
+        if (transport == nullptr)
+        {
+            ++connection_stats.failedAttempts;
+            return false;
         }
 
-        return (int)reports.size();
+        return Resume();
+    }
+
+    void RecordRecovery()
+    {
+        auto ms = (juce::int64)(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - drop_ticks) * 1000.0);
+
+        connection_stats.lastRecoveryMs = ms;
+        if (ms > connection_stats.maxRecoveryMs)
+        {
+            connection_stats.maxRecoveryMs = ms;
+        }
+
+        ++connection_stats.reconnects;
+        drop_ticks = 0;
+
+        DebugPrint("Reconnected after " + juce::String(ms) + "ms", DebugType::COMMS);
     }
 
     class PollThreadObj : public juce::Thread
@@ -482,6 +1082,13 @@ private:
         void run() override
         {
             int attempts = 0;
+            int backoff = initial_backoff_ms;
+            juce::uint32 loops = 0;
+
+            if (!applyToCurrentThread(j.rt_config).ok())
+            {
+                j.DebugPrint("Poll thread: requested scheduling " + j.rt_config.toString() + " not permitted, falling back", DebugType::THREADING);
+            }
 
             while (1)
             {
@@ -490,18 +1097,58 @@ private:
                     return;
                 }
 
-                j.SendRumble(j.rumble_obj.GetData());
+                if (j.IsReconnecting())
+                {
+                    // woken early by ReconnectNow() or stopThread()
+                    wait(backoff);
+
+                    if (threadShouldExit())
+                    {
+                        return;
+                    }
 
-                if (j.ReceiveRaw() > 0)
+                    if (j.TryReopen())
+                    {
+                        backoff = initial_backoff_ms;
+                        attempts = 0;
+
+                        // hand the controller back to the hub it came from
+                        if (j.ReturnToHub())
+                        {
+                            return;
+                        }
+                    }
+                    else
+                    {
+                        backoff = juce::jmin(backoff * 2, max_backoff_ms);
+                    }
+
+                    continue;
+                }
+
+                int res;
+                {
+                    ScopedAllocationCheck steady_state("Joycon::PollThreadObj::run");
+
+                    j.SendRumble(j.rumble_obj.GetData());
+                    res = j.ReceiveRaw();
+                }
+
+                if (res > 0)
                 {
+                    if (j.drop_ticks != 0)
+                    {
+                        j.RecordRecovery();
+                    }
+
                     j.state = state_::IMU_DATA_OK;
                     attempts = 0;
                 }
                 else
-                if (attempts > 1000)
+                if (res < 0 || attempts > 1000)
                 {
-                    j.state = state_::DROPPED;
-                    j.DebugPrint("Connection lost. Is the Joy-Con connected?", DebugType::ALL);
+                    j.Drop();
+                    backoff = initial_backoff_ms;
                 }
                 else
                 {
@@ -511,6 +1158,12 @@ private:
 
                 ++attempts;
 
+                // not attempts, which a healthy link resets every report
+                if ((++loops & 255) == 0)
+                {
+                    j.poll_cpu_seconds.store(getThreadCpuSeconds(), std::memory_order_relaxed);
+                }
+
                 j.DebugPrint("poll done", DebugType::THREADING);
             }
         }
@@ -521,39 +1174,87 @@ private:
 
     PollThreadObj pollThread;
 
-    std::vector<float> max = { 0, 0, 0 };
-    std::vector<float> sum = { 0, 0, 0 };
+    int getHubFd() const override
+    {
+        return transport != nullptr ? transport->getFd() : -1;
+    }
+
+    bool hubReadable() override
+    {
+        ScopedAllocationCheck steady_state("Joycon::hubReadable");
+
+        int res;
+        bool any = false;
+
+        while ((res = ReceiveRaw()) > 0)
+        {
+            any = true;
+        }
+
+        if (any)
+        {
+            if (drop_ticks != 0)
+            {
+                RecordRecovery();
+            }
+
+            state = state_::IMU_DATA_OK;
 
-    int ProcessButtonsAndStick(std::vector<uint8_t> report_buf)
+            // rumble is paced by input reports, one output report per poll cycle
+            SendRumble(rumble_obj.GetData());
+        }
+
+        return res >= 0;
+    }
+
+    /* Poll thread, after a reconnect. False if there is no hub to go back to, or we are detaching. */
+    bool ReturnToHub()
+    {
+        const std::lock_guard<std::mutex> l(service_lock);
+        return hub != nullptr && !stop_polling && hub->add(*this);
+    }
+
+    void hubDropped() override
     {
+        Drop();
+
+        const std::lock_guard<std::mutex> l(service_lock);
+        if (stop_polling)
+        {
+            return;
+        }
+
+        // the poll thread that handed us to the hub may still be returning from ReturnToHub()
+        pollThread.waitForThreadToExit(1000);
+
+        // it runs the reconnect loop and hands us back to the hub
+        pollThread.startThread(juce::Thread::Priority::highest);
+    }
+
+    std::array<float, 3> max {};
+    std::array<float, 3> sum {};
+
+    int ProcessButtonsAndStick(const uint8_t* report_buf)
+    {
+        JOYCON_TRACE_SCOPE("ProcessButtonsAndStick");
+
         if (report_buf[0] == 0x00) return -1;
 
         stick_raw[0] = report_buf[6 + (isLeft ? 0 : 3)];
         stick_raw[1] = report_buf[7 + (isLeft ? 0 : 3)];
         stick_raw[2] = report_buf[8 + (isLeft ? 0 : 3)];
 
-        stick_precal[0] = (uint16_t)(stick_raw[0] + ((stick_raw[1] & 0xf) << 8));
-        stick_precal[1] = (uint16_t)((stick_raw[1] >> 4) + (stick_raw[2] << 4));
-        stick = CenterSticks(stick_precal);
+        stick_precal = DecodeStick(report_buf, isLeft);
+        stick = active_config->stick_shaper.process(stick_precal[0], stick_precal[1]);
+
+        const auto held = DecodeButtons(report_buf, isLeft);
 
         for (size_t i = 0; i < buttons.size(); ++i)
         {
             down_[i] = buttons[i].load();
+            buttons[i] = (held & (1u << i)) != 0;
         }
 
-        buttons[(int)Button::DPAD_DOWN] = (report_buf[3 + (isLeft ? 2 : 0)] & (isLeft ? 0x01 : 0x04)) != 0;
-        buttons[(int)Button::DPAD_RIGHT] = (report_buf[3 + (isLeft ? 2 : 0)] & (isLeft ? 0x04 : 0x08)) != 0;
-        buttons[(int)Button::DPAD_UP] = (report_buf[3 + (isLeft ? 2 : 0)] & (isLeft ? 0x02 : 0x02)) != 0;
-        buttons[(int)Button::DPAD_LEFT] = (report_buf[3 + (isLeft ? 2 : 0)] & (isLeft ? 0x08 : 0x01)) != 0;
-        buttons[(int)Button::HOME] = ((report_buf[4] & 0x10) != 0);
-        buttons[(int)Button::MINUS] = ((report_buf[4] & 0x01) != 0);
-        buttons[(int)Button::PLUS] = ((report_buf[4] & 0x02) != 0);
-        buttons[(int)Button::STICK] = ((report_buf[4] & (isLeft ? 0x08 : 0x04)) != 0);
-        buttons[(int)Button::SHOULDER_1] = (report_buf[3 + (isLeft ? 2 : 0)] & 0x40) != 0;
-        buttons[(int)Button::SHOULDER_2] = (report_buf[3 + (isLeft ? 2 : 0)] & 0x80) != 0;
-        buttons[(int)Button::SR] = (report_buf[3 + (isLeft ? 2 : 0)] & 0x10) != 0;
-        buttons[(int)Button::SL] = (report_buf[3 + (isLeft ? 2 : 0)] & 0x20) != 0;
-
         for (size_t i = 0; i < buttons.size(); ++i)
         {
             buttons_up[i] = (down_[i] && !buttons[i]);
@@ -563,14 +1264,52 @@ private:
         return 0;
     }
 
-    void ExtractIMUValues(std::vector<uint8_t> report_buf, size_t n = 0)
+    /* Batch counterpart of ProcessIMU(). Returns false if the batch is full. */
+    bool CollectIMU(const uint8_t* report_buf, ImuBatch& batch, double report_ms)
+    {
+        if (!imu_enabled || state < state_::IMU_DATA_OK || report_buf[0] != 0x30)
+        {
+            return true;
+        }
+
+        if (batch.size() + 3 > ImuBatch::maxLanes)
+        {
+            batch_overflowed = true;
+            return false;
+        }
+
+        int dt = (report_buf[1] - timestamp);
+        if (report_buf[1] < timestamp)
+        {
+            dt += 0x100;
+        }
+
+        for (size_t n = 0; n < 3; ++n)
+        {
+            ExtractRawIMUValues(report_buf, n);
+
+            batch_last = batch.add(acc_r, gyr_r, gyr_neutral, isLeft, active_config->settings.alpha, 0.005f * dt, report_ms - (double)(2 - n) * 5.0);
+            if (batch_first < 0)
+            {
+                batch_first = batch_last;
+            }
+
+            dt = 1;
+        }
+
+        timestamp = report_buf[1];
+
+        return true;
+    }
+
+    void ExtractRawIMUValues(const uint8_t* report_buf, size_t n)
     {
-        gyr_r.x = (int16_t)((int16_t)report_buf[19 + n * 12] + ((report_buf[20 + n * 12] << 8) & 0xff00));
-        gyr_r.y = (int16_t)((int16_t)report_buf[21 + n * 12] + ((report_buf[22 + n * 12] << 8) & 0xff00));
-        gyr_r.z = (int16_t)((int16_t)report_buf[23 + n * 12] + ((report_buf[24 + n * 12] << 8) & 0xff00));
-        acc_r.x = (int16_t)((int16_t)report_buf[13 + n * 12] + ((report_buf[14 + n * 12] << 8) & 0xff00));
-        acc_r.y = (int16_t)((int16_t)report_buf[15 + n * 12] + ((report_buf[16 + n * 12] << 8) & 0xff00));
-        acc_r.z = (int16_t)((int16_t)report_buf[17 + n * 12] + ((report_buf[18 + n * 12] << 8) & 0xff00));
+        DecodeRawIMU(report_buf, n, acc_r, gyr_r);
+    }
+
+    void ExtractIMUValues(const uint8_t* report_buf, size_t n = 0)
+    {
+        ExtractRawIMUValues(report_buf, n);
 
         acc_g.x = acc_r.x * 0.000244f;
         gyr_g.x = (gyr_r.x - gyr_neutral.x) * 0.070f;
@@ -585,8 +1324,10 @@ private:
         if (std::abs(acc_g.z) > std::abs(max[2])) max[2] = acc_g.z;
     }
 
-    int ProcessIMU(std::vector<uint8_t> report_buf)
+    int ProcessIMU(const uint8_t* report_buf, double report_ms = 0)
     {
+        JOYCON_TRACE_SCOPE("ProcessIMU");
+
         if (!imu_enabled || state < state_::IMU_DATA_OK)
             return -1;
 
@@ -617,12 +1358,17 @@ private:
                 acc_g.z *= -1;
             }
 
+            if (gestures != nullptr)
+            {
+                gestures->push({ report_ms - (double)(2 - n) * 5.0, acc_g, gyr_g });
+            }
+
             // TODO error correction
 
             // calculate accelerometer angle, range [-90, 90]
-            auto angleX = std::atan(acc_g.x / std::sqrt(pow(acc_g.y, 2) + std::pow(acc_g.z, 2))) * (180.0 / juce::MathConstants<double>::pi);
-            auto angleY = std::atan(acc_g.y / std::sqrt(pow(acc_g.x, 2) + std::pow(acc_g.z, 2))) * (180.0 / juce::MathConstants<double>::pi);
-            auto angleZ = std::atan(acc_g.z / std::sqrt(pow(acc_g.x, 2) + std::pow(acc_g.y, 2))) * (180.0 / juce::MathConstants<double>::pi);
+            auto angleX = std::atan(acc_g.x / std::sqrt(acc_g.y * acc_g.y + acc_g.z * acc_g.z)) * (180.0 / juce::MathConstants<double>::pi);
+            auto angleY = std::atan(acc_g.y / std::sqrt(acc_g.x * acc_g.x + acc_g.z * acc_g.z)) * (180.0 / juce::MathConstants<double>::pi);
+            auto angleZ = std::atan(acc_g.z / std::sqrt(acc_g.x * acc_g.x + acc_g.y * acc_g.y)) * (180.0 / juce::MathConstants<double>::pi);
 
             // integrate change in angle from gyroscope, degrees per second * seconds
             auto deltaX = gyr_g.x * dt_sec;
@@ -630,10 +1376,13 @@ private:
             auto deltaZ = gyr_g.z * dt_sec;
 
             // filter data, favour gyroscope for fast changes and accelerometer for stationary measurement
+            const auto alpha = active_config->settings.alpha;
             pitchRollYaw.x = (float)((alpha * angleX) + ((1.0 - alpha) * deltaX));
             pitchRollYaw.y = (float)((alpha * angleY) + ((1.0 - alpha) * deltaY));
             pitchRollYaw.z = (float)((alpha * angleZ) + ((1.0 - alpha) * deltaZ));
 
+            PublishImuSample(report_ms - (double)(2 - n) * 5.0, acc_r, gyr_r, acc_g, gyr_g, pitchRollYaw);
+
             dt = 1;
         }
 
@@ -642,33 +1391,11 @@ private:
         return 0;
     }
 
-    std::vector<float> CenterSticks(std::vector<uint16> vals)
+    void SendRumble(const std::array<uint8_t, 8>& buf)
     {
-        std::vector<float> s = { 0, 0 };
+        JOYCON_TRACE_SCOPE("SendRumble");
 
-        for (uint i = 0; i < 2; ++i)
-        {
-            float diff = vals[i] - stick_cal[2 + i];
-
-            if (std::abs(diff) < deadzone)
-            {
-                vals[i] = 0;
-            }
-            else if (diff > 0) // if axis is above center
-            {
-                s[i] = diff / stick_cal[i];
-            }
-            else
-            {
-                s[i] = diff / stick_cal[4 + i];
-            }
-        }
-        return s;
-    }
-
-    void SendRumble(std::vector<uint8_t> buf)
-    {
-        std::vector<uint8_t> report(report_len);
+        ReportBuffer report {};
 
         report[0] = 0x10;
         report[1] = global_count;
@@ -676,24 +1403,33 @@ private:
         if (global_count == 0xf) global_count = 0;
         else ++global_count;
 
-        report.insert(report.begin() + 2, buf.begin(), buf.end());
+        std::copy(buf.begin(), buf.end(), report.begin() + 2);
 
         DebugPrint("Send Rumble", DebugType::COMMS);
         PrintArray(report, DebugType::RUMBLE, std::ios_base::hex);
 
-        if (-1 == hid_write(hid_dev, report.data(), report.size()))
+        if (transport == nullptr || -1 == transport->write(report.data(), report_len))
         {
             DebugPrint("Failed to send rumble data", DebugType::COMMS);
         }
     }
 
-    std::vector<uint8_t> Subcommand(uint8_t sc, std::vector<uint8_t> buf, bool print = true)
+    const ReportBuffer& Subcommand(uint8_t sc, std::initializer_list<uint8_t> buf, bool print = true)
     {
-        std::vector<uint8_t> report(report_len);
-        std::vector<uint8_t> response(report_len);
+        return Subcommand(sc, buf.begin(), buf.size(), print);
+    }
+
+    /* The response stays valid until the next subcommand. */
+    const ReportBuffer& Subcommand(uint8_t sc, const uint8_t* buf, size_t buf_len, bool print = true)
+    {
+        JOYCON_TRACE_SCOPE("Subcommand");
 
-        report.insert(report.begin() + 2, default_buf.begin(), default_buf.end());
-        report.insert(report.begin() + 11, buf.begin(), buf.end());
+        ReportBuffer report {};
+        auto& response = subcommand_response;
+        response.fill(0);
+
+        std::copy(default_buf.begin(), default_buf.end(), report.begin() + 2);
+        std::copy(buf, buf + juce::jmin(buf_len, (size_t)report_len - 11), report.begin() + 11);
 
         report[10] = sc;
         report[1] = global_count;
@@ -703,23 +1439,28 @@ private:
         else ++global_count;
 
         std::stringstream ss;
-        if (print)
+        if (print && IsDebugEnabled(DebugType::COMMS))
         {
             ss << "Subcommand 0x" << std::hex << std::setfill('0') << std::setw(2) << +sc << " sent";
             DebugPrint(ss.str(), DebugType::COMMS);
             PrintArray(report, DebugType::COMMS, std::ios_base::hex);
         };
 
-        hid_write(hid_dev, report.data(), report.size());
+        if (transport == nullptr)
+        {
+            return response;
+        }
+
+        transport->write(report.data(), report_len);
 
-        int res = hid_read_timeout(hid_dev, response.data(), response.size(), 50);
+        int res = transport->read(response.data(), report_len, 50);
 
         if (res < 1)
         {
             DebugPrint("No response.", DebugType::COMMS);
         }
         else
-        if (print)
+        if (print && IsDebugEnabled(DebugType::COMMS))
         {
             ss.clear();
             ss << "Response ID 0x" << std::hex << std::setfill('0') << std::setw(2) << +response[0];
@@ -733,7 +1474,7 @@ private:
     void dumpCalibrationData()
     {
         // get user calibration data if possible
-        std::vector<uint8_t> buf_ = ReadSPI(0x80, (isLeft ? (uint8_t)0x12 : (uint8_t)0x1d), 9);
+        auto buf_ = ReadSPI(0x80, (isLeft ? (uint8_t)0x12 : (uint8_t)0x1d), 9);
         bool found = false;
         for (size_t i = 0; i < 9; ++i)
         {
@@ -766,13 +1507,15 @@ private:
         buf_ = ReadSPI(0x60, (isLeft ? (uint8_t)0x86 : (uint8_t)0x98), 16);
         deadzone = (((uint16_t)buf_[4] << 8) & 0xF00) + buf_[3];
 
+        PublishConfig(GetSettings());
+
         buf_ = ReadSPI(0x80, 0x34, 10);
         gyr_neutral.x = (int16_t)(buf_[0] + ((buf_[1] << 8) & 0xff00));
         gyr_neutral.y = (int16_t)(buf_[2] + ((buf_[3] << 8) & 0xff00));
         gyr_neutral.z = (int16_t)(buf_[4] + ((buf_[5] << 8) & 0xff00));
 
         DebugPrint("User gyro neutral position: ", DebugType::COMMS);
-        PrintArray( std::vector<int16_t>{gyr_neutral.x, gyr_neutral.y, gyr_neutral.z},
+        PrintArray( std::array<int16_t, 3>{{gyr_neutral.x, gyr_neutral.y, gyr_neutral.z}},
                     DebugType::IMU,
                     std::ios_base::hex);
 
@@ -789,27 +1532,30 @@ private:
             gyr_neutral.z = (int16_t)(buf_[7] + ((buf_[8] << 8) & 0xff00));
 
             DebugPrint("Factory gyro neutral position: ", DebugType::COMMS);
-            PrintArray( std::vector<int16_t>{gyr_neutral.x, gyr_neutral.y, gyr_neutral.z},
+            PrintArray( std::array<int16_t, 3>{{gyr_neutral.x, gyr_neutral.y, gyr_neutral.z}},
                         DebugType::IMU,
                         std::ios_base::hex);
         }
     }
 
-    std::vector<uint8_t> ReadSPI(uint8_t addr1, uint8_t addr2, uint len, bool print = false)
+    ReportBuffer ReadSPI(uint8_t addr1, uint8_t addr2, uint len, bool print = false)
     {
-        std::vector<uint8_t> report = { addr2, addr1, 0x00, 0x00, (uint8_t)len };
-        std::vector<uint8_t> read_buf(len + 20);
+        JOYCON_TRACE_SCOPE("ReadSPI");
+
+        const uint8_t report[] = { addr2, addr1, 0x00, 0x00, (uint8_t)len };
 
         for (int i = 0; i < 100; ++i)
         {
-            read_buf = Subcommand(0x10, report, false);
-            if (read_buf[15] == addr2 && read_buf[16] == addr1)
+            const auto& response = Subcommand(0x10, report, sizeof(report), false);
+            if (response[15] == addr2 && response[16] == addr1)
             {
                 break;
             }
         }
 
-        read_buf.erase(read_buf.begin(), read_buf.begin() + 20);
+        // SPI data starts after the 20 byte subcommand reply header
+        ReportBuffer read_buf {};
+        std::copy(subcommand_response.begin() + 20, subcommand_response.end(), read_buf.begin());
 
         if (print)
         {
@@ -819,11 +1565,11 @@ private:
         return read_buf;
     }
 
-    template <typename T> void PrintArray(  std::vector<T> v,
-                                            DebugType d = DebugType::NONE,
-                                            std::ios_base::fmtflags base = 0)
+    template <typename Container> void PrintArray(  const Container& v,
+                                                    DebugType d = DebugType::NONE,
+                                                    std::ios_base::fmtflags base = {})
     {
-        if (d == DebugType::NONE)
+        if (!IsDebugEnabled(d))
         {
             return;
         }
@@ -833,7 +1579,7 @@ private:
         for (auto iter = v.begin(); iter < v.end(); iter++)
         {
             if (base == std::ios_base::hex)
-                ss << "0x" << std::hex << std::setfill('0') << std::setw(2 * sizeof(typename std::vector<T>::value_type)) << +(*iter) << " ";
+                ss << "0x" << std::hex << std::setfill('0') << std::setw(2 * sizeof(typename Container::value_type)) << +(*iter) << " ";
             else
                 ss << *iter << " ";
         }